@@ -8,7 +8,7 @@ using File = threadSafeFS::File;  // Use thread-safe wrapper for all file operat
 
 
 // 1️⃣ Crete thread-safe wrapper arround LittleFS (or SPIFFS or FFat or SD)
-threadSafeFS::FS TSFS (LittleFS);
+threadSafeFS::FS TSFS (LittleFS, "/littlefs"); // the mount point is needed by MFMT
 
 
 // 2️⃣ Use thread-safe wrapper for all file operations form now on in your code
@@ -32,7 +32,7 @@ void setup () {
   ftpServer = new (std::nothrow) ftpServer_t (TSFS);  // optional arguments:
                                                       //    Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password) = NULL
                                                       //    int serverPort = 21
-                                                      //    bool (*firewallCallback) (char *clientIP, char *serverIP) = NULL
+                                                      //    bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL
                                                       //    bool runListenerInItsOwnTask = true
 
 
@@ -42,6 +42,12 @@ void setup () {
   else
     Serial.println ("FTP server did not start");
 
+  // optionally cap FTP transfers (all FTP connections together) so that they don't starve the rest of the traffic, for example to 200 KB/s in each direction
+  if (ftpServer && *ftpServer) {
+    ftpServer->getBandwidthLimit ().send.setRate (200 * 1024);  // optional argument: unsigned long burst = rate / 10
+    ftpServer->getBandwidthLimit ().recv.setRate (200 * 1024);
+  }
+
 
   // 7️⃣ Use FTP client to connect to ESP32's IP address
   while (WiFi.localIP () == IPAddress (0, 0, 0, 0)) { // wait until we get IP from router's DHCP
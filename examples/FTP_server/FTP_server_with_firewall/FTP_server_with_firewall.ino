@@ -1,7 +1,7 @@
 #include <WiFi.h>
 #include <LittleFS.h>             // Or SPIFFS.h or FFat.h or SD.h ...
 #include <threadSafeFS.h>         // Include thread-safe wrapper since LittleFS, FFat and SD file systems are not thread safe
-threadSafeFS::FS TSFS (LittleFS); // Crete thread-safe wrapper arround LittleFS (or FFat or SD)
+threadSafeFS::FS TSFS (LittleFS, "/littlefs"); // Crete thread-safe wrapper arround LittleFS (or FFat or SD), the mount point is needed by MFMT
 using File = threadSafeFS::File;  // Use thread-safe wrapper for all file operations form now on in your code
 #define HOSTNAME "Esp32Server"    // Choose your server's name - this is how FTP server would introduce itself to the clients
 #include <ftpServer.h>
@@ -10,12 +10,12 @@ using File = threadSafeFS::File;  // Use thread-safe wrapper for all file operat
 ftpServer_t *ftpServer = NULL;
 
 // 1️⃣ provide a firewall callback function to FTP server that would tell which connctions to accept and which to refuse
-bool firewallCallback (char *clientIP, char *serverIP) { 
+bool firewallCallback (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) { 
 
   // Must be reentrant !!
 
-  // accept only connections from local network, for example 10.18.1.*
-  if (strstr (clientIP, "10.18.1.") == clientIP)
+  // accept only connections from local network, for example 10.18.1.* (IPv4 addresses arrive in IPv4-mapped IPv6 form, the last 4 bytes are IPv4 address)
+  if (clientAddress.isIPv4 () && clientAddress.bytes [12] == 10 && clientAddress.bytes [13] == 18 && clientAddress.bytes [14] == 1)
     return true;
   else 
     return false; 
@@ -32,7 +32,7 @@ void setup () {
   ftpServer = new ftpServer_t (TSFS, NULL, 21, firewallCallback); // optional arguments:
                                                                   //    Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password) = NULL
                                                                   //    int serverPort = 21
-                                                                  //    bool (*firewallCallback) (char *clientIP, char *serverIP) = NULL
+                                                                  //    bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL
                                                                   //    bool runListenerInItsOwnTask = true
 
   // check if FTP server instance is created && FTP server is running
@@ -1,7 +1,7 @@
 #include <WiFi.h>
 #include <LittleFS.h>             // Or SPIFFS.h or FFat.h or SD.h ...
 #include <threadSafeFS.h>         // Include thread-safe wrapper since LittleFS, FFat and SD file systems are not thread safe
-threadSafeFS::FS TSFS (LittleFS); // Crete thread-safe wrapper arround LittleFS (or FFat or SD)
+threadSafeFS::FS TSFS (LittleFS, "/littlefs"); // Crete thread-safe wrapper arround LittleFS (or FFat or SD), the mount point is needed by MFMT
 using File = threadSafeFS::File;  // Use thread-safe wrapper for all file operations form now on in your code
 #define HOSTNAME "Esp32Server"    // Choose your server's name - this is how FTP server would introduce itself to the clients
 #include <ftpServer.h>
@@ -22,7 +22,7 @@ void setup () {
   ftpServer = new ftpServer_t (TSFS, NULL, 21, NULL, false);  // optional arguments:
                                                               //    Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password) = NULL
                                                               //    int serverPort = 21
-                                                              //    bool (*firewallCallback) (char *clientIP, char *serverIP) = NULL
+                                                              //    bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL
                                                               //    bool runListenerInItsOwnTask = true
 
   // check if FTP server instance is created && FTP server is running
@@ -0,0 +1,107 @@
+#include <WiFi.h>
+#include <LittleFS.h>             // Or SPIFFS.h or FFat.h or SD.h ...
+#include <threadSafeFS.h>         // Include thread-safe wrapper since LittleFS, FFat and SD file systems are not thread safe
+#define HOSTNAME "Esp32Server"    // Choose your server's name - this is how FTP server would introduce itself to the clients
+#include <ftpServer.h>
+
+
+// 1️⃣ Crete thread-safe wrapper arround LittleFS (or SPIFFS or FFat or SD)
+threadSafeFS::FS TSFS (LittleFS, "/littlefs"); // the mount point is needed by MFMT
+
+ftpServer_t *ftpServer = NULL;
+
+// without this callback anybody could log in with any user name and password, so the root only check in siteReboot wouldn't protect anything
+Cstring<255> getUserHomeDirectoryCallback (const Cstring<64>& userName, const Cstring<64>& password) {
+
+    // Must be reentrant !!
+
+    if (userName == "root" && password == "rootpassword")
+        return "/";             // full access to the file system and SITE REBOOT
+    if (userName == "bojan" && password == "bojanpassword")
+        return "/home/bojan";   // limited access to the file system
+    return "";                  // access (login) denyed
+}
+
+
+// 2️⃣ SITE command handlers get the control connection and the rest of the command line, they return FTP reply
+Cstring<300> siteUptime (ftpServer_t::ftpControlConnection_t& connection, char *arguments) {
+  char s [80];
+  sprintf (s, "200 up %lu s\r\n", millis () / 1000);
+  return s;
+}
+
+Cstring<300> siteReboot (ftpServer_t::ftpControlConnection_t& connection, char *arguments) {
+  if (strcmp (connection.getUserName (), "root"))
+    return "550 only root can reboot\r\n";
+  connection.sendString ("200 rebooting\r\n");
+  delay (100);
+  ESP.restart ();
+  return "";
+}
+
+
+// 3️⃣ Dispatch microbenchmark: the way commands used to be recognized (a chain of strcmp calls in the order of the old dispatcher) ...
+const char *oldDispatcherOrder [] = { "QUIT", "OPTS", "USER", "PASS", "PWD", "XPWD", "TYPE", "NOOP", "SYST", "FEAT", "PORT", "EPRT", "PASV", "EPSV",
+                                      "LIST", "NLST", "MLSD", "MLST", "SIZE", "XMKD", "MKD", "XRMD", "RMD", "DELE", "CWD", "RNFR", "RNTO", "REST", "RETR", "STOR", "APPE" };
+
+int strcmpChain (const char *command) {
+  for (int i = 0; i < sizeof (oldDispatcherOrder) / sizeof (oldDispatcherOrder [0]); i++)
+    if (!strcmp (command, oldDispatcherOrder [i]))
+      return i;
+  return -1;
+}
+
+// ... compared to the dispatch table, with a typical mix of commands of a client that synchronizes a directory
+const char *commandMix [] = { "CWD", "TYPE", "PASV", "LIST", "SIZE", "MDTM", "PASV", "RETR", "PASV", "STOR", "NOOP", "APPE", "stor", "XYZ" };
+#define DISPATCH_ROUNDS 10000
+
+void dispatchBenchmark () {
+  volatile int sink = 0;
+  int n = sizeof (commandMix) / sizeof (commandMix [0]);
+
+  unsigned long start = micros ();
+  for (int r = 0; r < DISPATCH_ROUNDS; r++)
+    for (int i = 0; i < n; i++)
+      sink += strcmpChain (commandMix [i]);
+  unsigned long strcmpMicros = micros () - start;
+
+  start = micros ();
+  for (int r = 0; r < DISPATCH_ROUNDS; r++)
+    for (int i = 0; i < n; i++)
+      sink += ftpServer_t::ftpControlConnection_t::commandIndex (commandMix [i]);
+  unsigned long tableMicros = micros () - start;
+
+  Serial.printf ("strcmp chain:   %.3f us per command\n", (float) strcmpMicros / (DISPATCH_ROUNDS * n));
+  Serial.printf ("dispatch table: %.3f us per command (case insensitive)\n", (float) tableMicros / (DISPATCH_ROUNDS * n));
+}
+
+
+void setup () {
+  Serial.begin (115200);
+
+  dispatchBenchmark ();
+
+  LittleFS.begin (true);
+  WiFi.begin ("YOUR_SSID", "YOUR_PASSWORD");
+
+  ftpServer = new (std::nothrow) ftpServer_t (TSFS, getUserHomeDirectoryCallback);
+  if (ftpServer && *ftpServer) {
+    Serial.println ("FTP server started");
+
+    // 4️⃣ Add SITE commands, FTP clients can send them as raw commands, for example: quote SITE UPTIME, quote SITE HELP
+    ftpServer->addSiteCommand ("UPTIME", siteUptime, "- time since the last reboot");
+    ftpServer->addSiteCommand ("REBOOT", siteReboot, "- restart ESP32 (root only)");
+  } else {
+    Serial.println ("FTP server did not start");
+  }
+
+  while (WiFi.localIP () == IPAddress (0, 0, 0, 0)) { // wait until we get IP from router's DHCP
+      delay (1000); 
+      Serial.println ("   ."); 
+  } 
+  Serial.print ("Got IP addess: "); Serial.println (WiFi.localIP ());
+}
+
+void loop () {
+
+}
@@ -0,0 +1,129 @@
+#include <WiFi.h>
+#include <tcpServer.h>
+#include <tcpClient.h>
+#include <networkImpairmentProxy.h>
+
+
+// Measures latency (small request - reply exchanges) and throughput (bulk transfer) of a TCP server under simulated link
+// conditions. The client connects to networkImpairmentProxy_t on PROXY_PORT which forwards the traffic to the server on
+// BENCHMARK_PORT, all over loopback interface (127.0.0.1). The same seed gives the same impairments each time, so the
+// results can be compared between builds to catch performance regressions. Replace the server with the one you want to
+// characterise (FTP, Telnet, ...) and the client side with its protocol.
+
+#define BENCHMARK_PORT 5003
+#define PROXY_PORT 5004
+#define PING_PONG_COUNT 50
+#define BULK_BYTES (64 * 1024)
+
+struct link_t {
+  const char *name;
+  linkImpairment_t impairment; // the same in both directions
+};
+link_t links [] = {
+  // name           latency  jitter  bandwidth  loss   reorder
+  { "loopback",     {   0,      0,        0,     0,      0    } },
+  { "good WiFi",    {   3,      2,        0,     0,      0    } },
+  { "busy WiFi",    {  15,     10,   200000,  0.01f,  0.02f   } },
+  { "poor WiFi",    {  50,     40,    50000,  0.05f,  0.05f   } },
+};
+
+
+// 1️⃣ Server side: the first byte of the connection selects the test: 'p' = echo everything back, 'b' = read BULK_BYTES and then reply with 1 byte
+void serverTask (void *param) {
+  tcpServer_t *server = (tcpServer_t *) param;
+  char buf [1440];
+  while (true) {
+    tcpConnection_t *connection = server->accept ();
+    if (!connection) {
+      delay (10);
+      continue;
+    }
+    connection->setIdleTimeout (30);
+
+    if (connection->recvBlock (buf, 1) == 1) {
+      if (buf [0] == 'p') {
+        int n;
+        while ((n = connection->recv (buf, sizeof (buf))) > 0)
+          if (connection->sendBlock (buf, n) <= 0)
+            break;
+      } else {
+        long remaining = BULK_BYTES;
+        int n = 0;
+        while (remaining > 0 && (n = connection->recv (buf, min ((long) sizeof (buf), remaining))) > 0)
+          remaining -= n;
+        if (remaining == 0)
+          connection->sendBlock ((void *) "k", 1);
+      }
+    }
+    delete connection;
+  }
+}
+
+
+void setup () {
+  Serial.begin (115200);
+  WiFi.begin ("YOUR_SSID", "YOUR_PASSWORD");
+  while (WiFi.localIP () == IPAddress (0, 0, 0, 0)) { // wait until we get IP from router's DHCP
+      delay (1000);
+      Serial.println ("   .");
+  }
+  Serial.print ("Got IP addess: "); Serial.println (WiFi.localIP ());
+
+
+  // 2️⃣ Start the server without listener's task, serverTask accepts the connections
+  tcpServer_t *server = new (std::nothrow) tcpServer_t (BENCHMARK_PORT, NULL, false);
+  if (!server || !*server) {
+    Serial.println ("server did not start");
+    return;
+  }
+  xTaskCreate (serverTask, "benchmark", 4 * 1024, server, tskIDLE_PRIORITY + 1, NULL);
+
+
+  // 3️⃣ Start the proxy in front of the server
+  networkImpairmentProxy_t *proxy = new (std::nothrow) networkImpairmentProxy_t (PROXY_PORT, "127.0.0.1", BENCHMARK_PORT);
+  if (!proxy || !*proxy) {
+    Serial.println ("proxy did not start");
+    return;
+  }
+
+
+  // 4️⃣ Client side: run both tests over each link
+  char buf [1440] = {};
+  for (link_t& link : links) {
+    proxy->setImpairment (link.impairment, link.impairment);
+
+    // latency: 1 byte request, 1 byte reply
+    unsigned long latency = 0;
+    {
+      tcpClient_t client ("127.0.0.1", PROXY_PORT);
+      client.setIdleTimeout (30);
+      client.sendBlock ((void *) "p", 1);
+      unsigned long startMicros = micros ();
+      for (int i = 0; i < PING_PONG_COUNT; i++)
+        if (client.sendBlock (buf, 1) <= 0 || client.recvBlock (buf, 1) <= 0)
+          break;
+      latency = (micros () - startMicros) / PING_PONG_COUNT;
+    }
+
+    // throughput: BULK_BYTES in 1440 byte blocks
+    unsigned long throughput = 0;
+    {
+      tcpClient_t client ("127.0.0.1", PROXY_PORT);
+      client.setIdleTimeout (30);
+      client.sendBlock ((void *) "b", 1);
+      unsigned long startMillis = millis ();
+      long remaining = BULK_BYTES;
+      while (remaining > 0 && client.sendBlock (buf, min ((long) sizeof (buf), remaining)) > 0)
+        remaining -= min ((long) sizeof (buf), remaining);
+      if (remaining == 0 && client.recvBlock (buf, 1) == 1)
+        throughput = (unsigned long) ((uint64_t) BULK_BYTES * 1000 / max (millis () - startMillis, 1UL));
+    }
+
+    delay (500); // let the proxy finish the sessions so their statistics are counted
+    Serial.printf ("%-10s round-trip: %7lu us   throughput: %7lu B/s   segments: %5lu lost: %3lu reordered: %3lu\n", link.name, latency, throughput, proxy->getSegments (), proxy->getLost (), proxy->getReordered ());
+  }
+}
+
+void loop () {
+
+}
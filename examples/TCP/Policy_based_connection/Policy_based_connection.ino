@@ -0,0 +1,166 @@
+#include <WiFi.h>
+#include <tcpServer.h>
+#include <tcpClient.h>
+#include <tcpConnectionT.h>
+
+
+// Compares tcpConnection_t with two tcpConnectionT configurations: the one that behaves the same as tcpConnection_t and the
+// minimal one, without locking, accounting and time-out.
+//
+// CPU: the client sends BULK_BYTES over loopback interface (127.0.0.1). The server waits (with select, outside of the measured
+// part) until the data is there and only then calls recv, so the CPU cycles counted inside recv are the cost of the call
+// itself and not the time spent waiting for the data.
+//
+// Code size: the sketch can't measure its own code size, build it once for each BENCHMARK_VARIANT and compare the
+// "Sketch uses ... bytes" lines that Arduino IDE prints:
+//
+//      BENCHMARK_VARIANT 0     tcpConnection_t only
+//      BENCHMARK_VARIANT 1     tcpConnectionT full only
+//      BENCHMARK_VARIANT 2     tcpConnectionT minimal only
+//      BENCHMARK_VARIANT 3     all three (the CPU comparison)
+//
+// tcpConnection_t is always linked in since tcpServer_t and tcpClient_t use it, so the differences between the builds
+// show the code that each variant adds to the sketch.
+
+#ifndef BENCHMARK_VARIANT
+    #define BENCHMARK_VARIANT 3
+#endif
+
+#define BENCHMARK_SERVER "127.0.0.1"
+#define BENCHMARK_PORT 5002
+#define BULK_BYTES (256 * 1024)
+
+typedef tcpConnectionT<lwIpMutexLocking_t, trafficAccounting_t, idleTimeout_t> fullConnection_t;
+typedef tcpConnectionT<noLocking_t, noAccounting_t, noTimeout_t> minimalConnection_t;
+
+const char *variants [] = { "tcpConnection_t", "tcpConnectionT full", "tcpConnectionT minimal" };
+volatile int currentVariant = 0;
+volatile uint32_t recvCycles = 0; // the result of the last measurement
+volatile unsigned long recvCalls = 0;
+
+
+// waits until the socket is readable, this is not measured
+bool waitReadable (int sockfd) {
+  fd_set readfds;
+  FD_ZERO (&readfds);
+  FD_SET (sockfd, &readfds);
+  struct timeval tv = { 5, 0 };
+  return select (sockfd + 1, &readfds, NULL, NULL, &tv) > 0;
+}
+
+// receives BULK_BYTES with any kind of connection and counts CPU cycles spent inside recv calls that had data waiting
+template<class connection_t>
+void receiveBulk (connection_t& connection, int sockfd) {
+  char buf [1440];
+  uint32_t spent = 0;
+  unsigned long calls = 0;
+  long remaining = BULK_BYTES;
+  while (remaining > 0) {
+    if (!waitReadable (sockfd))
+      break;
+    uint32_t startCycles = ESP.getCycleCount ();
+    int n = connection.recv (buf, min ((long) sizeof (buf), remaining));
+    spent += ESP.getCycleCount () - startCycles;
+    calls ++;
+    if (n <= 0)
+      break;
+    remaining -= n;
+  }
+  recvCycles = remaining == 0 ? spent : 0;
+  recvCalls = calls;
+  connection.sendBlock ((void *) "k", 1);
+}
+
+
+// 1️⃣ Server side: accepts the socket and hands it over to the variant being measured
+void serverTask (void *param) {
+  tcpServer_t *server = (tcpServer_t *) param;
+  while (true) {
+    #if BENCHMARK_VARIANT == 0 || BENCHMARK_VARIANT == 3
+      if (currentVariant == 0) {
+        tcpConnection_t *connection = server->accept ();
+        if (connection) {
+          connection->setIdleTimeout (5);
+          receiveBulk (*connection, connection->getSocket ());
+          delete connection;
+          continue;
+        }
+        delay (10);
+        continue;
+      }
+    #endif
+    ipAddress_t clientAddress, serverAddress;
+    int connectionSocket = server->acceptSocket (clientAddress, serverAddress);
+    if (connectionSocket >= 0) {
+      #if BENCHMARK_VARIANT == 1 || BENCHMARK_VARIANT == 3
+        if (currentVariant == 1) {
+          fullConnection_t connection (connectionSocket);
+          connection.setIdleTimeout (5);
+          receiveBulk (connection, connectionSocket);
+          continue;
+        }
+      #endif
+      #if BENCHMARK_VARIANT == 2 || BENCHMARK_VARIANT == 3
+        if (currentVariant == 2) {
+          minimalConnection_t connection (connectionSocket);
+          receiveBulk (connection, connectionSocket);
+          continue;
+        }
+      #endif
+      close (connectionSocket);
+      continue;
+    }
+    delay (10);
+  }
+}
+
+
+void setup () {
+  Serial.begin (115200);
+  WiFi.begin ("YOUR_SSID", "YOUR_PASSWORD");
+  while (WiFi.localIP () == IPAddress (0, 0, 0, 0)) { // wait until we get IP from router's DHCP
+      delay (1000);
+      Serial.println ("   .");
+  }
+  Serial.print ("Got IP addess: "); Serial.println (WiFi.localIP ());
+
+  Serial.printf ("sizeof: tcpConnection_t %u, tcpConnectionT full %u, tcpConnectionT minimal %u bytes\n", sizeof (tcpConnection_t), sizeof (fullConnection_t), sizeof (minimalConnection_t));
+
+
+  // 2️⃣ Start the server without listener's task, serverTask accepts the connections
+  tcpServer_t *server = new (std::nothrow) tcpServer_t (BENCHMARK_PORT, NULL, false);
+  if (!server || !*server) {
+    Serial.println ("server did not start");
+    return;
+  }
+  xTaskCreate (serverTask, "benchmark", 4 * 1024, server, tskIDLE_PRIORITY + 1, NULL);
+
+
+  // 3️⃣ Client side: send BULK_BYTES to each variant that is compiled in
+  char buf [1440] = {};
+  for (int variant = 0; variant < (int) (sizeof (variants) / sizeof (variants [0])); variant++) {
+    if (BENCHMARK_VARIANT != 3 && BENCHMARK_VARIANT != variant)
+      continue;
+    currentVariant = variant;
+    recvCycles = 0;
+    {
+      tcpClient_t client (BENCHMARK_SERVER, BENCHMARK_PORT);
+      client.setIdleTimeout (5);
+      long remaining = BULK_BYTES;
+      while (remaining > 0 && client.sendBlock (buf, min ((long) sizeof (buf), remaining)) > 0)
+        remaining -= min ((long) sizeof (buf), remaining);
+      client.recvBlock (buf, 1); // wait until the server is done
+    }
+
+    Serial.printf ("%-24s CPU cycles in recv: %9lu   %4lu cycles/call   %3lu.%02lu cycles/byte\n", variants [variant], (unsigned long) recvCycles,
+                                                                                                   recvCalls ? (unsigned long) (recvCycles / recvCalls) : 0,
+                                                                                                   (unsigned long) (recvCycles / BULK_BYTES), (unsigned long) ((uint64_t) recvCycles * 100 / BULK_BYTES % 100));
+    delay (500);
+  }
+
+  Serial.println ("Build the sketch with BENCHMARK_VARIANT 0, 1 and 2 to compare the code size of the variants.");
+}
+
+void loop () {
+
+}
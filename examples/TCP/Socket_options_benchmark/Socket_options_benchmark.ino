@@ -0,0 +1,116 @@
+#include <WiFi.h>
+#include <tcpServer.h>
+#include <tcpClient.h>
+
+
+// Measures the effect of socket options profiles on latency (small request - reply exchanges) and throughput (bulk transfer).
+// The benchmark runs over loopback interface (127.0.0.1), to measure it over WiFi run the echo server on another ESP32 and
+// change BENCHMARK_SERVER to its IP address.
+
+#define BENCHMARK_SERVER "127.0.0.1"
+#define BENCHMARK_PORT 5001
+#define PING_PONG_COUNT 100
+#define BULK_BYTES (256 * 1024)
+
+struct profile_t {
+  const char *name;
+  const socketOptions_t *options;
+};
+socketOptions_t defaultOptions;
+profile_t profiles [] = { { "lwIP defaults", &defaultOptions }, { "interactive", &socketOptions_t::interactive () }, { "bulk", &socketOptions_t::bulk () } };
+volatile int currentProfile = 0; // the server uses the same profile as the client
+
+
+// 1️⃣ Server side: the first byte of the connection selects the test: 'p' = echo everything back, 'b' = read BULK_BYTES and then reply with 1 byte
+void serverTask (void *param) {
+  tcpServer_t *server = (tcpServer_t *) param;
+  char buf [1440];
+  while (true) {
+    tcpConnection_t *connection = server->accept ();
+    if (!connection) {
+      delay (10);
+      continue;
+    }
+    connection->setSocketOptions (*profiles [currentProfile].options);
+    connection->setIdleTimeout (5);
+
+    if (connection->recvBlock (buf, 1) == 1) {
+      if (buf [0] == 'p') {
+        int n;
+        while ((n = connection->recv (buf, sizeof (buf))) > 0)
+          if (connection->sendBlock (buf, n) <= 0)
+            break;
+      } else {
+        long remaining = BULK_BYTES;
+        int n = 0;
+        while (remaining > 0 && (n = connection->recv (buf, min ((long) sizeof (buf), remaining))) > 0)
+          remaining -= n;
+        if (remaining == 0)
+          connection->sendBlock ((void *) "k", 1);
+      }
+    }
+    delete connection;
+  }
+}
+
+
+void setup () {
+  Serial.begin (115200);
+  WiFi.begin ("YOUR_SSID", "YOUR_PASSWORD");
+  while (WiFi.localIP () == IPAddress (0, 0, 0, 0)) { // wait until we get IP from router's DHCP
+      delay (1000);
+      Serial.println ("   .");
+  }
+  Serial.print ("Got IP addess: "); Serial.println (WiFi.localIP ());
+
+
+  // 2️⃣ Start the server without listener's task, serverTask accepts the connections
+  tcpServer_t *server = new (std::nothrow) tcpServer_t (BENCHMARK_PORT, NULL, false);
+  if (!server || !*server) {
+    Serial.println ("server did not start");
+    return;
+  }
+  xTaskCreate (serverTask, "benchmark", 4 * 1024, server, tskIDLE_PRIORITY + 1, NULL);
+
+
+  // 3️⃣ Client side: run both tests with each profile
+  char buf [1440] = {};
+  for (currentProfile = 0; currentProfile < (int) (sizeof (profiles) / sizeof (profiles [0])); currentProfile++) {
+
+    // latency: 1 byte request, 1 byte reply
+    unsigned long latency = 0;
+    {
+      tcpClient_t client (BENCHMARK_SERVER, BENCHMARK_PORT);
+      client.setSocketOptions (*profiles [currentProfile].options);
+      client.setIdleTimeout (5);
+      client.sendBlock ((void *) "p", 1);
+      unsigned long startMicros = micros ();
+      for (int i = 0; i < PING_PONG_COUNT; i++)
+        if (client.sendBlock (buf, 1) <= 0 || client.recvBlock (buf, 1) <= 0)
+          break;
+      latency = (micros () - startMicros) / PING_PONG_COUNT;
+    }
+
+    // throughput: BULK_BYTES in 1440 byte blocks
+    unsigned long throughput = 0;
+    {
+      tcpClient_t client (BENCHMARK_SERVER, BENCHMARK_PORT);
+      client.setSocketOptions (*profiles [currentProfile].options);
+      client.setIdleTimeout (5);
+      client.sendBlock ((void *) "b", 1);
+      unsigned long startMillis = millis ();
+      long remaining = BULK_BYTES;
+      while (remaining > 0 && client.sendBlock (buf, min ((long) sizeof (buf), remaining)) > 0)
+        remaining -= min ((long) sizeof (buf), remaining);
+      if (remaining == 0 && client.recvBlock (buf, 1) == 1)
+        throughput = (unsigned long) ((uint64_t) BULK_BYTES * 1000 / max (millis () - startMillis, 1UL));
+    }
+
+    Serial.printf ("%-14s round-trip: %6lu us   throughput: %7lu B/s\n", profiles [currentProfile].name, latency, throughput);
+    delay (500);
+  }
+}
+
+void loop () {
+
+}
@@ -15,6 +15,7 @@ using File = threadSafeFS::File;  // Use thread-safe wrapper for all file operat
 #define TELNET_NOHUP_COMMAND 0      // 0=exclude, 1=include, nohup is included by default
 #define TELNET_REBOOT_COMMAND 0     // 0=exclude, 1=include, reboot is included by default
 #define TELNET_DMESG_COMMAND 0      // 0=exclude, 1=include, dmesg is included by default
+#define TELNET_SYSCTL_COMMAND 1     // 0=exclude, 1=include, sysctl is included by default
 #define TELNET_QUIT_COMMAND 1       // 0=exclude, 1=include, quit is included by default
 #define TELNET_UPTIME_COMMAND 1     // 0=exclude, 1=include, date is included by default
 #define TELNET_DATE_COMMAND 1       // 0=exclude, 1=include, date is included by default
@@ -56,6 +57,7 @@ void setup () {
 
   // 3️⃣ Start LittleFS (or FFat or SD)
   SPIFFS.begin (true);
+  loadTunables (TSFS); // tuning parameters changed with sysctl -w and saved with sysctl -s (in /etc/sysctl.conf), before the servers start
 
 
   // 4️⃣ Start WiFi connection
@@ -67,7 +69,7 @@ void setup () {
                                                             // Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password) = NULL
                                                             // String (*telnetCommandHandlerCallback) (int argc, char *argv [], telnetConnection_t *tcn) = NULL
                                                             // int serverPort = 23
-                                                            // bool (*firewallCallback) (char *clientIP, char *serverIP) = NULL
+                                                            // bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL
                                                             // bool runListenerInItsOwnTask = true
 
 
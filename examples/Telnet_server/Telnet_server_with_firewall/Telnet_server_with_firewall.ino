@@ -38,16 +38,18 @@
 #include <telnetServer.h>
 
 telnetServer_t *telnetServer = NULL;
+firewall_t firewall;
+connectionRateLimiter_t connectionRateLimiter (0.1, 3); // 3 connections from the same IP at once, then 1 per 10 s
 
 
 // 1️⃣ provide a firewall callback function to FTP server that would tell which connctions to accept and which to refuse
-bool firewallCallback (char *clientIP, char *serverIP) { 
+bool firewallCallback (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) { 
 
   // Must be reentrant !!
 
 
-  // accept only connections from local network, for example 10.18.1.*
-  if (strstr (clientIP, "10.18.1.") == clientIP)
+  // accept only connections from local network, for example 10.18.1.* (IPv4 addresses arrive in IPv4-mapped IPv6 form, the last 4 bytes are IPv4 address)
+  if (clientAddress.isIPv4 () && clientAddress.bytes [12] == 10 && clientAddress.bytes [13] == 18 && clientAddress.bytes [14] == 1)
     return true;
   else 
     return false; 
@@ -64,7 +66,7 @@ void setup () {
                                                                                         // Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password) = NULL
                                                                                         // String (*telnetCommandHandlerCallback) (int argc, char *argv [], telnetConnection_t *tcn) = NULL
                                                                                         // int serverPort = 23
-                                                                                        // bool (*firewallCallback) (char *clientIP, char *serverIP) = NULL
+                                                                                        // bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL
                                                                                         // bool runListenerInItsOwnTask = true
                                                         
 
@@ -74,6 +76,20 @@ void setup () {
   else
     Serial.println ("Telnet server did not start");
 
+
+  // 3️⃣ instead of (or in addition to) the callback, compiled CIDR rules can be used, the longest matching prefix decides
+  const char *errText = firewall.load ("allow 10.18.1.0/24, allow 127.0.0.1, deny 0.0.0.0/0, deny ::/0");
+  if (errText)
+    Serial.printf ("firewall rules not loaded: %s\n", errText);
+  else if (telnetServer)
+    telnetServer->setFirewall (&firewall);
+
+
+  // 4️⃣ slow down brute-force login attempts by limiting the rate of connections from the same IP address
+  if (telnetServer)
+    telnetServer->setConnectionRateLimiter (&connectionRateLimiter);
+
+
   // Use Telent client to connect to ESP32's IP address
   while (WiFi.localIP () == IPAddress (0, 0, 0, 0)) { // wait until we get IP from router's DHCP
       delay (1000); 
@@ -87,4 +103,16 @@ void setup () {
 
 void loop () {
 
+  // 5️⃣ report the IP addresses that have been rejected by connection rate limiter
+  static unsigned long lastReport = 0;
+  if (millis () - lastReport > 60000) {
+    lastReport = millis ();
+    ipAddress_t address;
+    unsigned long drops;
+    for (int i = 0; connectionRateLimiter.getTrackedAddress (i, address, drops); i++)
+      if (drops)
+        Serial.printf ("%s: %lu connections rejected\n", address.toString ().c_str (), drops);
+    Serial.printf ("tracked IP addresses: %i, all rejected connections: %lu\n", connectionRateLimiter.getTrackedAddressCount (), connectionRateLimiter.getDrops ());
+  }
+
 }
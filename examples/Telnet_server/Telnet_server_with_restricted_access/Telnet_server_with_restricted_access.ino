@@ -74,7 +74,7 @@ void setup () {
                                                                                           // Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password) = NULL
                                                                                           // String (*telnetCommandHandlerCallback) (int argc, char *argv [], telnetConnection_t *tcn) = NULL
                                                                                           // int serverPort = 23
-                                                                                          // bool (*firewallCallback) (char *clientIP, char *serverIP) = NULL
+                                                                                          // bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL
                                                                                           // bool runListenerInItsOwnTask = true
                                                         
                                                         
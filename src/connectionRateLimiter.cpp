@@ -0,0 +1,131 @@
+/*
+
+    connectionRateLimiter.cpp
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 29, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        connectionRateLimiter_t
+
+*/
+
+
+#include <WiFi.h>
+#include "connectionRateLimiter.h"
+
+
+// IPv6 clients usually get a whole /64 so they could change the address for each connection, count them by /64 prefix
+static ipAddress_t __bucketKey__ (const ipAddress_t& address) {
+    ipAddress_t key = address;
+    if (!key.isIPv4 ())
+        memset (key.bytes + 8, 0, 8);
+    return key;
+}
+
+// FNV-1a hash of all 16 bytes of the address
+static uint32_t __addressHash__ (const ipAddress_t& address) {
+    uint32_t h = 2166136261;
+    for (int i = 0; i < 16; i++)
+        h = (h ^ address.bytes [i]) * 16777619;
+    return h;
+}
+
+
+connectionRateLimiter_t::connectionRateLimiter_t (float connectionsPerSecond, int burst) {
+    __connectionsPerSecond__ = connectionsPerSecond;
+    __burst__ = burst;
+    __mutex__ = xSemaphoreCreateMutex ();
+}
+
+connectionRateLimiter_t::~connectionRateLimiter_t () { vSemaphoreDelete (__mutex__); }
+
+bool connectionRateLimiter_t::allows (const ipAddress_t& address) {
+    unsigned long now = millis ();
+    ipAddress_t key = __bucketKey__ (address);
+    uint32_t h = __addressHash__ (key);
+    bool allow;
+
+    xSemaphoreTake (__mutex__, portMAX_DELAY);
+
+        // find address's bucket or the slot to put it in: an empty one or else the one with the most tokens (the least recently used one of them) within the probe window
+        bucket_t *bucket = NULL;
+        bucket_t *victim = NULL;
+        float victimTokens = 0;
+        for (int i = 0; i < TCP_RATE_LIMITER_PROBES; i++) {
+            bucket_t *b = &__table__ [(h + i) % TCP_RATE_LIMITER_TABLE_SIZE];
+            if (b->used && b->address == key) {
+                bucket = b;
+                break;
+            }
+            if (victim && !victim->used)
+                continue; // an empty slot is the best victim
+            float bTokens = b->used ? __refilled__ (b, now) : __burst__;
+            if (!victim || !b->used || bTokens > victimTokens || (bTokens == victimTokens && now - b->lastMillis > now - victim->lastMillis)) {
+                victim = b;
+                victimTokens = bTokens;
+            }
+        }
+        if (!bucket) {
+            // the new address takes over the evicted one's tokens, so that addresses pushing each other out of the table don't get a fresh burst each time
+            bucket = victim;
+            *bucket = { key, true, victim->used ? victimTokens : __burst__, now, 0 };
+        }
+
+        // refill
+        bucket->tokens = __refilled__ (bucket, now);
+        bucket->lastMillis = now;
+
+        // take a token
+        if (bucket->tokens >= 1) {
+            bucket->tokens -= 1;
+            allow = true;
+        } else {
+            bucket->drops ++;
+            __drops__ ++;
+            allow = false;
+        }
+
+    xSemaphoreGive (__mutex__);
+    return allow;
+}
+
+float connectionRateLimiter_t::__refilled__ (const bucket_t *bucket, unsigned long now) {
+    float tokens = bucket->tokens + (now - bucket->lastMillis) * __connectionsPerSecond__ / 1000;
+    return tokens > __burst__ ? __burst__ : tokens;
+}
+
+int connectionRateLimiter_t::getTrackedAddressCount () {
+    int count = 0;
+    xSemaphoreTake (__mutex__, portMAX_DELAY);
+        for (int i = 0; i < TCP_RATE_LIMITER_TABLE_SIZE; i++)
+            if (__table__ [i].used)
+                count ++;
+    xSemaphoreGive (__mutex__);
+    return count;
+}
+
+unsigned long connectionRateLimiter_t::getDrops () {
+    xSemaphoreTake (__mutex__, portMAX_DELAY);
+        unsigned long drops = __drops__;
+    xSemaphoreGive (__mutex__);
+    return drops;
+}
+
+bool connectionRateLimiter_t::getTrackedAddress (int index, ipAddress_t& address, unsigned long& drops) {
+    bool found = false;
+    xSemaphoreTake (__mutex__, portMAX_DELAY);
+        for (int i = 0; i < TCP_RATE_LIMITER_TABLE_SIZE; i++)
+            if (__table__ [i].used && index-- == 0) {
+                address = __table__ [i].address;
+                drops = __table__ [i].drops;
+                found = true;
+                break;
+            }
+    xSemaphoreGive (__mutex__);
+    return found;
+}
@@ -0,0 +1,90 @@
+/*
+
+    connectionRateLimiter.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 29, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        connectionRateLimiter_t
+
+    connectionRateLimiter_t keeps a token bucket for each client's IP address. Each accepted connection takes one token, the
+    bucket refills at connectionsPerSecond up to burst tokens. A connection that finds the bucket empty is rejected before
+    the server allocates anything for it.
+
+    IPv4 addresses have a bucket each, IPv6 addresses share a bucket per /64 prefix since a client usually gets a whole /64
+    and could use a different address for each connection.
+
+    Buckets are kept in a fixed size hash table. An address may only be placed in TCP_RATE_LIMITER_PROBES consecutive slots
+    after its hash, when they are all taken the one with the most tokens is reused (a full bucket carries no information).
+    The new address takes over the evicted bucket's tokens, so addresses that keep pushing each other out of the table
+    don't get a fresh burst each time.
+
+*/
+
+
+#pragma once
+#ifndef __CONNECTION_RATE_LIMITER__
+    #define __CONNECTION_RATE_LIMITER__
+
+
+    #include <WiFi.h>
+    #include "ipAddress.h"
+
+
+    // TUNING PARAMETERS
+
+    #ifndef TCP_RATE_LIMITER_TABLE_SIZE
+        #define TCP_RATE_LIMITER_TABLE_SIZE 32          // number of client's IP addresses tracked at the same time
+    #endif
+    #ifndef TCP_RATE_LIMITER_PROBES
+        #define TCP_RATE_LIMITER_PROBES 4               // number of table slots an address can occupy
+    #endif
+    #ifndef TCP_RATE_LIMITER_RATE
+        #define TCP_RATE_LIMITER_RATE 0.2               // default: 1 connection per 5 s from the same IP address ...
+    #endif
+    #ifndef TCP_RATE_LIMITER_BURST
+        #define TCP_RATE_LIMITER_BURST 5                // ... after the first 5 connections
+    #endif
+
+
+    class connectionRateLimiter_t {
+
+        public:
+
+            connectionRateLimiter_t (float connectionsPerSecond = TCP_RATE_LIMITER_RATE, int burst = TCP_RATE_LIMITER_BURST);
+            ~connectionRateLimiter_t ();
+
+            // takes a token from address's bucket, returns false if there was none
+            bool allows (const ipAddress_t& address);
+
+            // statistics
+            int getTrackedAddressCount ();
+            bool getTrackedAddress (int index, ipAddress_t& address, unsigned long& drops);  // index goes over tracked addresses (/64 prefixes for IPv6) only, 0 .. getTrackedAddressCount () - 1
+            unsigned long getDrops ();  // all rejected connections, including those from already evicted addresses
+
+        private:
+
+            struct bucket_t {
+                ipAddress_t address;
+                bool used;
+                float tokens;
+                unsigned long lastMillis;   // last refill, also used for LRU eviction
+                unsigned long drops;
+            };
+
+            float __refilled__ (const bucket_t *bucket, unsigned long now); // bucket's tokens at now, the caller must hold __mutex__
+
+            bucket_t __table__ [TCP_RATE_LIMITER_TABLE_SIZE] = {};
+            float __connectionsPerSecond__;
+            float __burst__;
+            unsigned long __drops__ = 0;
+
+            SemaphoreHandle_t __mutex__;
+    };
+
+#endif
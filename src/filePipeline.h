@@ -0,0 +1,217 @@
+/*
+
+    filePipeline.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 24, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        filePipeline_t
+
+    filePipeline_t overlaps file system access with network transfer. A helper task does the file I/O through a ring of
+    buffers while the calling task does the network I/O, so the time spent waiting for flash (or SD card) and the time
+    spent waiting for the network no longer add up.
+
+    READING (download): the helper task reads the file into empty buffers while the calling task sends the full ones.
+
+        helper task:    read 0 │ read 1 │ read 0 │ read 1 │ ...
+        calling task:          │ send 0 │ send 1 │ send 0 │ ...
+
+    The calling task gets full buffers with nextBlock () and gives each one back with releaseBlock () when it is sent.
+
+    WRITING (upload): the calling task receives into empty buffers while the helper task writes the full ones to the file.
+
+        calling task:   recv 0 │ recv 1 │ recv 2 │ recv 0 │ ...
+        helper task:           │ write 0│ write 1│ write 2│ ...
+
+    The calling task gets an empty buffer with emptyBlock (), hands it over with writeBlock () and calls finish () at the
+    end to wait until everything is written. Filling whole buffers before handing them over turns many small writes into
+    a few large ones, which is what flash likes best.
+
+    Either side waits only when it is a whole ring ahead of the other one, so the memory used is bufferCount * bufferSize
+    regardless of the file size.
+
+*/
+
+
+#pragma once
+#ifndef __FILE_PIPELINE__
+    #define __FILE_PIPELINE__
+
+
+    #include <WiFi.h>
+    #include <esp_heap_caps.h>
+    #include <threadSafeFS.h>
+    #include <dmesg.hpp>
+    #include <ostream.hpp>
+
+
+    // TUNING PARAMETERS
+
+    #ifndef FILE_PIPELINE_STACK_SIZE
+        #define FILE_PIPELINE_STACK_SIZE (3 * 1024)     // LittleFS and SD calls are made from this stack
+    #endif
+
+
+    class filePipeline_t {
+
+        public:
+
+            enum DIRECTION_TYPE { READING = 0, WRITING = 1 };
+
+            // the file must stay open until the pipeline is destroyed
+            filePipeline_t (threadSafeFS::File& file, DIRECTION_TYPE direction, int bufferCount, size_t bufferSize, bool psram = false) : __file__ (file),
+                                                                                                                                        __direction__ (direction),
+                                                                                                                                        __bufferCount__ (bufferCount),
+                                                                                                                                        __bufferSize__ (bufferSize) {
+                if (psram)
+                    __buffers__ = (char *) heap_caps_malloc (bufferCount * bufferSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                if (!__buffers__)
+                    __buffers__ = (char *) heap_caps_malloc (bufferCount * bufferSize, MALLOC_CAP_8BIT);
+                // one more place than there are buffers for the message that stops the helper task
+                __emptyQueue__ = xQueueCreate (bufferCount + 1, sizeof (int));
+                __fullQueue__ = xQueueCreate (bufferCount + 1, sizeof (__block__));
+                __finished__ = xSemaphoreCreateBinary ();
+                if (!__buffers__ || !__emptyQueue__ || !__fullQueue__ || !__finished__) {
+                    cout << ( dmesgQueue << "[filePipeline] " << "can't allocate " << (unsigned long) (bufferCount * bufferSize) << " bytes of buffers" );
+                    __free__ ();
+                    return;
+                }
+
+                for (int i = 0; i < bufferCount; i++)
+                    xQueueSend (__emptyQueue__, &i, 0);
+
+                #define tskNORMAL_PRIORITY (tskIDLE_PRIORITY + 1)
+                if (pdPASS != xTaskCreate (direction == READING ? __reader__ : __writer__, "filePipeline", FILE_PIPELINE_STACK_SIZE, this, tskNORMAL_PRIORITY, NULL)) {
+                    cout << ( dmesgQueue << "[filePipeline] " << "can't create helper task, out of memory" );
+                    __free__ ();
+                    return;
+                }
+                __running__ = true;
+            }
+
+            ~filePipeline_t () {
+                if (__running__) {
+                    if (__direction__ == WRITING) {
+                        finish ();
+                    } else {
+                        // the reader may be waiting for an empty buffer, wake it up so it can see that it has to stop
+                        __stopping__ = true;
+                        int anyBuffer = 0;
+                        xQueueSend (__emptyQueue__, &anyBuffer, 0);
+                        xSemaphoreTake (__finished__, portMAX_DELAY);
+                    }
+                }
+                __free__ ();
+            }
+
+            filePipeline_t (const filePipeline_t&) = delete;
+            filePipeline_t& operator = (const filePipeline_t&) = delete;
+
+            inline operator bool () __attribute__((always_inline)) { return __running__; }
+
+            // READING: waits for the next full buffer and returns the number of bytes in it, 0 at the end of file or -1 if reading the file failed (don't call it after that)
+            int nextBlock (char *&data) {
+                if (!__running__ || xQueueReceive (__fullQueue__, &__current__, portMAX_DELAY) != pdTRUE)
+                    return 0;
+                data = __buffers__ + __current__.index * __bufferSize__;
+                return __current__.length;
+            }
+
+            // READING: gives the buffer returned by the last nextBlock back to the reader
+            inline void releaseBlock () __attribute__((always_inline)) { xQueueSend (__emptyQueue__, &__current__.index, 0); }
+
+            // WRITING: waits for an empty buffer (this is where the calling task waits when the writer falls behind) and returns its size
+            size_t emptyBlock (char *&data) {
+                if (!__running__ || xQueueReceive (__emptyQueue__, &__current__.index, portMAX_DELAY) != pdTRUE)
+                    return 0;
+                data = __buffers__ + __current__.index * __bufferSize__;
+                return __bufferSize__;
+            }
+
+            // WRITING: hands the first length bytes of the buffer returned by the last emptyBlock over to the writer
+            void writeBlock (int length) {
+                if (length <= 0) {
+                    xQueueSend (__emptyQueue__, &__current__.index, 0); // nothing to write, 0 length would stop the writer
+                    return;
+                }
+                __current__.length = length;
+                xQueueSend (__fullQueue__, &__current__, portMAX_DELAY);
+            }
+
+            // WRITING: waits until all the blocks are written, returns false if any of the writes failed
+            bool finish () {
+                if (__running__) {
+                    __block__ endOfFile = { 0, 0 };
+                    xQueueSend (__fullQueue__, &endOfFile, portMAX_DELAY);
+                    xSemaphoreTake (__finished__, portMAX_DELAY);
+                    __running__ = false;
+                }
+                return !__writeFailed__;
+            }
+
+            // WRITING: the calling task can stop receiving as soon as the first write fails
+            inline bool writeFailed () __attribute__((always_inline)) { return __writeFailed__; }
+
+        private:
+
+            threadSafeFS::File& __file__;
+            DIRECTION_TYPE __direction__;
+            int __bufferCount__;
+            size_t __bufferSize__;
+            char *__buffers__ = NULL;
+
+            struct __block__ {
+                int index;
+                int length;
+            };
+            __block__ __current__ = {};
+
+            QueueHandle_t __emptyQueue__ = NULL;    // indexes of buffers that can be filled
+            QueueHandle_t __fullQueue__ = NULL;     // buffers that can be sent or written, each buffer is in one of the queues or in use
+            SemaphoreHandle_t __finished__ = NULL;
+            bool __running__ = false;
+            volatile bool __stopping__ = false;
+            volatile bool __writeFailed__ = false;
+
+            static void __reader__ (void *param) {
+                filePipeline_t *pipeline = (filePipeline_t *) param;
+                __block__ block;
+                while (xQueueReceive (pipeline->__emptyQueue__, &block.index, portMAX_DELAY) == pdTRUE && !pipeline->__stopping__) {
+                    size_t bytesRead = pipeline->__file__.read ((uint8_t *) pipeline->__buffers__ + block.index * pipeline->__bufferSize__, pipeline->__bufferSize__);
+                    // read returns size_t, an error comes as (size_t) -1 and must not be taken for the end of file
+                    block.length = bytesRead > pipeline->__bufferSize__ ? -1 : (int) bytesRead;
+                    xQueueSend (pipeline->__fullQueue__, &block, portMAX_DELAY); // never blocks, there is a place for each buffer
+                    if (block.length <= 0)
+                        break;
+                }
+                xSemaphoreGive (pipeline->__finished__);
+                vTaskDelete (NULL);
+            }
+
+            static void __writer__ (void *param) {
+                filePipeline_t *pipeline = (filePipeline_t *) param;
+                __block__ block;
+                while (xQueueReceive (pipeline->__fullQueue__, &block, portMAX_DELAY) == pdTRUE && block.length) {
+                    // after the first failure keep returning the buffers so the calling task doesn't get stuck
+                    if (!pipeline->__writeFailed__ && pipeline->__file__.write ((uint8_t *) pipeline->__buffers__ + block.index * pipeline->__bufferSize__, block.length) != (size_t) block.length)
+                        pipeline->__writeFailed__ = true;
+                    xQueueSend (pipeline->__emptyQueue__, &block.index, 0);
+                }
+                xSemaphoreGive (pipeline->__finished__);
+                vTaskDelete (NULL);
+            }
+
+            void __free__ () {
+                if (__buffers__) { heap_caps_free (__buffers__); __buffers__ = NULL; }
+                if (__emptyQueue__) { vQueueDelete (__emptyQueue__); __emptyQueue__ = NULL; }
+                if (__fullQueue__) { vQueueDelete (__fullQueue__); __fullQueue__ = NULL; }
+                if (__finished__) { vSemaphoreDelete (__finished__); __finished__ = NULL; }
+            }
+    };
+
+#endif
@@ -0,0 +1,254 @@
+/*
+
+    firewall.cpp
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 27, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        firewall_t
+
+*/
+
+
+#include <WiFi.h>
+#include "firewall.h"
+#include <dmesg.hpp>
+#include <ostream.hpp>
+
+
+// bit i of the address, bit 0 is the most significant bit of the first byte
+static inline int __bit__ (const ipAddress_t& address, int i) {
+    return (address.bytes [i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+// the number of equal leading bits of both addresses, but not more than maxLength
+static int __commonPrefixLength__ (const ipAddress_t& a, const ipAddress_t& b, int maxLength) {
+    int i = 0;
+    while (i < maxLength && a.bytes [i >> 3] == b.bytes [i >> 3] && i + 8 <= maxLength)
+        i += 8;
+    while (i < maxLength && __bit__ (a, i) == __bit__ (b, i))
+        i++;
+    return i;
+}
+
+// clears all the bits after prefixLength
+static void __maskAddress__ (ipAddress_t& address, int prefixLength) {
+    for (int i = 0; i < 16; i++) {
+        int bitsToKeep = prefixLength - i * 8;
+        if (bitsToKeep <= 0)
+            address.bytes [i] = 0;
+        else if (bitsToKeep < 8)
+            address.bytes [i] &= (uint8_t) (0xff << (8 - bitsToKeep));
+    }
+}
+
+
+// inserts the rule into the trie, the root node (prefix of length 0) must already exist
+void firewall_t::ruleSet_t::insert (int ruleIndex) {
+    const ipAddress_t& prefix = rules [ruleIndex].prefix;
+    int prefixLength = rules [ruleIndex].prefixLength;
+
+    int n = 0; // start at the root
+    while (true) {
+        // node n matches the prefix up to its keyLength and keyLength <= prefixLength here
+        if (nodes [n].keyLength == prefixLength) {
+            nodes [n].rule = ruleIndex; // the same prefix, the later rule wins
+            return;
+        }
+
+        int b = __bit__ (prefix, nodes [n].keyLength);
+        int c = nodes [n].child [b];
+        if (c == -1) { // add a leaf
+            nodes [nodeCount] = { prefix, (uint8_t) prefixLength, (int16_t) ruleIndex, { -1, -1 } };
+            nodes [n].child [b] = nodeCount++;
+            return;
+        }
+
+        int common = __commonPrefixLength__ (prefix, nodes [c].key, min (prefixLength, (int) nodes [c].keyLength));
+        if (common == nodes [c].keyLength) { // the child's whole key matches, go deeper
+            n = c;
+            continue;
+        }
+
+        // split: insert a node with the common part of both prefixes between n and c
+        int s = nodeCount++;
+        nodes [s] = { prefix, (uint8_t) common, -1, { -1, -1 } };
+        __maskAddress__ (nodes [s].key, common);
+        nodes [s].child [__bit__ (nodes [c].key, common)] = c;
+        nodes [n].child [b] = s;
+        if (common == prefixLength) {
+            nodes [s].rule = ruleIndex;
+        } else {
+            // the prefixes differ in bit common so the new leaf goes to the other side
+            nodes [nodeCount] = { prefix, (uint8_t) prefixLength, (int16_t) ruleIndex, { -1, -1 } };
+            nodes [s].child [__bit__ (prefix, common)] = nodeCount++;
+        }
+        return;
+    }
+}
+
+// returns the index of the rule with the longest matching prefix or -1
+int firewall_t::ruleSet_t::lookup (const ipAddress_t& address) {
+    int bestRule = -1;
+    int n = 0;
+    while (n != -1) {
+        const node_t& node = nodes [n];
+        if (__commonPrefixLength__ (address, node.key, node.keyLength) < node.keyLength)
+            break;
+        if (node.rule != -1)
+            bestRule = node.rule;
+        if (node.keyLength == 128)
+            break;
+        n = node.child [__bit__ (address, node.keyLength)];
+    }
+    return bestRule;
+}
+
+
+firewall_t::firewall_t () { __mutex__ = xSemaphoreCreateMutex (); }
+
+firewall_t::~firewall_t () {
+    delete __ruleSet__;
+    vSemaphoreDelete (__mutex__);
+}
+
+const char *firewall_t::load (const char *rules) {
+    ruleSet_t *newRuleSet = new (std::nothrow) ruleSet_t;
+    if (!newRuleSet) {
+        cout << ( dmesgQueue << "[firewall] " << "out of memory" );
+        return "out of memory";
+    }
+    newRuleSet->nodes [0] = { ipAddress_t (), 0, -1, { -1, -1 } }; // root
+    newRuleSet->nodeCount = 1;
+
+    // parse rules like "allow 10.18.1.0/24, deny ::/0"
+    const char *p = rules;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == ',' || *p == ';')
+            p++;
+        if (!*p)
+            break;
+
+        char action [8];
+        char address [INET6_ADDRSTRLEN + 4];
+        int consumed = 0;
+        if (sscanf (p, "%7s %49[0-9a-fA-F.:/]%n", action, address, &consumed) != 2) {
+            delete newRuleSet;
+            return "syntax error, expected: allow|deny address[/prefix length]";
+        }
+        p += consumed;
+
+        if (newRuleSet->ruleCount == FIREWALL_MAX_RULES) {
+            delete newRuleSet;
+            return "too many rules";
+        }
+        rule_t& rule = newRuleSet->rules [newRuleSet->ruleCount];
+
+        if (!strcmp (action, "allow"))
+            rule.allow = true;
+        else if (!strcmp (action, "deny"))
+            rule.allow = false;
+        else {
+            delete newRuleSet;
+            return "syntax error, rule should start with allow or deny";
+        }
+
+        int prefixLength = -1;
+        char *slash = strchr (address, '/');
+        if (slash) {
+            *slash = 0;
+            // only digits may follow the slash, "/" or "/xx" must not become prefix length 0 (which would match every address)
+            char *endptr;
+            long l = isdigit ((unsigned char) slash [1]) ? strtol (slash + 1, &endptr, 10) : -1;
+            if (l < 0 || *endptr || l > 128) {
+                delete newRuleSet;
+                return "invalid prefix length";
+            }
+            prefixLength = (int) l;
+        }
+        if (!rule.prefix.parse (address)) {
+            delete newRuleSet;
+            return "invalid IP address";
+        }
+        if (rule.prefix.isIPv4 () && !strchr (address, ':')) { // IPv4 notation
+            if (prefixLength == -1)
+                prefixLength = 32;
+            if (prefixLength > 32) {
+                delete newRuleSet;
+                return "invalid prefix length";
+            }
+            prefixLength += 96;
+        } else {
+            if (prefixLength == -1)
+                prefixLength = 128;
+            if (prefixLength > 128) {
+                delete newRuleSet;
+                return "invalid prefix length";
+            }
+        }
+        rule.prefixLength = prefixLength;
+        __maskAddress__ (rule.prefix, prefixLength);
+        rule.hits = 0;
+
+        newRuleSet->insert (newRuleSet->ruleCount++);
+    }
+
+    // swap rule sets, servers checking addresses at this moment finish with the old one
+    xSemaphoreTake (__mutex__, portMAX_DELAY);
+        ruleSet_t *oldRuleSet = __ruleSet__;
+        __ruleSet__ = newRuleSet;
+    xSemaphoreGive (__mutex__);
+    delete oldRuleSet;
+
+    cout << ( dmesgQueue << "[firewall] " << newRuleSet->ruleCount << " rules loaded" );
+    return NULL;
+}
+
+bool firewall_t::allows (const ipAddress_t& address) {
+    bool allow = true;
+    xSemaphoreTake (__mutex__, portMAX_DELAY);
+        if (__ruleSet__) {
+            int r = __ruleSet__->lookup (address);
+            if (r == -1) {
+                __ruleSet__->noMatchHits ++;
+            } else {
+                __ruleSet__->rules [r].hits ++;
+                allow = __ruleSet__->rules [r].allow;
+            }
+        }
+    xSemaphoreGive (__mutex__);
+    return allow;
+}
+
+int firewall_t::getRuleCount () {
+    xSemaphoreTake (__mutex__, portMAX_DELAY);
+        int ruleCount = __ruleSet__ ? __ruleSet__->ruleCount : 0;
+    xSemaphoreGive (__mutex__);
+    return ruleCount;
+}
+
+bool firewall_t::getRule (int index, Cstring<64>& rule, unsigned long& hits) {
+    bool found = false;
+    xSemaphoreTake (__mutex__, portMAX_DELAY);
+        if (__ruleSet__ && index >= 0 && index < __ruleSet__->ruleCount) {
+            const rule_t& r = __ruleSet__->rules [index];
+            bool ipv4 = r.prefix.isIPv4 () && r.prefixLength >= 96;
+            sprintf (rule, "%s %s/%i", r.allow ? "allow" : "deny", r.prefix.toString ().c_str (), ipv4 ? r.prefixLength - 96 : r.prefixLength);
+            hits = r.hits;
+            found = true;
+        }
+    xSemaphoreGive (__mutex__);
+    return found;
+}
+
+unsigned long firewall_t::getNoMatchHits () {
+    xSemaphoreTake (__mutex__, portMAX_DELAY);
+        unsigned long noMatchHits = __ruleSet__ ? __ruleSet__->noMatchHits : 0;
+    xSemaphoreGive (__mutex__);
+    return noMatchHits;
+}
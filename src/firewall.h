@@ -0,0 +1,98 @@
+/*
+
+    firewall.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 27, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        firewall_t
+
+    firewall_t compiles a list of allow/deny rules into a (path compressed) radix trie over 128 bit addresses, so checking an
+    address takes at most one pass through the address bits regardless of the number of rules. Rules look like:
+
+        allow 10.18.1.0/24
+        deny  0.0.0.0/0
+        allow fe80::/10
+        deny  ::/0
+
+    separated by new lines, commas or semicolons. IPv4 subnets are stored as IPv4-mapped IPv6 subnets (::ffff:a.b.c.d/96+n),
+    so 0.0.0.0/0 matches all IPv4 addresses while ::/0 matches everything. The most specific (longest) matching prefix
+    decides, the order of rules does not matter. If no rule matches, the address is allowed.
+
+    load () builds the new rule set aside and then swaps it with the current one, so servers never see half loaded rules.
+
+*/
+
+
+#pragma once
+#ifndef __FIREWALL__
+    #define __FIREWALL__
+
+
+    #include <WiFi.h>
+    #include <Cstring.hpp>      // include LightweightSTL library: https://github.com/BojanJurca/Lightweight-Standard-Template-Library-STL-for-Arduino
+    #include "ipAddress.h"
+
+
+    // TUNING PARAMETERS
+
+    #ifndef FIREWALL_MAX_RULES
+        #define FIREWALL_MAX_RULES 64                   // max number of rules in one rule set
+    #endif
+
+
+    class firewall_t {
+
+        public:
+
+            firewall_t ();
+            ~firewall_t ();
+
+            // compiles the rules and replaces the current rule set, returns NULL if OK or error text (in which case the current rule set stays in place)
+            const char *load (const char *rules);
+
+            // checks the address against the current rule set and counts the hit
+            bool allows (const ipAddress_t& address);
+
+            // rule set statistics
+            int getRuleCount ();
+            bool getRule (int index, Cstring<64>& rule, unsigned long& hits);  // formats the rule, like "deny 10.0.0.0/8"
+            unsigned long getNoMatchHits ();                                   // addresses that no rule matched (and were allowed)
+
+        private:
+
+            struct rule_t {
+                ipAddress_t prefix;
+                uint8_t prefixLength;   // 0 .. 128
+                bool allow;
+                unsigned long hits;
+            };
+
+            struct node_t {
+                ipAddress_t key;        // prefix represented by this node
+                uint8_t keyLength;
+                int16_t rule;           // index of the rule with exactly this prefix or -1
+                int16_t child [2];      // indexes of child nodes (by the next bit after keyLength) or -1
+            };
+
+            struct ruleSet_t {
+                int ruleCount = 0;
+                rule_t rules [FIREWALL_MAX_RULES];
+                int nodeCount = 0;
+                node_t nodes [2 * FIREWALL_MAX_RULES + 1]; // each rule adds at most one leaf and one split node, plus the root
+                unsigned long noMatchHits = 0;
+
+                void insert (int ruleIndex);
+                int lookup (const ipAddress_t& address);
+            };
+
+            ruleSet_t *__ruleSet__ = NULL;
+            SemaphoreHandle_t __mutex__;
+    };
+
+#endif
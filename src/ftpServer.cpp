@@ -85,8 +85,20 @@
 #include "ftpServer.h"
 
 
+// run time values of tuning parameters
+tunable_t ftpControlConnectionStackSize ("FTP_CONTROL_CONNECTION_STACK_SIZE", FTP_CONTROL_CONNECTION_STACK_SIZE, 4 * 1024, 16 * 1024, "bytes");
+tunable_t ftpControlConnectionTimeOut ("FTP_CONTROL_CONNECTION_TIME_OUT", FTP_CONTROL_CONNECTION_TIME_OUT, 0, 3600, "s");
+tunable_t ftpDataConnectionTimeOut ("FTP_DATA_CONNECTION_TIME_OUT", FTP_DATA_CONNECTION_TIME_OUT, 0, 300, "s");
+tunable_t ftpRetrBufferCount ("FTP_RETR_BUFFER_COUNT", FTP_RETR_BUFFER_COUNT, 2, 8, "buffers");
+tunable_t ftpRetrBufferSize ("FTP_RETR_BUFFER_SIZE", FTP_RETR_BUFFER_SIZE, 512, 64 * 1024, "bytes");
+tunable_t ftpStorBufferCount ("FTP_STOR_BUFFER_COUNT", FTP_STOR_BUFFER_COUNT, 2, 16, "buffers");
+tunable_t ftpStorBufferSize ("FTP_STOR_BUFFER_SIZE", FTP_STOR_BUFFER_SIZE, 512, 64 * 1024, "bytes");
+tunable_t ftpModeZWindowBits ("FTP_MODE_Z_WINDOW_BITS", FTP_MODE_Z_WINDOW_BITS, 9, 14, "bits");
+
+
 // static member initialization
 UBaseType_t ftpServer_t::ftpControlConnection_t::__lastHighWaterMark__ = FTP_CONTROL_CONNECTION_STACK_SIZE;
+objectPool_t ftpServer_t::ftpControlConnection_t::__pool__;
 
 
 // ----- ftpControlConnection_t implementation -----
@@ -95,10 +107,11 @@ ftpServer_t::ftpControlConnection_t::ftpControlConnection_t (threadSafeFS::FS& f
                                                              Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName,
                                                              const Cstring<64>& password),
                                                              int connectionSocket,
-                                                             char *clientIP,
-                                                             char *serverIP) : tcpConnection_t (connectionSocket, clientIP, serverIP),
+                                                             const ipAddress_t& clientAddress,
+                                                             const ipAddress_t& serverAddress) : tcpConnection_t (connectionSocket, clientAddress, serverAddress),
                                                                                __fileSystem__ (fileSystem),
                                                                                __getUserHomeDirectory__ (getUserHomeDirectory) {
+    setSocketOptions (socketOptions_t::interactive ());
 }
 
 ftpServer_t::ftpControlConnection_t::~ftpControlConnection_t () {
@@ -123,42 +136,25 @@ void ftpServer_t::ftpControlConnection_t::__runConnectionTask__ () {
             default:                        break;
         }
 
-        // 2. parse command line
-        int argc = 0;
-        char *argv [FTP_SESSION_MAX_ARGC];
-
-        char *q = __cmdLine__ - 1;
-        while (true) {
-            char *p = q + 1;
-            while (*p && *p <= ' ')
-                p++;
-            if (*p) {
-                bool quotation = false;
-                if (*p == '\"') {
-                    quotation = true;
-                    p++;
-                }
-                argv [argc++] = p;
-                q = p;
-                while (*q && (*q > ' ' || quotation))
-                    if (*q == '\"')
-                        break;
-                    else
-                        q++;
-                if (*q)
-                    *q = 0;
-                else
-                    break;
-            } else {
-                break;
-            }
-            if (argc == FTP_SESSION_MAX_ARGC)
-                break;
+        // 2. split command line into the command and its argument (the rest of the line, file names may contain spaces)
+        char *command = __cmdLine__;
+        while (*command && *command <= ' ')
+            command++;
+        char *argument = command;
+        while (*argument > ' ')
+            argument++;
+        if (*argument) {
+            *argument++ = 0;
+            while (*argument && *argument <= ' ')
+                argument++;
         }
+        char *endOfLine = argument + strlen (argument);
+        while (endOfLine > argument && *(endOfLine - 1) <= ' ') // \r\n and trailing spaces
+            *--endOfLine = 0;
 
         // 3. process the commandLine
-        if (argc) {
-            Cstring<300> s = __internalCommandHandler__ (argc, argv);
+        if (*command) {
+            Cstring<300> s = __internalCommandHandler__ (command, argument);
             if (s != "") {
                 if (sendString (s) <= 0)
                     goto endConnection;
@@ -180,69 +176,116 @@ endConnection:
     cout << ( dmesgQueue << "[ftpCtrlConn] " << __userName__ << " logged out" );
 }
 
-Cstring<300> ftpServer_t::ftpControlConnection_t::__internalCommandHandler__ (int argc, char *argv []) {
-    #define ftpArgv0Is(X) (argc > 0 && !strcmp(argv[0], X))
-    #define ftpArgv1Is(X) (argc > 1 && !strcmp(argv[1], X))
-    #define ftpArgv2Is(X) (argc > 2 && !strcmp(argv[2], X))
-
-    // Serial.printf ("\nFTP __internalCommandHandler__"); for (int i = 0; i < argc; i++) Serial.printf (" %s", argv [i]);
-
-    if (ftpArgv0Is ("QUIT"))                            return "221 closing connection\r\n";
-
-    else if (ftpArgv0Is ("OPTS"))                       if (argc == 3 && ftpArgv1Is ("UTF8") && ftpArgv2Is ("ON"))
-                                                            return "200 UTF8 enabled\r\n";
-                                                        else
-                                                            return "502 OPTS arguments not supported\r\n";
-
-    else if (ftpArgv0Is ("USER"))                       return __USER__(argv [1]);
-
-    else if (ftpArgv0Is ("PASS"))                       return __PASS__ (argv [1]);
-    else if (ftpArgv0Is ("PWD") || ftpArgv0Is ("XPWD")) return __XPWD__ ();
-
-    else if (ftpArgv0Is ("TYPE"))                       return "200 ok\r\n";
-
-    else if (ftpArgv0Is ("NOOP"))                       return "200 ok\r\n";
-
-    else if (ftpArgv0Is ("SYST"))                       return "215 UNIX Type: L8\r\n";
-
-    else if (ftpArgv0Is ("FEAT"))                       return "211-Extensions supported:\r\n UTF8\r\n211 end\r\n";
-
-    else if (ftpArgv0Is ("PORT"))                       return __PORT__ (argv [1]);
+// dispatch table, the order doesn't matter, __findCommand__ indexes it by command code
+const ftpServer_t::ftpControlConnection_t::__command_t__ ftpServer_t::ftpControlConnection_t::__commands__ [] = {
+    //   command                     argument            login  keeps REST offset
+    { __commandCode__ ("QUIT"), NO_ARGUMENT,        false, false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return "221 closing connection\r\n"; } },
+    { __commandCode__ ("NOOP"), NO_ARGUMENT,        false, false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return "200 ok\r\n"; } },
+    { __commandCode__ ("SYST"), NO_ARGUMENT,        false, false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return "215 UNIX Type: L8\r\n"; } },
+    { __commandCode__ ("FEAT"), NO_ARGUMENT,        false, false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return "211-Extensions supported:\r\n UTF8\r\n SIZE\r\n REST STREAM\r\n MLST type*;size*;modify*;\r\n MODE Z\r\n MDTM\r\n MFMT\r\n211 end\r\n"; } },
+    { __commandCode__ ("OPTS"), REQUIRED_ARGUMENT,  false, false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return strcasecmp (a, "UTF8 ON") ? "502 OPTS arguments not supported\r\n" : "200 UTF8 enabled\r\n"; } },
+    { __commandCode__ ("USER"), REQUIRED_ARGUMENT,  false, false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__USER__ (a); } },
+    { __commandCode__ ("PASS"), OPTIONAL_ARGUMENT,  false, false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__PASS__ (a); } },
+    { __commandCode__ ("TYPE"), OPTIONAL_ARGUMENT,  false, true,  [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return "200 ok\r\n"; } },
+    { __commandCode__ ("PWD"),  NO_ARGUMENT,        true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__XPWD__ (); } },
+    { __commandCode__ ("XPWD"), NO_ARGUMENT,        true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__XPWD__ (); } },
+    { __commandCode__ ("CWD"),  REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__CWD__ (a); } },
+    { __commandCode__ ("PORT"), REQUIRED_ARGUMENT,  true,  true,  [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__PORT__ (a); } },
+    { __commandCode__ ("EPRT"), REQUIRED_ARGUMENT,  true,  true,  [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__EPRT__ (a); } },
+    { __commandCode__ ("PASV"), NO_ARGUMENT,        true,  true,  [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__PASV__ (); } },
+    { __commandCode__ ("EPSV"), OPTIONAL_ARGUMENT,  true,  true,  [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__EPSV__ (); } },
+    { __commandCode__ ("LIST"), DIRECTORY_ARGUMENT, true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__NLST__ (a, 'l'); } },
+    { __commandCode__ ("NLST"), DIRECTORY_ARGUMENT, true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__NLST__ (a, 'n'); } },
+    { __commandCode__ ("MLSD"), DIRECTORY_ARGUMENT, true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__NLST__ (a, 'm'); } },
+    { __commandCode__ ("MLST"), DIRECTORY_ARGUMENT, true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__MLST__ (a); } },
+    { __commandCode__ ("SIZE"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__SIZE__ (a); } },
+    { __commandCode__ ("MDTM"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__MDTM__ (a); } },
+    { __commandCode__ ("MFMT"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__MFMT__ (a); } },
+    { __commandCode__ ("MKD"),  REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__XMKD__ (a); } },
+    { __commandCode__ ("XMKD"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__XMKD__ (a); } },
+    { __commandCode__ ("RMD"),  REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__XRMD__ (a); } },
+    { __commandCode__ ("XRMD"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__XRMD__ (a); } },
+    { __commandCode__ ("DELE"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__XRMD__ (a); } },
+    { __commandCode__ ("RNFR"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__RNFR__ (a); } },
+    { __commandCode__ ("RNTO"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__RNTO__ (a); } },
+    { __commandCode__ ("REST"), REQUIRED_ARGUMENT,  true,  true,  [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__REST__ (a); } },
+    { __commandCode__ ("MODE"), REQUIRED_ARGUMENT,  true,  true,  [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__MODE__ (a); } },
+    { __commandCode__ ("RETR"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__RETR__ (a, c->__restartOffset__); } },
+    { __commandCode__ ("STOR"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__STOR__ (a, c->__restartOffset__, false); } },
+    { __commandCode__ ("APPE"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__STOR__ (a, 0, true); } },
+    { __commandCode__ ("SITE"), REQUIRED_ARGUMENT,  true,  false, [] (ftpControlConnection_t *c, char *a) -> Cstring<300> { return c->__SITE__ (a); } }
+};
+
+uint32_t ftpServer_t::ftpControlConnection_t::__packCommand__ (const char *command) {
+    uint32_t code = 0;
+    int i;
+    for (i = 0; i < 4 && command [i]; i++)
+        code |= (uint32_t) toupper (command [i]) << (24 - 8 * i);
+    return i < 3 || command [i] ? 0 : code; // FTP commands have 3 or 4 letters
+}
 
-    else if (ftpArgv0Is ("EPRT"))                       return __EPRT__ (argv [1]);
+int ftpServer_t::ftpControlConnection_t::__findCommand__ (uint32_t code) {
+    // open addressing hash table of indexes into __commands__, built the first time it is needed (C++ makes this thread-safe)
+    static const struct __commandIndex_t__ {
+        int8_t slot [64];
+        static inline int hash (uint32_t code) __attribute__((always_inline)) { return (code * 2654435761u) >> 26; } // Fibonacci hashing to 6 bits
+        __commandIndex_t__ () {
+            memset (slot, -1, sizeof (slot));
+            for (int i = 0; i < (int) (sizeof (__commands__) / sizeof (__commands__ [0])); i++) {
+                int h = hash (__commands__ [i].code);
+                while (slot [h] >= 0)
+                    h = (h + 1) & 63;
+                slot [h] = i;
+            }
+        }
+    } index;
+
+    if (!code)
+        return -1;
+    for (int h = __commandIndex_t__::hash (code); index.slot [h] >= 0; h = (h + 1) & 63)
+        if (__commands__ [index.slot [h]].code == code)
+            return index.slot [h];
+    return -1;
+}
 
-    else if (ftpArgv0Is ("PASV"))                       return __PASV__ ();
+int ftpServer_t::ftpControlConnection_t::commandIndex (const char *command) {
+    return __findCommand__ (__packCommand__ (command));
+}
 
-    else if (ftpArgv0Is ("EPSV"))                       return __EPSV__ ();
+Cstring<300> ftpServer_t::ftpControlConnection_t::__internalCommandHandler__ (char *command, char *argument) {
+    // Serial.printf ("\nFTP __internalCommandHandler__ %s %s", command, argument);
 
-    // reconstruct (part of) command line (if it contains long file name)
-    if (argc > 1) {
-        for (char *p = argv [1]; p < argv [argc - 1]; p++)
-            if (!*p)
-                *p = ' ';
-    } else {
-        argv [1] = (char *) "";
+    int i = __findCommand__ (__packCommand__ (command));
+    if (i < 0) {
+        __restartOffset__ = 0;
+        return Cstring<300> ("502 command ") + command + " not implemented\r\n";
     }
+    const __command_t__& c = __commands__ [i];
 
-    if (ftpArgv0Is ("LIST") || ftpArgv0Is ("NLST"))                             return __NLST__ (argc > 1 ? argv [1] : (char *) __workingDirectory__);
-
-    else if (ftpArgv0Is ("SIZE"))                                               return __SIZE__ (argv [1]);
-
-    else if (ftpArgv0Is ("XMKD") || ftpArgv0Is ("MKD"))                         return __XMKD__(argv [1]);
-
-    else if (ftpArgv0Is ("XRMD") || ftpArgv0Is ("RMD") || ftpArgv0Is ("DELE"))  return __XRMD__(argv [1]);
-
-    else if (ftpArgv0Is ("CWD"))                                                return __CWD__ (argv [1]);
-
-    else if (ftpArgv0Is ("RNFR"))                                               return __RNFR__ (argv[1]);
-
-    else if (ftpArgv0Is ("RNTO"))                                               return __RNTO__ (argv [1]);
-
-    else if (ftpArgv0Is ("RETR"))                                               return __RETR__ (argv [1]);
+    if (c.needsLogin && __homeDirectory__ == "") {
+        __restartOffset__ = 0;
+        return "530 not logged in\r\n";
+    }
+    switch (c.argument) {
+        case NO_ARGUMENT:           argument = (char *) ""; // ignore it
+                                    break;
+        case REQUIRED_ARGUMENT:     if (!*argument) {
+                                        __restartOffset__ = 0;
+                                        return Cstring<300> ("501 ") + command + " needs an argument\r\n";
+                                    }
+                                    break;
+        case DIRECTORY_ARGUMENT:    if (!*argument || *argument == '-') // some clients send LIST -la
+                                        argument = (char *) __workingDirectory__;
+                                    break;
+        default:                    break;
+    }
 
-    else if (ftpArgv0Is ("STOR"))                                               return __STOR__ (argv [1]);
+    Cstring<300> reply = c.handler (this, argument);
 
-    return Cstring<300> ("502 command ") + argv [0] + " not implemented\r\n";
+    // REST only applies to the transfer command that follows it, but clients may set up the data connection in between
+    if (!c.keepsRestartOffset)
+        __restartOffset__ = 0;
+    return reply;
 }
 
 Cstring<300> ftpServer_t::ftpControlConnection_t::__USER__ (char *userName) {
@@ -330,14 +373,64 @@ Cstring<300> ftpServer_t::ftpControlConnection_t::__SIZE__ (char *fileName) {
     Cstring<255> fullPath = __fileSystem__.makeFullPath (fileName, __workingDirectory__);
     if (!__fileSystem__.userHasRightToAccessFile (fullPath, __homeDirectory__))         return "550 access denyed\r\n";
 
-    unsigned long fSize = 0;
-    threadSafeFS::File f = __fileSystem__.open (fullPath, FILE_READ);
-    if (f) {
-        fSize = f.size ();
-        f.close ();
-    }
+    // sync clients ask for SIZE and MDTM of every file, the file system answers from the entries of the directory read once
+    size_t fSize;
+    time_t lastWrite;
+    bool isDirectory;
+    if (!__fileSystem__.stat (fullPath, fSize, lastWrite, isDirectory) || isDirectory) return "550 file not found\r\n";
 
-    return Cstring<300> ("213 ") + Cstring<300> (fSize) + "\r\n";
+    return Cstring<300> ("213 ") + Cstring<300> ((unsigned long) fSize) + "\r\n";
+}
+
+// RFC 3659 modification time, always UTC
+Cstring<300> ftpServer_t::ftpControlConnection_t::__MDTM__ (char *fileName) {
+    if (__homeDirectory__ == "")                                                        return "530 not logged in\r\n";
+    if (!__fileSystem__.mounted ())                                                     return "421 file system not mounted\r\n";
+    Cstring<255> fullPath = __fileSystem__.makeFullPath (fileName, __workingDirectory__);
+    if (!__fileSystem__.userHasRightToAccessFile (fullPath, __homeDirectory__))         return "550 access denyed\r\n";
+
+    size_t fSize;
+    time_t lastWrite;
+    bool isDirectory;
+    if (!__fileSystem__.stat (fullPath, fSize, lastWrite, isDirectory) || isDirectory) return "550 file not found\r\n";
+
+    struct tm fTime = {};
+    gmtime_r (&lastWrite, &fTime);
+    char modify [16];
+    strftime (modify, sizeof (modify), "%Y%m%d%H%M%S", &fTime);
+    return Cstring<300> ("213 ") + modify + "\r\n";
+}
+
+// MFMT YYYYMMDDHHMMSS path sets the modification time (UTC), clients use it after upload so that the next sync finds the file unchanged
+Cstring<300> ftpServer_t::ftpControlConnection_t::__MFMT__ (char *timeAndFileName) {
+    if (__homeDirectory__ == "")                                                        return "530 not logged in\r\n";
+    if (!__fileSystem__.mounted ())                                                     return "421 file system not mounted\r\n";
+
+    int year, month, day, hour, minute, second, n = 0;
+    if (sscanf (timeAndFileName, "%4d%2d%2d%2d%2d%2d%n", &year, &month, &day, &hour, &minute, &second, &n) != 6 || n != 14 || timeAndFileName [n] != ' ' ||
+        month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+                                                                                        return "501 syntax: MFMT YYYYMMDDHHMMSS path\r\n";
+    char *fileName = timeAndFileName + n;
+    while (*fileName == ' ')
+        fileName++;
+    Cstring<255> fullPath = __fileSystem__.makeFullPath (fileName, __workingDirectory__);
+    if (fullPath == "")                                                                 return "501 invalid file name\r\n";
+    if (!__fileSystem__.userHasRightToAccessFile (fullPath, __homeDirectory__))         return "550 access denyed\r\n";
+
+    // there is no timegm in newlib, count the days since 1970-01-01 (days from civil algorithm, counting years from March so that leap days come last)
+    int y = year - (month <= 2);
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yearOfEra = y - era * 400;
+    long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long days = era * 146097 + yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear - 719468;
+    time_t lastWrite = (time_t) days * 86400 + hour * 3600 + minute * 60 + second;
+
+    if (!*__fileSystem__.getMountPoint ())                                              return "550 can't set modification time, file system's mount point is not known\r\n";
+    if (!__fileSystem__.setLastWrite (fullPath, lastWrite))                             return "550 can't set modification time\r\n";
+    char modify [15];
+    memcpy (modify, timeAndFileName, 14);
+    modify [14] = 0;
+    return Cstring<300> ("213 Modify=") + modify + "; " + fileName + "\r\n";
 }
 
 void ftpServer_t::ftpControlConnection_t::__closeDataConnection__ () {
@@ -345,19 +438,243 @@ void ftpServer_t::ftpControlConnection_t::__closeDataConnection__ () {
         delete __dataConnection__;
         __dataConnection__ = NULL;
     }
+    __resetDataTransfer__ ();
+}
+
+void ftpServer_t::ftpControlConnection_t::__endDataTransfer__ (bool success) {
+    // MODE B marks the end of each transfer with EOF block, so the client doesn't need the connection closed and can use it for the next transfer
+    if (__transferMode__ == 'B' && success && __dataConnection__)
+        __resetDataTransfer__ ();
+    else
+        __closeDataConnection__ ();
 }
 
-// cycle through set of port numbers when FTP server is working in pasive mode
-int ftpServer_t::ftpControlConnection_t::__pasiveDataPort__ () {
-    static int __lastPasiveDataPort__ = 1024;
-    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-        int pasiveDataPort = __lastPasiveDataPort__ = (((__lastPasiveDataPort__ + 1) % 16) + 1024);
-    xSemaphoreGive (getLwIpMutex ());
-    return pasiveDataPort;
+void ftpServer_t::ftpControlConnection_t::__resetDataTransfer__ () {
+    // each MODE Z transfer is a zlib stream of its own
+    if (__deflate__) {
+        delete __deflate__;
+        __deflate__ = NULL;
+    }
+    if (__inflate__) {
+        delete __inflate__;
+        __inflate__ = NULL;
+    }
+    if (__block__) {
+        free (__block__);
+        __block__ = NULL;
+    }
+    __blockLength__ = __blockRemaining__ = 0;
+    __lastBlock__ = false;
+    __dataConnectionBytes__ = __compressionMicros__ = 0;
+}
+
+// MODE B block header: descriptor (64 = EOF) and 16 bit byte count
+bool ftpServer_t::ftpControlConnection_t::__sendBlock__ (uint8_t descriptor) {
+    __block__ [0] = descriptor;
+    __block__ [1] = __blockLength__ >> 8;
+    __block__ [2] = __blockLength__;
+    if (__dataConnection__->sendBlock (__block__, 3 + __blockLength__) != (int) (3 + __blockLength__))
+        return false;
+    __dataConnectionBytes__ += 3 + __blockLength__;
+    __blockLength__ = 0;
+    return true;
+}
+
+int ftpServer_t::ftpControlConnection_t::__dataSend__ (const char *buffer, size_t length) {
+    if (__transferMode__ == 'B') {
+        if (!__block__) {
+            __block__ = (char *) malloc (3 + FTP_MODE_B_BLOCK_SIZE);
+            if (!__block__) {
+                cout << ( dmesgQueue << "[ftpCtrlConn] " << "MODE B can't start, out of memory" );
+                return -1;
+            }
+            __dataConnection__->setSocketOptions (socketOptions_t::bulkNoDelay ());
+        }
+        // whole blocks are sent with one call, header and data in the same segment
+        for (size_t i = 0; i < length; ) {
+            size_t n = min (length - i, (size_t) FTP_MODE_B_BLOCK_SIZE - __blockLength__);
+            memcpy (__block__ + 3 + __blockLength__, buffer + i, n);
+            __blockLength__ += n;
+            i += n;
+            if (__blockLength__ == FTP_MODE_B_BLOCK_SIZE && !__sendBlock__ (0))
+                return -1;
+        }
+        return length;
+    }
+
+    if (__transferMode__ != 'Z') {
+        int bytesSent = __dataConnection__->sendBlock ((void *) buffer, length);
+        if (bytesSent > 0)
+            __dataConnectionBytes__ += bytesSent;
+        return bytesSent;
+    }
+
+    if (!__deflate__) {
+        __deflate__ = new (std::nothrow) deflate_t (ftpModeZWindowBits, FTP_MODE_Z_BUFFER_SIZE, FTP_TRANSFER_BUFFERS_IN_PSRAM);
+        if (!__deflate__ || !*__deflate__) {
+            cout << ( dmesgQueue << "[ftpCtrlConn] " << "MODE Z can't start, out of memory" );
+            delete __deflate__;
+            __deflate__ = NULL;
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < length; i += FTP_MODE_Z_BUFFER_SIZE) {
+        unsigned long startMicros = micros ();
+        size_t compressedLength = __deflate__->compress (buffer + i, min (length - i, (size_t) FTP_MODE_Z_BUFFER_SIZE), false);
+        __compressionMicros__ += micros () - startMicros;
+        // collect at least FTP_MODE_Z_BUFFER_SIZE compressed bytes before sending, highly compressible data would otherwise go out in tiny packets
+        if (compressedLength >= FTP_MODE_Z_BUFFER_SIZE) {
+            if (__dataConnection__->sendBlock ((void *) __deflate__->output (), compressedLength) != (int) compressedLength)
+                return -1;
+            __deflate__->outputSent ();
+            __dataConnectionBytes__ += compressedLength;
+        }
+    }
+    return length;
+}
+
+bool ftpServer_t::ftpControlConnection_t::__dataFinish__ () {
+    if (__transferMode__ == 'B') {
+        // the last block carries EOF, even if it is empty
+        if (!__block__ && __dataSend__ ("", 0) < 0)
+            return false;
+        return __sendBlock__ (64);
+    }
+    if (__transferMode__ != 'Z')
+        return true;
+
+    // MODE Z stream must be ended even if there was nothing to send
+    if (!__deflate__ && __dataSend__ ("", 0) < 0)
+        return false;
+    size_t compressedLength = __deflate__->compress ("", 0, true);
+    if (__dataConnection__->sendBlock ((void *) __deflate__->output (), compressedLength) != (int) compressedLength)
+        return false;
+    __deflate__->outputSent ();
+    __dataConnectionBytes__ += compressedLength;
+    return true;
+}
+
+int ftpServer_t::ftpControlConnection_t::__dataRecv__ (char *buffer, size_t length) {
+    if (__transferMode__ == 'B') {
+        while (!__blockRemaining__) {
+            if (__lastBlock__)
+                return 0;
+            uint8_t header [3];
+            if (__dataConnection__->recvBlock (header, 3) != 3)
+                return -1; // the connection closed before EOF block means that the data is incomplete
+            __dataConnectionBytes__ += 3;
+            __blockRemaining__ = header [1] << 8 | header [2];
+            __lastBlock__ = header [0] & 64;
+            if (header [0] & 16) { // restart marker, skip it
+                char marker [256];
+                while (__blockRemaining__) {
+                    int bytesReceived = __dataConnection__->recv (marker, min (__blockRemaining__, sizeof (marker)));
+                    if (bytesReceived <= 0)
+                        return -1;
+                    __blockRemaining__ -= bytesReceived;
+                }
+            }
+        }
+        int bytesReceived = __dataConnection__->recv (buffer, min (length, __blockRemaining__));
+        if (bytesReceived <= 0)
+            return -1;
+        __blockRemaining__ -= bytesReceived;
+        __dataConnectionBytes__ += bytesReceived;
+        return bytesReceived;
+    }
+
+    if (__transferMode__ != 'Z') {
+        int bytesReceived = __dataConnection__->recv (buffer, length);
+        if (bytesReceived > 0)
+            __dataConnectionBytes__ += bytesReceived;
+        return bytesReceived;
+    }
+
+    if (!__inflate__) {
+        __inflate__ = new (std::nothrow) inflate_t (FTP_MODE_Z_BUFFER_SIZE, FTP_TRANSFER_BUFFERS_IN_PSRAM);
+        if (!__inflate__ || !*__inflate__) {
+            cout << ( dmesgQueue << "[ftpCtrlConn] " << "MODE Z can't start, out of memory" );
+            delete __inflate__;
+            __inflate__ = NULL;
+            return -1;
+        }
+    }
+    while (true) {
+        unsigned long startMicros = micros ();
+        int bytesDecompressed = __inflate__->read (buffer, length);
+        __compressionMicros__ += micros () - startMicros;
+        if (bytesDecompressed != 0 || __inflate__->finished ())
+            return bytesDecompressed;
+
+        int bytesReceived = __dataConnection__->recv (__inflate__->inputBuffer (), __inflate__->inputBufferSize ());
+        if (bytesReceived < 0)
+            return -1;
+        __inflate__->inputReceived (bytesReceived);
+        __dataConnectionBytes__ += bytesReceived;
+    }
+}
+
+Cstring<300> ftpServer_t::ftpControlConnection_t::__MODE__ (char *mode) {
+    if (!strcasecmp (mode, "S")) {
+        __transferMode__ = 'S';
+        return "200 MODE S\r\n";
+    }
+    if (!strcasecmp (mode, "B")) {
+        __transferMode__ = 'B';
+        return "200 MODE B\r\n";
+    }
+    if (!strcasecmp (mode, "Z")) {
+        __transferMode__ = 'Z';
+        return "200 MODE Z\r\n";
+    }
+    return Cstring<300> ("504 MODE ") + mode + " not supported\r\n";
+}
+
+// waits for the client to connect to the passive data port and releases the port afterwards, the listener stays bound for the next session
+bool ftpServer_t::ftpControlConnection_t::__acceptPassiveDataConnection__ (int passiveDataPortIndex) {
+    tcpServer_t *passiveDataServer = __server__->__passiveDataServers__ [passiveDataPortIndex];
+    ipAddress_t clientAddress, serverAddress;
+    unsigned long startMillis = millis ();
+    while (!__dataConnection__) {
+        // computed once per pass, so it can't wrap around between the check and its use
+        long remainingMillis = (long) ftpDataConnectionTimeOut * 1000 - (long) (millis () - startMillis);
+        if (remainingMillis <= 0)
+            break;
+        if (!passiveDataServer->waitForConnection (remainingMillis))
+            continue;
+        int connectionSocket = passiveDataServer->acceptSocket (clientAddress, serverAddress);
+        if (connectionSocket == -1)
+            continue;
+        // only the client of this session may connect to its data port
+        if (clientAddress != getClientAddress ()) {
+            cout << ( dmesgQueue << "[ftpCtrlConn] " << "rejected passive data connection from " << clientAddress.toString () << ", expected " << getClientIP () );
+            xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+                close (connectionSocket);
+            xSemaphoreGive (getLwIpMutex ());
+            continue;
+        }
+        __dataConnection__ = new (std::nothrow) tcpConnection_t (connectionSocket, clientAddress, serverAddress);
+        if (!__dataConnection__) {
+            xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+                close (connectionSocket);
+            xSemaphoreGive (getLwIpMutex ());
+            break;
+        }
+    }
+    __server__->__freePassiveDataPort__ (passiveDataPortIndex);
+
+    if (!__dataConnection__)
+        return false;
+    __dataConnection__->setIdleTimeout (ftpDataConnectionTimeOut);
+    __dataConnection__->setServerBandwidthLimit (__serverBandwidthLimit__);
+    __dataConnection__->setSocketOptions (socketOptions_t::bulk ());
+    return true;
 }
 
 // IPv4 PORT command like PORT 10,18,1,26,239,17
 const char *ftpServer_t::ftpControlConnection_t::__PORT__ (char *dataConnectionInfo) { 
+    __closeDataConnection__ (); // the one that MODE B may have kept open
+
     if (__homeDirectory__ == "")                                                        return "530 not logged in\r\n";
 
     int ip1, ip2, ip3, ip4, p1, p2; // get IP and port that client used to set up data connection server
@@ -370,7 +687,9 @@ const char *ftpServer_t::ftpControlConnection_t::__PORT__ (char *dataConnectionI
         // connect to the FTP client that acts as server now
         __dataConnection__ = new (std::nothrow) tcpClient_t (activeServerIP, activeServerPort);
         if (__dataConnection__ && *__dataConnection__) { // test if connection is created and connected
-            __dataConnection__->setIdleTimeout (FTP_DATA_CONNECTION_TIME_OUT);
+            __dataConnection__->setIdleTimeout (ftpDataConnectionTimeOut);
+            __dataConnection__->setServerBandwidthLimit (__serverBandwidthLimit__); // data connections count against FTP server's limit (not against temporary passive data server's)
+            __dataConnection__->setSocketOptions (socketOptions_t::bulk ());
             return "200 port ok\r\n";
         }
     }
@@ -379,6 +698,8 @@ const char *ftpServer_t::ftpControlConnection_t::__PORT__ (char *dataConnectionI
 
 // extended IPv6 (and IPv4) EPRT command like EPRT |2|fe80::3d98:8793:4cf0:f618|61166|
 const char *ftpServer_t::ftpControlConnection_t::__EPRT__ (char *dataConnectionInfo) {
+    __closeDataConnection__ ();
+
     if (__homeDirectory__ == "")                                                        return "530 not logged in\r\n";
 
     char activeServerIP [INET6_ADDRSTRLEN];
@@ -388,7 +709,9 @@ const char *ftpServer_t::ftpControlConnection_t::__EPRT__ (char *dataConnectionI
         // connect to the FTP client that act as server now
         __dataConnection__ = new (std::nothrow) tcpClient_t (activeServerIP, activeServerPort);
         if (__dataConnection__ && *__dataConnection__) { // test if connection is created and connected
-            __dataConnection__->setIdleTimeout (FTP_DATA_CONNECTION_TIME_OUT);
+            __dataConnection__->setIdleTimeout (ftpDataConnectionTimeOut);
+            __dataConnection__->setServerBandwidthLimit (__serverBandwidthLimit__);
+            __dataConnection__->setSocketOptions (socketOptions_t::bulk ());
             return "200 port ok\r\n";
         }
     }
@@ -401,44 +724,26 @@ const char *ftpServer_t::ftpControlConnection_t::__PASV__ () {
 
     if (__homeDirectory__ == "")                                                        return "530 not logged in\r\n";
 
-    int ip1, ip2, ip3, ip4, p1, p2; // get FTP server IP and next free port
-    if (4 != sscanf (getServerIP (), "%i.%i.%i.%i", &ip1, &ip2, &ip3, &ip4)) {
-        cout << ( dmesgQueue << "[ftpCtrlConn] can't parse server IP: " << getServerIP () );
+    const ipAddress_t& serverAddress = getServerAddress ();
+    if (!serverAddress.isIPv4 ()) {
+        cout << ( dmesgQueue << "[ftpCtrlConn] PASV needs IPv4 server address: " << serverAddress.toString () );
         return "425 can't open passive data connection\r\n";
     }
 
-    // get next free port
-    int pasiveDataPort = __pasiveDataPort__ ();
-    p2 = pasiveDataPort % 256;
-    p1 = pasiveDataPort / 256;
-
-    // set up a new server for data connection and send connection information to the FTP client so it can connect to it
-    tcpServer_t passiveDataServer (pasiveDataPort, NULL, false);
-    if (passiveDataServer) { // if the server is running
-        // notify FTP client about data connection IP and port
-        Cstring<300> s;
-        sprintf (s, "227 entering passive mode (%i,%i,%i,%i,%i,%i)\r\n", ip1, ip2, ip3, ip4, p1, p2);
-        if (sendString (s) <= 0)
-            return "";
+    // take a free passive data port
+    int passiveDataPortIndex = __server__->__allocatePassiveDataPort__ ();
+    if (passiveDataPortIndex < 0)                                                       return "425 no free passive data port, try again later\r\n";
+    int passiveDataPort = __server__->__passiveDataPortFirst__ + passiveDataPortIndex;
 
-        // wait for data connection
-        __dataConnection__ = NULL;
-        unsigned long startMillis = millis ();
-        while (__dataConnection__ == NULL && millis () - startMillis < FTP_DATA_CONNECTION_TIME_OUT * 1000) {
-            delay (25);
-            __dataConnection__ = passiveDataServer.accept ();
-        }
-
-        if (__dataConnection__) {
-            __dataConnection__->setIdleTimeout (FTP_DATA_CONNECTION_TIME_OUT);
-            return "";
-        } else {
-            delete __dataConnection__;
-            __dataConnection__ = NULL;
-            return "425 can't open passive data connection\r\n";
-        }
+    // notify FTP client about data connection IP and port
+    Cstring<300> s;
+    sprintf (s, "227 entering passive mode (%i,%i,%i,%i,%i,%i)\r\n", serverAddress.bytes [12], serverAddress.bytes [13], serverAddress.bytes [14], serverAddress.bytes [15], passiveDataPort / 256, passiveDataPort % 256);
+    if (sendString (s) <= 0) {
+        __server__->__freePassiveDataPort__ (passiveDataPortIndex);
+        return "";
     }
-    return "425 can't open passive data connection\r\n";
+
+    return __acceptPassiveDataConnection__ (passiveDataPortIndex) ? "" : "425 can't open passive data connection\r\n";
 }
 
 // extended IPv6 (and IPv4) EPSV command
@@ -447,40 +752,23 @@ const char *ftpServer_t::ftpControlConnection_t::__EPSV__ () {
 
     if (__homeDirectory__ == "")                                                        return "530 not logged in\r\n";
 
-    // get next free port
-    int pasiveDataPort = __pasiveDataPort__ ();
-
-    // set up a new server for data connection and send connection information to the FTP client so it can connect to it
-    tcpServer_t passiveDataServer (pasiveDataPort, NULL, false);
-    if (passiveDataServer) { // if the server is running
-        // notify FTP client about data connection IP and port
-        Cstring<300> s;
-        sprintf (s, "229 entering passive mode (|||%i|)\r\n", pasiveDataPort);
-        if (sendString (s) <= 0)
-            return "";
+    // take a free passive data port
+    int passiveDataPortIndex = __server__->__allocatePassiveDataPort__ ();
+    if (passiveDataPortIndex < 0)                                                       return "425 no free passive data port, try again later\r\n";
 
-        // wait for data connection
-        __dataConnection__ = NULL;
-        unsigned long startMillis = millis ();
-        while (__dataConnection__ == NULL && millis () - startMillis < FTP_DATA_CONNECTION_TIME_OUT * 1000) {
-            delay (25);
-            __dataConnection__ = passiveDataServer.accept ();
-        }
-
-        if (__dataConnection__) {
-            delete __dataConnection__;
-            __dataConnection__ = NULL;
-            return "425 can't set passive data connection timeout\r\n";
-        }
-
-        __dataConnection__->setIdleTimeout (FTP_DATA_CONNECTION_TIME_OUT);
+    // notify FTP client about data connection port
+    Cstring<300> s;
+    sprintf (s, "229 entering passive mode (|||%i|)\r\n", __server__->__passiveDataPortFirst__ + passiveDataPortIndex);
+    if (sendString (s) <= 0) {
+        __server__->__freePassiveDataPort__ (passiveDataPortIndex);
         return "";
     }
-    return "425 can't open passive data connection\r\n";
+
+    return __acceptPassiveDataConnection__ (passiveDataPortIndex) ? "" : "425 can't open passive data connection\r\n";
 }
 
 // NLST is preceeded by PORT or PASV so data connection should already be opened
-const char *ftpServer_t::ftpControlConnection_t::__NLST__ (char *directoryName) {
+const char *ftpServer_t::ftpControlConnection_t::__NLST__ (char *directoryName, char listFormat) {
     const char *retVal = "";
     if (__homeDirectory__ == "") {
         retVal = "530 not logged in\r\n";
@@ -495,7 +783,9 @@ const char *ftpServer_t::ftpControlConnection_t::__NLST__ (char *directoryName)
                 if (!__fileSystem__.userHasRightToAccessDirectory (fullPath, __homeDirectory__)) {
                     retVal = "550 access denyed\r\n";
                 } else {
-                    if (sendString ("150 starting data transfer\r\n") > 0) {
+                    if (!__dataConnection__) {
+                        retVal = "425 no data connection, use PASV or PORT first\r\n";
+                    } else if (sendString ("150 starting data transfer\r\n") > 0) {
                         /*
                         threadSafeFS::File d = __fileSystem__.open (fullPath);
                         if (d) {
@@ -512,16 +802,29 @@ const char *ftpServer_t::ftpControlConnection_t::__NLST__ (char *directoryName)
                             d.close ();
                         }
                         */
-                        for (auto f : __fileSystem__.open (fullPath)) {
-                            Cstring<255> fullFileName = fullPath;
-                            if (fullFileName [fullFileName.length () - 1] != '/')
-                                fullFileName += '/';
-                            fullFileName += f.name ();
-                            if (__dataConnection__->sendString (__fileSystem__.fileInformation (fullFileName) + "\r\n") <= 0) {
+                        if (listFormat == 'l') {
+                            // LIST output is cached by the file system, clients repeat it all the time
+                            threadSafeFS::DirectoryListing listing = __fileSystem__.listDirectory (fullPath);
+                            if (!listing)
+                                retVal = "451 out of memory\r\n";
+                            else if (listing.length () && __dataSend__ (listing.c_str (), listing.length ()) != (int) listing.length ())
                                 retVal = "426 data transfer error\r\n";
-                                break;
+                        } else {
+                            // everything is taken from the directory entries while iterating, files don't get opened again by their paths
+                            for (auto f : __fileSystem__.open (fullPath)) {
+                                int bytesSent;
+                                if (listFormat == 'n')
+                                    bytesSent = __dataSend__ (f.name () + "\r\n");
+                                else
+                                    bytesSent = __dataSend__ (__mlsxFacts__ (f) + " " + f.name () + "\r\n");
+                                if (bytesSent <= 0) {
+                                    retVal = "426 data transfer error\r\n";
+                                    break;
+                                }
                             }
                         }
+                        if (!*retVal && !__dataFinish__ ())
+                            retVal = "426 data transfer error\r\n";
                         if (!*retVal)
                             sendString ("226 data transfer complete\r\n");
                         else
@@ -532,10 +835,39 @@ const char *ftpServer_t::ftpControlConnection_t::__NLST__ (char *directoryName)
         }
     }
 
-    __closeDataConnection__ ();
+    __endDataTransfer__ (!*retVal);
     return retVal;
 }
 
+Cstring<300> ftpServer_t::ftpControlConnection_t::__MLST__ (char *fileOrDirName) {
+    if (__homeDirectory__ == "")                                                        return "530 not logged in\r\n";
+    if (!__fileSystem__.mounted ())                                                     return "421 file system not mounted\r\n";
+    Cstring<255> fullPath = __fileSystem__.makeFullPath (fileOrDirName, __workingDirectory__);
+    if (fullPath == "")                                                                 return "501 invalid file name\r\n";
+    if (!__fileSystem__.userHasRightToAccessFile (fullPath, __homeDirectory__) &&
+        !__fileSystem__.userHasRightToAccessDirectory (fullPath, __homeDirectory__))    return "550 access denyed\r\n";
+
+    threadSafeFS::File f = __fileSystem__.open (fullPath, FILE_READ);
+    if (!f)                                                                             return "550 file not found\r\n";
+
+    // facts and the full path together may not fit in one reply, so send the fact line right away
+    if (sendString ("250-listing\r\n ") <= 0 || sendString (__mlsxFacts__ (f)) <= 0 || sendString (Cstring<300> (" ") + fullPath + "\r\n") <= 0)
+        return "";
+    return "250 end\r\n";
+}
+
+// RFC 3659 facts: type=file;size=1234;modify=20260424123456;
+Cstring<300> ftpServer_t::ftpControlConnection_t::__mlsxFacts__ (threadSafeFS::File& f) {
+    Cstring<300> s;
+    struct tm fTime = {};
+    time_t lTime = f.getLastWrite ();
+    gmtime_r (&lTime, &fTime); // MLSx times are always UTC
+    char modify [16];
+    strftime (modify, sizeof (modify), "%Y%m%d%H%M%S", &fTime);
+    sprintf (s, "type=%s;size=%u;modify=%s;", f.isDirectory () ? "dir" : "file", f.size (), modify);
+    return s;
+}
+
 const char *ftpServer_t::ftpControlConnection_t::__RNFR__ (char *fileOrDirName) {
     __rnfrIs__ = ' ';
     if (__homeDirectory__ == "")                                                            return "530 not logged in\r\n";
@@ -576,7 +908,20 @@ const char *ftpServer_t::ftpControlConnection_t::__RNTO__ (char *fileOrDirName)
     return "553 unable to rename\r\n";
 }
 
-const char *ftpServer_t::ftpControlConnection_t::__RETR__ (char *fileName) {
+Cstring<300> ftpServer_t::ftpControlConnection_t::__REST__ (char *offset) {
+    if (__homeDirectory__ == "")
+        return "530 not logged in\r\n";
+
+    char *endptr;
+    unsigned long o = strtoul (offset, &endptr, 10);
+    if (!*offset || *endptr || *offset == '-')
+        return "501 invalid restart offset\r\n";
+
+    __restartOffset__ = o;
+    return Cstring<300> ("350 restarting at ") + offset + "\r\n";
+}
+
+const char *ftpServer_t::ftpControlConnection_t::__RETR__ (char *fileName, unsigned long restartOffset) {
     const char *retVal = "";
     if (__homeDirectory__ == "") {
         retVal = "530 not logged in\r\n";
@@ -591,44 +936,63 @@ const char *ftpServer_t::ftpControlConnection_t::__RETR__ (char *fileName) {
                 if (!__fileSystem__.userHasRightToAccessDirectory (fullPath, __homeDirectory__)) {
                     retVal = "550 access denyed\r\n";
                 } else {
-                    if (sendString ("150 starting data transfer\r\n") > 0) {
-                        int bytesReadTotal = 0;
-                        int bytesSentTotal = 0;
+                    if (!__dataConnection__) {
+                        retVal = "425 no data connection, use PASV or PORT first\r\n";
+                    } else if (sendString ("150 starting data transfer\r\n") > 0) {
+                        unsigned long startMillis = millis ();
+                        unsigned long bytesSentTotal = 0;
                         threadSafeFS::File f = __fileSystem__.open (fullPath, FILE_READ);
-                        if (f) {
-                            char buff [1024];
-                            do {
-                                int bytesReadThisTime =
-                                    f.read ((uint8_t *) buff, sizeof (buff));
-                                if (bytesReadThisTime == 0)
-                                    break;
-                                bytesReadTotal += bytesReadThisTime;
-                                int bytesSentThisTime =
-                                    __dataConnection__->sendBlock (buff, bytesReadThisTime);
-                                if (bytesSentThisTime != bytesReadThisTime) {
-                                    retVal = "426 data transfer error\r\n";
-                                    break;
+                        if (f && restartOffset && (restartOffset > f.size () || !f.seek (restartOffset, SeekSet))) {
+                            retVal = "554 restart offset is beyond the end of file\r\n";
+                        } else if (f) {
+                            { // the pipeline must finish before the file is closed
+                                filePipeline_t pipeline (f, filePipeline_t::READING, ftpRetrBufferCount, ftpRetrBufferSize, FTP_TRANSFER_BUFFERS_IN_PSRAM);
+                                if (!pipeline) {
+                                    retVal = "451 out of memory\r\n";
+                                } else {
+                                    char *buff;
+                                    int bytesReadThisTime;
+                                    while ((bytesReadThisTime = pipeline.nextBlock (buff)) > 0) {
+                                        int bytesSentThisTime = __dataSend__ (buff, bytesReadThisTime);
+                                        pipeline.releaseBlock ();
+                                        if (bytesSentThisTime != bytesReadThisTime) {
+                                            retVal = "426 data transfer error\r\n";
+                                            break;
+                                        }
+                                        bytesSentTotal += bytesSentThisTime;
+                                    }
+                                    if (!*retVal && bytesReadThisTime < 0) {
+                                        cout << ( dmesgQueue << "[ftpCtrlConn] " << "RETR " << fullPath << " read error after " << bytesSentTotal << " bytes" );
+                                        retVal = "451 error reading the file\r\n";
+                                    }
+                                    if (!*retVal && !__dataFinish__ ())
+                                        retVal = "426 data transfer error\r\n";
                                 }
-                                bytesSentTotal += bytesSentThisTime;
-                            } while (true);
+                            }
                             f.close ();
                         } else {
                             retVal = "450 can not open the file\r\n";
                         }
 
-                        if (!*retVal)
+                        if (!*retVal) {
+                            unsigned long transferMillis = max (1UL, millis () - startMillis);
+                            if (__transferMode__ == 'Z')
+                                cout << ( dmesgQueue << "[ftpCtrlConn] " << "RETR " << fullPath << " " << bytesSentTotal << " bytes compressed to " << __dataConnectionBytes__ << " in " << transferMillis << " ms, " << (unsigned long) ((uint64_t) bytesSentTotal * 1000 / 1024 / transferMillis) << " KB/s, compression took " << __compressionMicros__ / 1000 << " ms" );
+                            else
+                                cout << ( dmesgQueue << "[ftpCtrlConn] " << "RETR " << fullPath << " " << bytesSentTotal << " bytes in " << transferMillis << " ms, " << (unsigned long) ((uint64_t) bytesSentTotal * 1000 / 1024 / transferMillis) << " KB/s" );
                             sendString ("226 data transfer complete\r\n");
+                        }
                     }
                 }
             }
         }
     }
 
-    __closeDataConnection__ ();
+    __endDataTransfer__ (!*retVal);
     return retVal;
 }
 
-const char *ftpServer_t::ftpControlConnection_t::__STOR__ (char *fileName) {
+const char *ftpServer_t::ftpControlConnection_t::__STOR__ (char *fileName, unsigned long restartOffset, bool append) {
     const char *retVal = "";
     if (__homeDirectory__ == "") {
         retVal = "530 not logged in\r\n";
@@ -643,64 +1007,182 @@ const char *ftpServer_t::ftpControlConnection_t::__STOR__ (char *fileName) {
                 if (!__fileSystem__.userHasRightToAccessDirectory (fullPath, __homeDirectory__)) {
                     retVal = "550 access denyed\r\n";
                 } else {
-                    if (sendString ("150 starting data transfer\r\n") > 0) {
-                        int bytesRecvTotal = 0;
-                        int bytesWrittenTotal = 0;
-                        threadSafeFS::File f = __fileSystem__.open (fullPath, FILE_WRITE);
-                        if (f) {
-                            char buff [1024];
-                            do {
-                                int bytesRecvThisTime = __dataConnection__->recv (buff, sizeof (buff));
-                                if (bytesRecvThisTime < 0) {
-                                    retVal = "426 data transfer error\r\n";
-                                    break;
-                                }
-                                if (bytesRecvThisTime == 0)
-                                    break;
-                                bytesRecvTotal += bytesRecvThisTime;
-                                int bytesWrittenThisTime = f.write ((uint8_t *) buff, bytesRecvThisTime);
-                                bytesWrittenTotal += bytesWrittenThisTime;
-                                if (bytesWrittenThisTime != bytesRecvThisTime) {
-                                    retVal = "450 can not write the file\r\n";
-                                    break;
+                    if (!__dataConnection__) {
+                        retVal = "425 no data connection, use PASV or PORT first\r\n";
+                    } else if (sendString ("150 starting data transfer\r\n") > 0) {
+                        unsigned long startMillis = millis ();
+                        unsigned long bytesRecvTotal = 0;
+                        // resumed upload overwrites the file from restartOffset on (the file is not truncated, clients resume from its current size)
+                        threadSafeFS::File f = __fileSystem__.open (fullPath, append ? FILE_APPEND : restartOffset ? "r+" : FILE_WRITE);
+                        if (f && restartOffset && (restartOffset > f.size () || !f.seek (restartOffset, SeekSet))) {
+                            retVal = "554 restart offset is beyond the end of file\r\n";
+                        } else if (f) {
+                            { // the pipeline must finish before the file is closed
+                                filePipeline_t pipeline (f, filePipeline_t::WRITING, ftpStorBufferCount, ftpStorBufferSize, FTP_TRANSFER_BUFFERS_IN_PSRAM);
+                                if (!pipeline) {
+                                    retVal = "451 out of memory\r\n";
+                                } else {
+                                    bool endOfData = false;
+                                    while (!endOfData && !pipeline.writeFailed ()) {
+                                        // fill the whole buffer before handing it over, so the file gets written in large blocks
+                                        char *buff;
+                                        size_t buffSize = pipeline.emptyBlock (buff);
+                                        size_t bytesInBuff = 0;
+                                        while (bytesInBuff < buffSize) {
+                                            int bytesRecvThisTime = __dataRecv__ (buff + bytesInBuff, buffSize - bytesInBuff);
+                                            if (bytesRecvThisTime < 0) {
+                                                retVal = "426 data transfer error\r\n";
+                                                endOfData = true;
+                                                break;
+                                            }
+                                            if (bytesRecvThisTime == 0) {
+                                                endOfData = true;
+                                                break;
+                                            }
+                                            bytesInBuff += bytesRecvThisTime;
+                                        }
+                                        pipeline.writeBlock (bytesInBuff);
+                                        bytesRecvTotal += bytesInBuff;
+                                    }
+                                    if (!pipeline.finish () && !*retVal)
+                                        retVal = "450 can not write the file\r\n";
                                 }
-                            } while (true);
+                            }
                             f.close ();
                         } else {
                             retVal = "450 can not open the file\r\n";
                         }
 
-                        if (!*retVal)
+                        if (!*retVal) {
+                            unsigned long transferMillis = max (1UL, millis () - startMillis);
+                            if (__transferMode__ == 'Z')
+                                cout << ( dmesgQueue << "[ftpCtrlConn] " << (append ? "APPE " : "STOR ") << fullPath << " " << bytesRecvTotal << " bytes decompressed from " << __dataConnectionBytes__ << " in " << transferMillis << " ms, " << (unsigned long) ((uint64_t) bytesRecvTotal * 1000 / 1024 / transferMillis) << " KB/s, decompression took " << __compressionMicros__ / 1000 << " ms" );
+                            else
+                                cout << ( dmesgQueue << "[ftpCtrlConn] " << (append ? "APPE " : "STOR ") << fullPath << " " << bytesRecvTotal << " bytes in " << transferMillis << " ms, " << (unsigned long) ((uint64_t) bytesRecvTotal * 1000 / 1024 / transferMillis) << " KB/s" );
                             sendString ("226 data transfer complete\r\n");
+                        }
                     }
                 }
             }
         }
     }
 
-    __closeDataConnection__ ();
+    __endDataTransfer__ (!*retVal);
     return retVal;
 }
 
+Cstring<300> ftpServer_t::ftpControlConnection_t::__SITE__ (char *siteCommandLine) {
+    // split SITE command line into the name and its arguments
+    char *arguments = siteCommandLine;
+    while (*arguments > ' ')
+        arguments++;
+    if (*arguments) {
+        *arguments++ = 0;
+        while (*arguments && *arguments <= ' ')
+            arguments++;
+    }
+
+    if (!strcasecmp (siteCommandLine, "HELP")) {
+        if (sendString ("214-SITE commands:\r\n") <= 0)
+            return "";
+        for (int i = 0; i < __server__->__siteCommandCount__; i++)
+            if (sendString (Cstring<300> (" ") + __server__->__siteCommands__ [i].name + " " + __server__->__siteCommands__ [i].help + "\r\n") <= 0)
+                return "";
+        return "214 end\r\n";
+    }
+
+    for (int i = 0; i < __server__->__siteCommandCount__; i++)
+        if (!strcasecmp (siteCommandLine, __server__->__siteCommands__ [i].name))
+            return __server__->__siteCommands__ [i].handler (*this, arguments);
+
+    return Cstring<300> ("504 SITE ") + siteCommandLine + " not supported\r\n";
+}
+
 // ----- ftpServer_t implementation -----
 
 ftpServer_t::ftpServer_t (threadSafeFS::FS& fileSystem,
                           Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName,const Cstring<64>& password),
                           int serverPort,
-                          bool (*firewallCallback) (char *clientIP, char *serverIP),
-                          bool runListenerInItsOwnTask) : tcpServer_t (serverPort, firewallCallback, runListenerInItsOwnTask),
-                                                          __fileSystem__ (fileSystem),
-                                                          __getUserHomeDirectory__ (getUserHomeDirectory) {
+                          bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress),
+                          bool runListenerInItsOwnTask,
+                          int passiveDataPortFirst) : tcpServer_t (serverPort, firewallCallback, runListenerInItsOwnTask),
+                                                      __fileSystem__ (fileSystem),
+                                                      __getUserHomeDirectory__ (getUserHomeDirectory),
+                                                      __passiveDataPortFirst__ (passiveDataPortFirst) {
+    // control connections may legitimately stay idle for FTP_CONTROL_CONNECTION_TIME_OUT but dead clients should be detected sooner
+    setKeepAlive ();
+    ftpControlConnection_t::__pool__.begin (sizeof (ftpControlConnection_t), FTP_CONNECTION_POOL_SIZE, CONNECTION_POOLS_IN_PSRAM);
+
+    // bind passive data ports once, for the whole life of the server
+    __passiveDataPortsMutex__ = xSemaphoreCreateMutex ();
+    for (int i = 0; i < FTP_PASSIVE_DATA_PORT_COUNT; i++) {
+        __passiveDataServers__ [i] = new (std::nothrow) tcpServer_t (__passiveDataPortFirst__ + i, NULL, false);
+        if (__passiveDataServers__ [i] && *__passiveDataServers__ [i])
+            __freePassiveDataPorts__ [__freePassiveDataPortCount__ ++] = i;
+        else
+            cout << ( dmesgQueue << "[ftpServer] " << "can't listen on passive data port " << __passiveDataPortFirst__ + i );
+    }
+}
+
+ftpServer_t::~ftpServer_t () {
+    // stop accepting control connections and wait until the running ones stop using passive data ports and SITE commands
+    __unregisterFromListener__ ();
+    if (__atomic_load_n (&__runningConnections__, __ATOMIC_SEQ_CST) > 0) {
+        cout << ( dmesgQueue << "[ftpServer] " << "waiting for " << __atomic_load_n (&__runningConnections__, __ATOMIC_SEQ_CST) << " connection(s) to end" );
+        while (__atomic_load_n (&__runningConnections__, __ATOMIC_SEQ_CST) > 0)
+            delay (25);
+    }
+
+    for (int i = 0; i < FTP_PASSIVE_DATA_PORT_COUNT; i++)
+        if (__passiveDataServers__ [i])
+            delete __passiveDataServers__ [i];
+    vSemaphoreDelete (__passiveDataPortsMutex__);
+}
+
+int ftpServer_t::__allocatePassiveDataPort__ () {
+    xSemaphoreTake (__passiveDataPortsMutex__, portMAX_DELAY);
+        int index = __freePassiveDataPortCount__ ? __freePassiveDataPorts__ [-- __freePassiveDataPortCount__] : -1;
+    xSemaphoreGive (__passiveDataPortsMutex__);
+    if (index < 0) {
+        cout << ( dmesgQueue << "[ftpServer] " << "no free passive data port, increase FTP_PASSIVE_DATA_PORT_COUNT" );
+        return -1;
+    }
+
+    // close the connections that arrived too late for the previous session, so that they can't be taken for this session's
+    ipAddress_t clientAddress, serverAddress;
+    int connectionSocket;
+    while ((connectionSocket = __passiveDataServers__ [index]->acceptSocket (clientAddress, serverAddress)) != -1) {
+        xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+            close (connectionSocket);
+        xSemaphoreGive (getLwIpMutex ());
+    }
+    return index;
+}
+
+void ftpServer_t::__freePassiveDataPort__ (int index) {
+    xSemaphoreTake (__passiveDataPortsMutex__, portMAX_DELAY);
+        __freePassiveDataPorts__ [__freePassiveDataPortCount__ ++] = index;
+    xSemaphoreGive (__passiveDataPortsMutex__);
+}
+
+bool ftpServer_t::addSiteCommand (const char *name, Cstring<300> (*handler) (ftpControlConnection_t& connection, char *arguments), const char *help) {
+    if (__siteCommandCount__ == FTP_SITE_COMMAND_COUNT) {
+        cout << ( dmesgQueue << "[ftpServer] " << "can't add SITE " << name << ", increase FTP_SITE_COMMAND_COUNT" );
+        return false;
+    }
+    __siteCommands__ [__siteCommandCount__] = { name, handler, help };
+    __siteCommandCount__ ++; // connections may be reading the table already, so the new entry must be complete before it is counted
+    return true;
 }
 
-tcpConnection_t *ftpServer_t::__createConnectionInstance__ (int connectionSocket, char *clientIP, char *serverIP) {
+tcpConnection_t *ftpServer_t::__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) {
     #define ftpServiceUnavailableReply "421 FTP service is currently unavailable. Free heap: %lu bytes. Free heap in one piece: %u bytes.\r\n"
 
     ftpControlConnection_t *connection = new (std::nothrow) ftpControlConnection_t (__fileSystem__,
                                                                                     __getUserHomeDirectory__,
                                                                                     connectionSocket,
-                                                                                    clientIP,
-                                                                                    serverIP);
+                                                                                    clientAddress,
+                                                                                    serverAddress);
 
     if (!connection) {
         cout << ( dmesgQueue << "[ftpServer] " << "can't create connection instance, out of memory" );
@@ -711,7 +1193,10 @@ tcpConnection_t *ftpServer_t::__createConnectionInstance__ (int connectionSocket
         return NULL;
     }
 
-    connection->setIdleTimeout (FTP_CONTROL_CONNECTION_TIME_OUT);
+    connection->setIdleTimeout (ftpControlConnectionTimeOut);
+    connection->setServerBandwidthLimit (&getBandwidthLimit ());
+    connection->__server__ = this;
+    __atomic_add_fetch (&__runningConnections__, 1, __ATOMIC_SEQ_CST);
 
     #define tskNORMAL_PRIORITY (tskIDLE_PRIORITY + 1)
     if (pdPASS != xTaskCreate ([] (void *thisInstance) {
@@ -726,14 +1211,17 @@ tcpConnection_t *ftpServer_t::__createConnectionInstance__ (int connectionSocket
                                                                 __runningTcpConnections__--;
                                                             xSemaphoreGive (getLwIpMutex ());
 
+                                                            ftpServer_t *server = ths->__server__;
                                                             delete ths;
+                                                            __atomic_sub_fetch (&server->__runningConnections__, 1, __ATOMIC_SEQ_CST); // only after the connection is completely gone
                                                             vTaskDelete (NULL);
-                                                        }, "ftpCtrlConn", FTP_CONTROL_CONNECTION_STACK_SIZE, connection, tskNORMAL_PRIORITY, NULL)) {
+                                                        }, "ftpCtrlConn", ftpControlConnectionStackSize, connection, tskNORMAL_PRIORITY, NULL)) {
         cout << ( dmesgQueue << "[ftpServer] " << "can't create connection task, out of memory" );
         char s [128];
         sprintf (s, ftpServiceUnavailableReply, esp_get_free_heap_size (), heap_caps_get_largest_free_block (MALLOC_CAP_DEFAULT));
         connection->sendString (s);
         delete connection;
+        __atomic_sub_fetch (&__runningConnections__, 1, __ATOMIC_SEQ_CST);
         return NULL;
     }
 
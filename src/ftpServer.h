@@ -89,6 +89,9 @@
     #include <Cstring.hpp>      // include LightweightSTL library: https://github.com/BojanJurca/Lightweight-Standard-Template-Library-STL-for-Arduino
     #include <FS.h>
     #include <threadSafeFS.h>
+    #include "objectPool.h"
+    #include "filePipeline.h"
+    #include "zlibStream.h"
 
 
     // TUNING PARAMETERS
@@ -99,8 +102,17 @@
     #ifndef FTP_CMDLINE_BUFFER_SIZE
         #define FTP_CMDLINE_BUFFER_SIZE 300                     // reading and temporary keeping FTP command lines                    
     #endif
-    #ifndef FTP_SESSION_MAX_ARGC
-        #define FTP_SESSION_MAX_ARGC 5                          // max number of arguments in command line, 5 is enough for FTP protocol                       
+    #ifndef FTP_SITE_COMMAND_COUNT
+        #define FTP_SITE_COMMAND_COUNT 4                        // max number of SITE commands that can be added with addSiteCommand
+    #endif
+    #ifndef FTP_CONNECTION_POOL_SIZE
+        #define FTP_CONNECTION_POOL_SIZE 4                      // number of control connection objects preallocated when the server starts, more connections are still possible but they are allocated on the heap
+    #endif
+    #ifndef FTP_PASSIVE_DATA_PORT_FIRST
+        #define FTP_PASSIVE_DATA_PORT_FIRST 1024                // passive data connections use ports FTP_PASSIVE_DATA_PORT_FIRST (default of ftpServer_t constructor argument) ...
+    #endif
+    #ifndef FTP_PASSIVE_DATA_PORT_COUNT
+        #define FTP_PASSIVE_DATA_PORT_COUNT 4                   // ... FTP_PASSIVE_DATA_PORT_FIRST + FTP_PASSIVE_DATA_PORT_COUNT - 1, each port keeps one listening socket all the time (mind CONFIG_LWIP_MAX_SOCKETS)
     #endif
     #ifndef FTP_CONTROL_CONNECTION_TIME_OUT
         #define FTP_CONTROL_CONNECTION_TIME_OUT 300             // 300 s = 5 min, set to 0 for infinite            
@@ -108,6 +120,40 @@
     #ifndef FTP_DATA_CONNECTION_TIME_OUT
         #define FTP_DATA_CONNECTION_TIME_OUT 3                  // 3 s, set to 0 for infinite            
     #endif
+    #ifndef FTP_RETR_BUFFER_COUNT
+        #define FTP_RETR_BUFFER_COUNT 2                         // RETR reads the file into one buffer while it sends the other one
+    #endif
+    #ifndef FTP_RETR_BUFFER_SIZE
+        #define FTP_RETR_BUFFER_SIZE (4 * 1024)                 // each RETR in progress uses FTP_RETR_BUFFER_COUNT * FTP_RETR_BUFFER_SIZE bytes of memory
+    #endif
+    #ifndef FTP_STOR_BUFFER_COUNT
+        #define FTP_STOR_BUFFER_COUNT 4                         // STOR keeps receiving while up to FTP_STOR_BUFFER_COUNT buffers wait to be written to the file
+    #endif
+    #ifndef FTP_STOR_BUFFER_SIZE
+        #define FTP_STOR_BUFFER_SIZE (4 * 1024)                 // a multiple of flash sector size (4 KB) gives aligned writes
+    #endif
+    #ifndef FTP_TRANSFER_BUFFERS_IN_PSRAM
+        #define FTP_TRANSFER_BUFFERS_IN_PSRAM 0                 // set to 1 to put file transfer buffers in PSRAM (if the board has it)
+    #endif
+    #ifndef FTP_MODE_Z_WINDOW_BITS
+        #define FTP_MODE_Z_WINDOW_BITS 12                       // MODE Z compressor looks for repeated strings in the last 2^12 = 4 KB, this takes about 26 KB of memory during the transfer
+    #endif
+    #ifndef FTP_MODE_B_BLOCK_SIZE
+        #define FTP_MODE_B_BLOCK_SIZE (4 * 1024)                // MODE B sends data in blocks of up to this size (max 65535), the buffer is allocated during the transfer
+    #endif
+    #ifndef FTP_MODE_Z_BUFFER_SIZE
+        #define FTP_MODE_Z_BUFFER_SIZE 1024                     // compressed data is sent and received in pieces of this size
+    #endif
+
+    // run time values of tuning parameters
+    extern tunable_t ftpControlConnectionStackSize;
+    extern tunable_t ftpControlConnectionTimeOut;
+    extern tunable_t ftpDataConnectionTimeOut;
+    extern tunable_t ftpRetrBufferCount;
+    extern tunable_t ftpRetrBufferSize;
+    extern tunable_t ftpStorBufferCount;
+    extern tunable_t ftpStorBufferSize;
+    extern tunable_t ftpModeZWindowBits;
 
     #ifndef HOSTNAME
         #define HOSTNAME "Esp32Server"                          // use default HOSTNAME if not defined previously
@@ -126,6 +172,7 @@
 
                 threadSafeFS::FS& __fileSystem__;
                 Cstring<255> (*__getUserHomeDirectory__) (const Cstring<64>& userName, const Cstring<64>& password) = NULL;
+                ftpServer_t *__server__ = NULL; // passive data ports belong to the server
 
                 // FTP session related variables
                 char __cmdLine__ [FTP_CMDLINE_BUFFER_SIZE];
@@ -136,22 +183,44 @@
 
                 static UBaseType_t __lastHighWaterMark__;
 
+                static objectPool_t __pool__;
+
                 tcpClient_t      *__activeDataClient__  = NULL;
                 tcpConnection_t  *__dataConnection__    = NULL;
 
                 Cstring<255> __rnfrPath__;
                 char __rnfrIs__; // 'f' or 'd'
 
+                unsigned long __restartOffset__ = 0; // set by REST, used by the following RETR or STOR
+
+                char __transferMode__ = 'S'; // 'S' (stream), 'B' (block) or 'Z' (deflate), set by MODE
+                deflate_t *__deflate__ = NULL; // MODE Z compressor of the data being sent
+                inflate_t *__inflate__ = NULL; // MODE Z decompressor of the data being received
+                unsigned long __dataConnectionBytes__ = 0; // bytes that actually went through the data connection
+                unsigned long __compressionMicros__ = 0; // CPU time spent compressing or decompressing
+                char *__block__ = NULL; // MODE B block being sent, 3 bytes of header followed by the data
+                size_t __blockLength__ = 0;
+                size_t __blockRemaining__ = 0; // data bytes of the MODE B block being received that haven't been read yet
+                bool __lastBlock__ = false; // the block being received is marked EOF
+
             public:
 
                 ftpControlConnection_t (threadSafeFS::FS& fileSystem,
                                         Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password),
                                         int connectionSocket,
-                                        char *clientIP,
-                                        char *serverIP);
+                                        const ipAddress_t& clientAddress,
+                                        const ipAddress_t& serverAddress);
 
                 ~ftpControlConnection_t ();
 
+                // control connections are taken from the pool preallocated by the server
+                static void *operator new (size_t size, const std::nothrow_t&) noexcept { return __pool__.allocate (size); }
+                static void operator delete (void *p) { __pool__.free (p); }
+                static void operator delete (void *p, const std::nothrow_t&) noexcept { __pool__.free (p); }
+
+                // position of the command (case insensitive) in the dispatch table, -1 if it is not supported, this is all the dispatcher does before calling the handler
+                static int commandIndex (const char *command);
+
                 // FTP session related variables
                 inline char *getUserName () __attribute__((always_inline)) { return __userName__; }
                 inline char *getHomeDirectory () __attribute__((always_inline)) { return __homeDirectory__; }
@@ -163,7 +232,23 @@
                 void __runConnectionTask__ ();
 
                 // command dispatcher
-                cstring __internalCommandHandler__ (int argc, char *argv []);
+                Cstring<300> __internalCommandHandler__ (char *command, char *argument);
+
+                enum ARGUMENT_TYPE { NO_ARGUMENT = 0, OPTIONAL_ARGUMENT = 1, REQUIRED_ARGUMENT = 2, DIRECTORY_ARGUMENT = 3 }; // DIRECTORY_ARGUMENT is the working directory if missing
+
+                struct __command_t__ {
+                    uint32_t code;                                                          // command name packed in 4 bytes
+                    ARGUMENT_TYPE argument;
+                    bool needsLogin;
+                    bool keepsRestartOffset;                                                // REST applies to the following transfer even if these commands come in between
+                    Cstring<300> (*handler) (ftpControlConnection_t *connection, char *argument);
+                };
+                static const __command_t__ __commands__ [];
+
+                // "RETR" -> 'R' << 24 | 'E' << 16 | 'T' << 8 | 'R', 3 letter commands end with 0
+                static constexpr uint32_t __commandCode__ (const char *name) { return (uint32_t) name [0] << 24 | (uint32_t) name [1] << 16 | (uint32_t) name [2] << 8 | (uint32_t) name [3]; }
+                static uint32_t __packCommand__ (const char *command); // case insensitive, 0 if it can't be a command
+                static int __findCommand__ (uint32_t code);
 
                 // user/session commands
                 Cstring<300>   __USER__ (char *userName);
@@ -173,19 +258,33 @@
                 const char    *__XMKD__ (char *directoryName);
                 const char    *__XRMD__ (char *fileOrDirName);
                 Cstring<300>   __SIZE__ (char *fileName);
+                Cstring<300>   __MDTM__ (char *fileName);
+                Cstring<300>   __MFMT__ (char *timeAndFileName);
 
                 // data connection management
                 void           __closeDataConnection__ ();
-                int            __pasiveDataPort__ ();
+                void           __endDataTransfer__ (bool success); // closes the data connection, unless MODE B can use it for the next transfer
+                void           __resetDataTransfer__ ();
+                bool           __sendBlock__ (uint8_t descriptor);
+                int            __dataSend__ (const char *buffer, size_t length); // sends through the current MODE, returns length or <= 0 in case of error
+                inline int     __dataSend__ (const char *s) __attribute__((always_inline)) { return __dataSend__ (s, strlen (s)); }
+                int            __dataRecv__ (char *buffer, size_t length); // receives through the current MODE, returns 0 at the end of data and -1 in case of error
+                bool           __dataFinish__ (); // ends the data sent through the current MODE
+                Cstring<300>   __MODE__ (char *mode);
+                bool           __acceptPassiveDataConnection__ (int passiveDataPortIndex);
                 const char    *__PORT__ (char *dataConnectionInfo);
                 const char    *__EPRT__ (char *dataConnectionInfo);
                 const char    *__PASV__ ();
                 const char    *__EPSV__ ();
-                const char    *__NLST__ (char *directoryName);
+                const char    *__NLST__ (char *directoryName, char listFormat); // 'l' for LIST, 'n' for NLST, 'm' for MLSD
+                Cstring<300>   __MLST__ (char *fileOrDirName);
+                Cstring<300>   __mlsxFacts__ (threadSafeFS::File& f);
                 const char    *__RNFR__ (char *fileOrDirName);
                 const char    *__RNTO__ (char *fileOrDirName);
-                const char    *__RETR__ (char *fileName);
-                const char    *__STOR__ (char *fileName);
+                Cstring<300>   __REST__ (char *offset);
+                const char    *__RETR__ (char *fileName, unsigned long restartOffset);
+                const char    *__STOR__ (char *fileName, unsigned long restartOffset, bool append);
+                Cstring<300>   __SITE__ (char *siteCommandLine);
             };
 
         private:
@@ -193,18 +292,47 @@
             threadSafeFS::FS& __fileSystem__;
             Cstring<255> (*__getUserHomeDirectory__) (const Cstring<64>& userName, const Cstring<64>& password) = NULL;
 
+            // passive data ports are bound and listening all the time, sessions take them from the free list between PASV/EPSV and the client's connection
+            int __passiveDataPortFirst__;
+            tcpServer_t *__passiveDataServers__ [FTP_PASSIVE_DATA_PORT_COUNT] = {};
+            int __freePassiveDataPorts__ [FTP_PASSIVE_DATA_PORT_COUNT];
+            int __freePassiveDataPortCount__ = 0;
+            SemaphoreHandle_t __passiveDataPortsMutex__;
+
+            int __runningConnections__ = 0; // control connections that still use passive data ports and SITE commands, the destructor waits until they end
+
+            int __allocatePassiveDataPort__ (); // returns the index of the port or -1 if there is no free port
+            void __freePassiveDataPort__ (int index);
+
+            struct __siteCommand_t__ {
+                const char *name;
+                Cstring<300> (*handler) (ftpControlConnection_t& connection, char *arguments);
+                const char *help;
+            };
+            __siteCommand_t__ __siteCommands__ [FTP_SITE_COMMAND_COUNT];
+            int __siteCommandCount__ = 0;
+
         public:
 
             ftpServer_t (threadSafeFS::FS& fileSystem,
                          Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password) = NULL,
                          int serverPort = 21,
-                         bool (*firewallCallback) (char *clientIP, char *serverIP) = NULL,
-                         bool runListenerInItsOwnTask = true);
+                         bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL,
+                         bool runListenerInItsOwnTask = true,
+                         int passiveDataPortFirst = FTP_PASSIVE_DATA_PORT_FIRST); // each FTP server instance needs its own range of FTP_PASSIVE_DATA_PORT_COUNT passive data ports
 
-            tcpConnection_t *__createConnectionInstance__ (int connectionSocket, char *clientIP, char *serverIP) override;
+            ~ftpServer_t ();
+
+            tcpConnection_t *__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) override;
 
             // accept any connection, the client will get notified in __createConnectionInstance__
             inline tcpConnection_t *accept () __attribute__((always_inline)) { return tcpServer_t::accept (); }
+
+            // control connection pool (shared by all FTP servers) statistics
+            static inline objectPool_t& getConnectionPool () __attribute__((always_inline)) { return ftpControlConnection_t::__pool__; }
+
+            // adds SITE <name> [arguments] command (name is case insensitive), the handler returns the reply (for example "200 done\r\n"), returns false if there is no room for another one
+            bool addSiteCommand (const char *name, Cstring<300> (*handler) (ftpControlConnection_t& connection, char *arguments), const char *help = "");
     };
 
 #endif
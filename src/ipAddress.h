@@ -0,0 +1,83 @@
+/*
+
+    ipAddress.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 24, 2026, Bojan Jurca
+
+
+    ipAddress_t keeps IPv4 and IPv6 addresses in binary form (16 bytes in network byte order). IPv4 addresses are kept in
+    IPv4-mapped IPv6 form (::ffff:a.b.c.d), which is also how they arrive on the servers' dual-stack listening sockets, so
+    both kinds of addresses can be compared and matched against subnets the same way. Text is only made when needed.
+
+*/
+
+
+#pragma once
+#ifndef __IP_ADDRESS__
+    #define __IP_ADDRESS__
+
+
+    #include <WiFi.h>
+    #include <lwip/sockets.h>
+    #include <Cstring.hpp>      // include LightweightSTL library: https://github.com/BojanJurca/Lightweight-Standard-Template-Library-STL-for-Arduino
+
+
+    struct ipAddress_t {
+
+        uint8_t bytes [16] = {};    // :: (unspecified address) by default
+
+        ipAddress_t () {}
+
+        // from sockaddr_in or sockaddr_in6
+        ipAddress_t (const struct sockaddr *address) {
+            if (address->sa_family == AF_INET) {
+                bytes [10] = bytes [11] = 0xff;
+                memcpy (bytes + 12, &((const struct sockaddr_in *) address)->sin_addr, 4);
+            } else if (address->sa_family == AF_INET6) {
+                memcpy (bytes, &((const struct sockaddr_in6 *) address)->sin6_addr, 16);
+            }
+        }
+
+        // from text, returns false if the text is not a valid IPv4 or IPv6 address
+        bool parse (const char *text) {
+            ipAddress_t a;
+            if (inet_pton (AF_INET, text, a.bytes + 12) == 1) {
+                a.bytes [10] = a.bytes [11] = 0xff;
+            } else if (inet_pton (AF_INET6, text, a.bytes) != 1) {
+                return false;
+            }
+            *this = a;
+            return true;
+        }
+
+        inline bool isIPv4 () const __attribute__((always_inline)) {
+            static const uint8_t ipv4MappedPrefix [12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+            return !memcmp (bytes, ipv4MappedPrefix, 12);
+        }
+
+        inline bool isUnspecified () const __attribute__((always_inline)) {
+            for (int i = 0; i < 16; i++)
+                if (bytes [i])
+                    return false;
+            return true;
+        }
+
+        inline bool operator == (const ipAddress_t& other) const __attribute__((always_inline)) { return !memcmp (bytes, other.bytes, 16); }
+        inline bool operator != (const ipAddress_t& other) const __attribute__((always_inline)) { return memcmp (bytes, other.bytes, 16); }
+
+        // IPv4 addresses are formatted without ::ffff: prefix
+        Cstring<INET6_ADDRSTRLEN> toString () const {
+            Cstring<INET6_ADDRSTRLEN> s;
+            if (isIPv4 ())
+                inet_ntop (AF_INET, bytes + 12, s, INET6_ADDRSTRLEN);
+            else
+                inet_ntop (AF_INET6, bytes, s, INET6_ADDRSTRLEN);
+            return s;
+        }
+
+    };
+
+#endif
@@ -0,0 +1,236 @@
+/*
+
+    networkImpairmentProxy.cpp
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 17, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        networkImpairmentProxy_t
+
+*/
+
+
+#include <WiFi.h>
+#include <errno.h>
+#include "networkImpairmentProxy.h"
+#include <dmesg.hpp>
+#include <ostream.hpp>
+
+
+networkImpairmentProxy_t::networkImpairmentProxy_t (int proxyPort,
+                                                    const char *targetHost,
+                                                    int targetPort,
+                                                    const linkImpairment_t& upstream,
+                                                    const linkImpairment_t& downstream,
+                                                    uint32_t seed) : tcpServer_t (proxyPort, NULL, true),
+                                                                     __targetHost__ (targetHost),
+                                                                     __targetPort__ (targetPort),
+                                                                     __upstream__ (upstream),
+                                                                     __downstream__ (downstream),
+                                                                     __seed__ (seed ? seed : 1) {}
+
+networkImpairmentProxy_t::~networkImpairmentProxy_t () {
+    __unregisterFromListener__ (); // the listener must not start new sessions any more
+    // sessions keep the pointer to the proxy, wait until they finish
+    taskENTER_CRITICAL (&__spinlock__);
+        __stopping__ = true;
+    taskEXIT_CRITICAL (&__spinlock__);
+    while (__runningSessions__)
+        delay (10);
+}
+
+void networkImpairmentProxy_t::setImpairment (const linkImpairment_t& upstream, const linkImpairment_t& downstream) {
+    taskENTER_CRITICAL (&__spinlock__);
+        __upstream__ = upstream;
+        __downstream__ = downstream;
+    taskEXIT_CRITICAL (&__spinlock__);
+}
+
+
+tcpConnection_t *networkImpairmentProxy_t::__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) {
+    __session__ *session = new (std::nothrow) __session__ ();
+    tcpConnection_t *client = new (std::nothrow) tcpConnection_t (connectionSocket, clientAddress, serverAddress);
+    if (!session || !client || !*client) {
+        cout << ( dmesgQueue << "[networkImpairmentProxy] " << "can't create session, out of memory" );
+        if (client)
+            delete client; // closes the socket
+        else
+            close (connectionSocket);
+        if (session)
+            delete session;
+        return NULL;
+    }
+    client->setIdleTimeout (NETWORK_IMPAIRMENT_TIME_OUT);
+
+    taskENTER_CRITICAL (&__spinlock__);
+        bool stopping = __stopping__;
+        if (!stopping) {
+            session->proxy = this;
+            session->client = client;
+            session->random = (__seed__ + __runningSessions__ + __segments__) | 1; // the same seed and the same sequence of sessions give the same impairments (xorshift state must not be 0)
+            session->upstream.impairment = __upstream__;
+            session->downstream.impairment = __downstream__;
+            __runningSessions__ ++;
+        }
+    taskEXIT_CRITICAL (&__spinlock__);
+    if (stopping) {
+        delete client;
+        delete session;
+        return NULL;
+    }
+
+    #define tskNORMAL_PRIORITY (tskIDLE_PRIORITY + 1)
+    if (pdPASS != xTaskCreate ([] (void *param) {
+                                                    __session__ *session = (__session__ *) param;
+                                                    networkImpairmentProxy_t *proxy = session->proxy;
+
+                                                    __runSession__ (session);
+
+                                                    taskENTER_CRITICAL (&proxy->__spinlock__);
+                                                        proxy->__segments__ += session->segments;
+                                                        proxy->__lost__ += session->lost;
+                                                        proxy->__reordered__ += session->reordered;
+                                                        proxy->__runningSessions__ --;
+                                                    taskEXIT_CRITICAL (&proxy->__spinlock__);
+
+                                                    delete session;
+                                                    vTaskDelete (NULL);
+                                                }, "impairment", NETWORK_IMPAIRMENT_STACK_SIZE, session, tskNORMAL_PRIORITY, NULL)) {
+        cout << ( dmesgQueue << "[networkImpairmentProxy] " << "can't create session task, out of memory" );
+        taskENTER_CRITICAL (&__spinlock__);
+            __runningSessions__ --;
+        taskEXIT_CRITICAL (&__spinlock__);
+        delete client;
+        delete session;
+    }
+
+    return NULL;
+}
+
+
+void networkImpairmentProxy_t::__runSession__ (__session__ *session) {
+    tcpClient_t target (session->proxy->__targetHost__, session->proxy->__targetPort__);
+    if (target.getSocket () == -1) {
+        cout << ( dmesgQueue << "[networkImpairmentProxy] " << "can't connect to " << session->proxy->__targetHost__ << ":" << session->proxy->__targetPort__ );
+        delete session->client;
+        return;
+    }
+    target.setIdleTimeout (NETWORK_IMPAIRMENT_TIME_OUT);
+
+    session->upstream.from = session->downstream.to = session->client;
+    session->upstream.to = session->downstream.from = &target;
+
+    __direction__ *directions [2] = { &session->upstream, &session->downstream };
+    unsigned long lastActive = millis ();
+    while (true) {
+        // deliver what is due
+        for (__direction__ *d : directions)
+            if (!__deliver__ (*d))
+                goto endOfSession;
+
+        // the session ends when one side closes the connection and everything it sent before has been delivered
+        for (__direction__ *d : directions)
+            if (d->fromClosed && !d->count)
+                goto endOfSession;
+
+        if (millis () - lastActive > NETWORK_IMPAIRMENT_TIME_OUT * 1000)
+            goto endOfSession;
+
+        // wait for incoming data, but not longer than until the next segment is due
+        long waitMillis = 100;
+        fd_set readfds;
+        FD_ZERO (&readfds);
+        int maxfd = -1;
+        for (__direction__ *d : directions) {
+            if (d->count)
+                waitMillis = min (waitMillis, max (0L, (long) (d->queue [d->head].deliverAt - millis ())));
+            if (!d->fromClosed && d->count < NETWORK_IMPAIRMENT_QUEUE_LENGTH) { // stop reading when the queue is full, so TCP flow control slows the sender down
+                FD_SET (d->from->getSocket (), &readfds);
+                maxfd = max (maxfd, d->from->getSocket ());
+            }
+        }
+        if (maxfd == -1) {
+            delay (max (1L, waitMillis));
+            continue;
+        }
+        struct timeval tv = { 0, waitMillis * 1000 };
+        if (select (maxfd + 1, &readfds, NULL, NULL, &tv) <= 0)
+            continue;
+
+        for (__direction__ *d : directions)
+            if (!d->fromClosed && FD_ISSET (d->from->getSocket (), &readfds)) {
+                if (!__read__ (session, *d))
+                    d->fromClosed = true;
+                lastActive = millis ();
+            }
+    }
+
+endOfSession:
+    delete session->client;
+    // target closes itself when it goes out of scope
+}
+
+bool networkImpairmentProxy_t::__read__ (__session__ *session, __direction__& direction) {
+    __segment__& segment = direction.queue [(direction.head + direction.count) % NETWORK_IMPAIRMENT_QUEUE_LENGTH];
+    int received = direction.from->recv (segment.data, NETWORK_IMPAIRMENT_SEGMENT_SIZE);
+    if (received <= 0)
+        return false;
+
+    const linkImpairment_t& impairment = direction.impairment;
+    unsigned long now = millis ();
+
+    // transmission: segments queue behind each other on the link of limited bandwidth
+    unsigned long departure = direction.linkFreeAt - now < 0x80000000 ? direction.linkFreeAt : now; // max (now, linkFreeAt) that survives millis () overflow
+    if (impairment.bandwidth)
+        departure += (unsigned long) ((uint64_t) received * 1000 / impairment.bandwidth);
+    direction.linkFreeAt = departure;
+
+    // propagation, loss and reordering
+    unsigned long deliverAt = departure + impairment.latency;
+    if (impairment.jitter)
+        deliverAt += (unsigned long) (__random__ (session->random) * (impairment.jitter + 1));
+    if (impairment.loss > 0 && __random__ (session->random) < impairment.loss) {
+        deliverAt += impairment.retransmissionTimeOut;
+        session->lost ++;
+    }
+    if (impairment.reorder > 0 && __random__ (session->random) < impairment.reorder) {
+        deliverAt += impairment.reorderDelay;
+        session->reordered ++;
+    }
+
+    // TCP delivers in order, so a segment can not arrive before the previous one
+    if (direction.count && deliverAt - direction.lastDeliverAt >= 0x80000000)
+        deliverAt = direction.lastDeliverAt;
+    direction.lastDeliverAt = deliverAt;
+
+    segment.deliverAt = deliverAt;
+    segment.length = received;
+    direction.count ++;
+    session->segments ++;
+    return true;
+}
+
+bool networkImpairmentProxy_t::__deliver__ (__direction__& direction) {
+    while (direction.count) {
+        __segment__& segment = direction.queue [direction.head];
+        if (millis () - segment.deliverAt >= 0x80000000)
+            return true; // not due yet
+        if (direction.to->sendBlock (segment.data, segment.length) != segment.length)
+            return false;
+        direction.head = (direction.head + 1) % NETWORK_IMPAIRMENT_QUEUE_LENGTH;
+        direction.count --;
+    }
+    return true;
+}
+
+float networkImpairmentProxy_t::__random__ (uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,168 @@
+/*
+
+    networkImpairmentProxy.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 17, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        networkImpairmentProxy_t
+        linkImpairment_t
+
+    Inheritance diagram:
+
+             ┌─────────────┐
+             │ tcpServer_t ┼┐
+             └─────────────┘│     ┌───────────────────────────┐
+                            └─────┼─ networkImpairmentProxy_t │
+                                  └───────────────────────────┘
+
+    networkImpairmentProxy_t is a test tool. It listens on its own port and forwards each connection to the target server
+    (usually a server running on the same ESP32, reached through 127.0.0.1) while simulating a worse link than the one
+    actually used, so the servers can be benchmarked under the same conditions every time:
+
+                    client  ──►  proxyPort  ──── upstream impairment ────►  targetHost:targetPort
+                    client  ◄──  proxyPort  ◄─── downstream impairment ───  targetHost:targetPort
+
+    The data is read in segments of up to NETWORK_IMPAIRMENT_SEGMENT_SIZE bytes and each segment is delivered after:
+
+        - the time needed to pass the link of the given bandwidth (segments queue behind each other),
+        - latency plus random jitter,
+        - retransmissionTimeOut if the segment is "lost",
+        - reorderDelay if the segment is "reordered".
+
+    The proxy works on TCP streams, not on IP packets, so the bytes can not be really lost or reordered. What the application
+    sees instead is what TCP makes of it: the lost segment arrives after retransmission and the segments following a lost or
+    reordered one are held back until it arrives. Random numbers come from a seeded generator so the same seed gives the same
+    sequence of impairments.
+
+*/
+
+
+#pragma once
+#ifndef __NETWORK_IMPAIRMENT_PROXY__
+    #define __NETWORK_IMPAIRMENT_PROXY__
+
+
+    #include <WiFi.h>
+    #include "tcpServer.h"
+    #include "tcpClient.h"
+
+
+    // TUNING PARAMETERS
+
+    #ifndef NETWORK_IMPAIRMENT_SEGMENT_SIZE
+        #define NETWORK_IMPAIRMENT_SEGMENT_SIZE 536     // 536 bytes, TCP's default MSS
+    #endif
+    #ifndef NETWORK_IMPAIRMENT_QUEUE_LENGTH
+        #define NETWORK_IMPAIRMENT_QUEUE_LENGTH 8       // max number of segments on the way in each direction, the proxy stops reading when the queue is full
+    #endif
+    #ifndef NETWORK_IMPAIRMENT_STACK_SIZE
+        #define NETWORK_IMPAIRMENT_STACK_SIZE (3 * 1024)
+    #endif
+    #ifndef NETWORK_IMPAIRMENT_TIME_OUT
+        #define NETWORK_IMPAIRMENT_TIME_OUT 60          // 60 s, sessions idle for longer are closed
+    #endif
+
+
+    // link properties in one direction, all 0 means no impairment
+    struct linkImpairment_t {
+        unsigned long latency = 0;                  // ms, one-way delay
+        unsigned long jitter = 0;                   // ms, random 0 ... jitter added to latency
+        unsigned long bandwidth = 0;                // bytes per second, 0 = unlimited
+        float loss = 0;                             // probability (0 ... 1) that a segment is lost and retransmitted
+        float reorder = 0;                          // probability (0 ... 1) that a segment arrives late
+        unsigned long retransmissionTimeOut = 200;  // ms, delay of a lost segment
+        unsigned long reorderDelay = 20;            // ms, delay of a reordered segment
+    };
+
+
+    class networkImpairmentProxy_t : public tcpServer_t {
+
+        public:
+
+            networkImpairmentProxy_t (int proxyPort,
+                                      const char *targetHost,
+                                      int targetPort,
+                                      const linkImpairment_t& upstream = {},
+                                      const linkImpairment_t& downstream = {},
+                                      uint32_t seed = 1);
+
+            ~networkImpairmentProxy_t ();
+
+            // new impairment applies to sessions that start afterwards
+            void setImpairment (const linkImpairment_t& upstream, const linkImpairment_t& downstream);
+
+            // statistics of finished sessions
+            inline unsigned long getSegments () __attribute__((always_inline)) { return __segments__; }
+            inline unsigned long getLost () __attribute__((always_inline)) { return __lost__; }
+            inline unsigned long getReordered () __attribute__((always_inline)) { return __reordered__; }
+            inline int getRunningSessions () __attribute__((always_inline)) { return __runningSessions__; }
+
+            // accept any connection, the session starts in __createConnectionInstance__
+            inline tcpConnection_t *accept () __attribute__((always_inline)) { return tcpServer_t::accept (); }
+
+        private:
+
+            Cstring<255> __targetHost__;
+            int __targetPort__;
+
+            portMUX_TYPE __spinlock__ = portMUX_INITIALIZER_UNLOCKED; // guards everything below
+            linkImpairment_t __upstream__;
+            linkImpairment_t __downstream__;
+            uint32_t __seed__;
+            unsigned long __segments__ = 0;
+            unsigned long __lost__ = 0;
+            unsigned long __reordered__ = 0;
+            int __runningSessions__ = 0;
+            bool __stopping__ = false;
+
+            struct __segment__ {
+                unsigned long deliverAt;
+                uint16_t length;
+                char data [NETWORK_IMPAIRMENT_SEGMENT_SIZE];
+            };
+
+            // one direction of a session
+            struct __direction__ {
+                tcpConnection_t *from;
+                tcpConnection_t *to;
+                linkImpairment_t impairment;
+                __segment__ queue [NETWORK_IMPAIRMENT_QUEUE_LENGTH];
+                int head = 0;
+                int count = 0;
+                unsigned long linkFreeAt = 0;       // when the link finishes transmitting the last segment
+                unsigned long lastDeliverAt = 0;    // segments are delivered in order
+                bool fromClosed = false;
+            };
+
+            struct __session__ {
+                networkImpairmentProxy_t *proxy;
+                tcpConnection_t *client;
+                uint32_t random;
+                unsigned long segments = 0;
+                unsigned long lost = 0;
+                unsigned long reordered = 0;
+                __direction__ upstream;
+                __direction__ downstream;
+            };
+
+            tcpConnection_t *__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) override;
+
+            static void __runSession__ (__session__ *session);
+
+            // reads a segment and schedules its delivery, returns false if the connection is closed
+            static bool __read__ (__session__ *session, __direction__& direction);
+
+            // sends the segments that are due, returns false in case of error
+            static bool __deliver__ (__direction__& direction);
+
+            // xorshift32 pseudo random number generator, returns a number in [0, 1)
+            static float __random__ (uint32_t& state);
+    };
+
+#endif
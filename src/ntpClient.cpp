@@ -14,10 +14,10 @@
 
 
 #include <WiFi.h>
-#include <fcntl.h>
 #include <errno.h>
 #include <sys/time.h>
 #include "ntpClient.h"
+#include "udpSocket.h"
 #include <dmesg.hpp>
 #include <ostream.hpp>
 
@@ -98,217 +98,67 @@ const char *ntpClient_t::syncTime (const char *ntpServerName) {
 
     // »Setup our Socket and Server Data Structure«
 
-    // Create a UDP socket, convert the host-name to an IP address, set the port number,
-    // connect to the server, send the packet, and then read in the return packet.
+    // Convert the host-name to an IP address, create a UDP socket, send the packet,
+    // and then read in the return packet.
 
-    struct addrinfo hints, *res, *p;
-    char ipstr [INET6_ADDRSTRLEN];
+    struct addrinfo hints, *res;
     memset (&hints, 0, sizeof (hints));
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_DGRAM;
 
     xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-    int status = getaddrinfo (ntpServerName, NULL, &hints, &res);
+        int status = getaddrinfo (ntpServerName, NULL, &hints, &res);
     xSemaphoreGive (getLwIpMutex ());
 
     if (status != 0)
         return gai_strerror (status);
 
-    // IP addresses for serverName
-    bool isIPv6 = false;
-    for (p = res; p != NULL; p = p->ai_next) {
-        void *addr;
-        if (p->ai_family == AF_INET) {
-            isIPv6 = false;
-            struct sockaddr_in *ipv4 = (struct sockaddr_in *) p->ai_addr;
-            addr = & (ipv4->sin_addr);
-        } else {
-            isIPv6 = true;
-            struct sockaddr_in6 *ipv6 = (struct sockaddr_in6 *) p->ai_addr;
-            addr = & (ipv6->sin6_addr);
-        }
-        inet_ntop (p->ai_family, addr, ipstr, sizeof (ipstr));
-        break;
-    }
+    // take the first IP address of serverName
+    ipAddress_t serverAddress (res->ai_addr);
 
     xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-    freeaddrinfo (res);
+        freeaddrinfo (res);
+    xSemaphoreGive (getLwIpMutex ());
 
-    int sockfd;
-    if (isIPv6)
-        sockfd = socket (AF_INET6, SOCK_DGRAM, IPPROTO_IPV6);
-    else
-        sockfd = socket (PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    // »Before we can start communicating we have to setup our socket, server and server address structures. We will be using the
+    //  User Datagram Protocol (versus TCP) for our socket since the server we are sending our message to is listening on port
+    //  number 123 using UDP.«
 
-    if (sockfd < 0) {
-        cout << ( dmesgQueue << "[NTP] socket error: " << errno << " " << strerror (errno) ) << endl;
-        xSemaphoreGive (getLwIpMutex ());
+    udpSocket_t udpSocket; // dual-stack socket, bound to any free port
+    if (!udpSocket)
         return "socket error";
-    }
 
-    // Setup socket timeout to 1s, but this won't limit the time we wait for NTP reply since th socket will be non-blocking
-    struct timeval tout = {1, 0};
-    setsockopt (sockfd, SOL_SOCKET, SO_RCVTIMEO, &tout, sizeof (tout));
+    // »Send our Message to the Server«
 
-    if (fcntl (sockfd, F_SETFL, O_NONBLOCK) == -1) {
-        cout << ( dmesgQueue << "[NTP] fcntl error: " << errno << " " << strerror (errno) ) << endl;
-        close (sockfd);
-        xSemaphoreGive (getLwIpMutex ());
-        return "fcntl error";
-    }
+    // »With our message payload, socket, server and address setup, we can now send our message to the server.
+    //  To do this, we write our 48 byte struct to the socket.«
+
+    if (udpSocket.sendTo (&packet, sizeof (ntp_packet), serverAddress, 123) < 0)
+        return "sendto error";
+
+    // »Read in the Return Message«
+
+    // Wait (until the socket is readable, for 1 s at most) and receive the packet back from the server.
 
-    // connect to the server
-    if (isIPv6) {
-        struct sockaddr_in6 serv_addr = {};  // zero out the server address structure.
-        serv_addr.sin6_family = AF_INET6;
-        serv_addr.sin6_port = htons (123);  // convert the port number integer to network big-endian style and save it to the server address structure.
-        if (inet_pton (AF_INET6, ipstr, &serv_addr.sin6_addr) <= 0) {
-            cout << ( dmesgQueue << "[NTP] invalid or not supported address " << ipstr ) << endl;
-            close (sockfd);
-            xSemaphoreGive (getLwIpMutex ());
-            return "invalid or not supported address";
-        }
-
-        // »Before we can start communicating we have to setup our socket, server and server address structures. We will be using the
-        //  User Datagram Protocol (versus TCP) for our socket since the server we are sending our message to is listening on port
-        //  number 123 using UDP.«
-
-        // Call up the server using its IP address and port number.
-        if (connect (sockfd, (struct sockaddr *) &serv_addr, sizeof (serv_addr)) < 0) {
-            cout << ( dmesgQueue << "[NTP] connect error: " << errno << " " << strerror (errno) ) << endl;
-            close (sockfd);
-            xSemaphoreGive (getLwIpMutex ());
-            return "connect error";
-        }
-
-        // »Send our Message to the Server«
-
-        // Send the NTP packet
-        int n;
-        n = sendto (sockfd, (char *)&packet, sizeof(ntp_packet), 0, (struct sockaddr *)&serv_addr, sizeof (serv_addr));
-        if (n < 0) {
-            cout << ( dmesgQueue << "[NTP] sendto error: " << errno << " " << strerror (errno) ) << endl;
-            close (sockfd);
-            xSemaphoreGive (getLwIpMutex ());
-            return "sendto error";
-        }
-
-        xSemaphoreGive (getLwIpMutex ());
-
-        // »With our message payload, socket, server and address setup, we can now send our message to the server.
-        //  To do this, we write our 48 byte struct to the socket.«
-
-        // »Read in the Return Message«
-
-        // Wait and receive the packet back from the server. If n == -1, it failed.
-
-        struct sockaddr_in6 from;
-        socklen_t fromlen = sizeof (from);
-        unsigned long startMillis = millis();
-        while (true) {
-            delay (25);
-            if (millis() - startMillis > 1000) {
-                xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-                close (sockfd);
-                xSemaphoreGive (getLwIpMutex ());
-                return "time-out";
-            }
-            xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-            n = recvfrom (sockfd, (char *) &packet, sizeof (ntp_packet), 0, (struct sockaddr *) &from, (socklen_t *) &fromlen);
-            xSemaphoreGive (getLwIpMutex ());
-            if (n < 0) {
-                if (errno == 11)  // EWOULDBLOCK || EAGAIN
-                    continue;
-                cout << ( dmesgQueue << "[NTP] recvfrom error: " << errno << " " << strerror (errno) ) << endl;
-                xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-                close (sockfd);
-                xSemaphoreGive (getLwIpMutex ());
-                return "recvfrom error";
-            }
-            // Did we get the reply from the expected server?
-            if (memcmp (&from.sin6_addr, &serv_addr.sin6_addr, sizeof (struct in6_addr)) == 0 && from.sin6_port == serv_addr.sin6_port)
-                break;
-        }
-
-    } else { // IPv4
-
-        struct sockaddr_in serv_addr = {};  // zero out the server address structure.
-        serv_addr.sin_family = AF_INET;
-        serv_addr.sin_port = htons (123);  // convert the port number integer to network big-endian style and save it to the server address structure.
-        if (inet_pton (AF_INET, ipstr, &serv_addr.sin_addr) <= 0) {
-            cout << ( dmesgQueue << "[NTP] invalid or not supported address " << ipstr ) << endl;
-            close (sockfd);
-            xSemaphoreGive (getLwIpMutex ());
-            return "invalid or not supported address";
-        }
-
-        // »Before we can start communicating we have to setup our socket, server and server address structures. We will be using the
-        //  User Datagram Protocol (versus TCP) for our socket since the server we are sending our message to is listening on port
-        //  number 123 using UDP.«
-
-        // Call up the server using its IP address and port number.
-        if (connect (sockfd, (struct sockaddr *) &serv_addr, sizeof (serv_addr)) < 0) {
-            cout << ( dmesgQueue << "[NTP] connect error: " << errno << " " << strerror (errno) ) << endl;
-            close (sockfd);
-            xSemaphoreGive (getLwIpMutex ());
-            return "connect error";
-        }
-
-        // »Send our Message to the Server«
-
-        // Send it the NTP packet it wants. If n == -1, it failed.
-        int n;
-        n = sendto (sockfd, (char *) &packet, sizeof (ntp_packet), 0, (struct sockaddr *) &serv_addr, sizeof (serv_addr));
-        if (n < 0) {
-            cout << ( dmesgQueue << "[NTP] sendto error: " << errno << " " << strerror (errno) ) << endl;
-            close (sockfd);
-            xSemaphoreGive (getLwIpMutex ());
-            return "sendto error";
-        }
-
-        xSemaphoreGive (getLwIpMutex ());
-
-        // »With our message payload, socket, server and address setup, we can now send our message to the server.
-        //  To do this, we write our 48 byte struct to the socket.«
-
-        // »Read in the Return Message«
-
-        // Wait and receive the packet back from the server. If n == -1, it failed.
-
-        struct sockaddr_in from;
-        socklen_t fromlen = sizeof (from);
-        unsigned long startMillis = millis ();
-        while (true) {
-            delay(25);
-            if (millis () - startMillis > 1000) {
-                xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-                close (sockfd);
-                xSemaphoreGive (getLwIpMutex ());
-                return "time-out";
-            }
-            xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-            n = recvfrom (sockfd, (char *) &packet, sizeof (ntp_packet), 0, (struct sockaddr *) &from, (socklen_t *) &fromlen);
-            xSemaphoreGive (getLwIpMutex ());
-            if (n < 0) {
-                if (errno == 11)  // EWOULDBLOCK || EAGAIN
-                    continue;
-                cout << ( dmesgQueue << "[NTP] recvfrom error: " << errno << " " << strerror (errno) ) << endl;
-            xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-            close (sockfd);
-            xSemaphoreGive (getLwIpMutex ());
+    unsigned long startMillis = millis ();
+    while (true) {
+        unsigned long elapsed = millis () - startMillis;
+        if (elapsed >= 1000)
+            return "time-out";
+
+        ipAddress_t fromAddress;
+        int fromPort;
+        int received = udpSocket.recvFrom (&packet, sizeof (ntp_packet), fromAddress, fromPort, 1000 - elapsed);
+        if (received == udpSocket_t::UDP_TIME_OUT)
+            return "time-out";
+        if (received < 0)
             return "recvfrom error";
-            }
-            // Did we get the reply from the expected server?
-            if (from.sin_addr.s_addr == serv_addr.sin_addr.s_addr && from.sin_port == serv_addr.sin_port)
+
+        // Did we get the (whole) reply from the expected server?
+        if (fromAddress == serverAddress && fromPort == 123 && received == (int) sizeof (ntp_packet))
             break;
-        }
     }
 
-    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-    close (sockfd);
-    xSemaphoreGive (getLwIpMutex ());
-
-
     // »Now that our message is sent, we block or wait for the response by reading from the socket. The message we get back should be the same
     //  size as the message we sent. We will store the incoming message in packet just like we stored our outgoing message.«
 
@@ -329,7 +179,7 @@ const char *ntpClient_t::syncTime (const char *ntpServerName) {
 
     __startUpTime__ += (time_t) (packet.txTm_s - NTP_TIMESTAMP_DELTA) - oldTime; // += newTime - oldTime
     
-    cout << ( dmesgQueue << "[NTP] time synchronized with " << ntpServerName << " (" << ipstr << ")" ) << endl;
+    cout << ( dmesgQueue << "[NTP] time synchronized with " << ntpServerName << " (" << serverAddress.toString () << ")" ) << endl;
     return "";
 }
 
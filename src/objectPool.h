@@ -0,0 +1,134 @@
+/*
+
+    objectPool.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 22, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        objectPool_t
+
+    objectPool_t is a slab of equally sized blocks allocated in one piece when the server starts, so that creating and
+    deleting connection objects does not fragment the heap over days of uptime. Classes use it through their own operator
+    new and operator delete, so the code that creates and deletes the objects stays the same:
+
+        static void *operator new (size_t size, const std::nothrow_t&) noexcept { return __pool__.allocate (size); }
+        static void operator delete (void *p) { __pool__.free (p); }
+
+    When the pool is exhausted (or not started yet, or the object is larger than the block) the object is allocated on the
+    heap as before and the fallback is counted, so the statistics tell if the pool is too small.
+
+*/
+
+
+#pragma once
+#ifndef __OBJECT_POOL__
+    #define __OBJECT_POOL__
+
+
+    #include <WiFi.h>
+    #include <esp_heap_caps.h>
+    #include <dmesg.hpp>
+    #include <ostream.hpp>
+
+
+    // TUNING PARAMETERS
+
+    #ifndef CONNECTION_POOLS_IN_PSRAM
+        #define CONNECTION_POOLS_IN_PSRAM 0             // set to 1 to put servers' connection pools in PSRAM (if the board has it), this leaves more internal RAM for lwIP and stacks
+    #endif
+
+
+    class objectPool_t {
+
+        public:
+
+            // preallocates count blocks of blockSize bytes, in PSRAM if asked for and available, only the first call does anything
+            bool begin (size_t blockSize, int count, bool psram = false) {
+                if (__slab__ || count <= 0)
+                    return __slab__ != NULL;
+
+                __blockSize__ = (blockSize + 7) & ~7; // keep the blocks aligned
+                void *slab = NULL;
+                if (psram)
+                    __inPsram__ = (slab = heap_caps_malloc (__blockSize__ * count, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)) != NULL;
+                if (!slab)
+                    slab = heap_caps_malloc (__blockSize__ * count, MALLOC_CAP_8BIT);
+                if (!slab) {
+                    cout << ( dmesgQueue << "[objectPool] " << "can't allocate " << (unsigned long) (__blockSize__ * count) << " bytes" );
+                    return false;
+                }
+
+                // link all the blocks into the free list
+                taskENTER_CRITICAL (&__spinlock__);
+                    for (int i = count - 1; i >= 0; i--) {
+                        void **block = (void **) ((char *) slab + i * __blockSize__);
+                        *block = __freeList__;
+                        __freeList__ = block;
+                    }
+                    __capacity__ = count;
+                    __slab__ = (char *) slab;
+                taskEXIT_CRITICAL (&__spinlock__);
+                return true;
+            }
+
+            // returns a block from the pool or from the heap, NULL if there is no memory
+            void *allocate (size_t size) {
+                void *p = NULL;
+                taskENTER_CRITICAL (&__spinlock__);
+                    if (__freeList__ && size <= __blockSize__) {
+                        p = __freeList__;
+                        __freeList__ = *(void **) p;
+                        if (++ __used__ > __peak__)
+                            __peak__ = __used__;
+                    } else {
+                        __heapFallbacks__ ++;
+                    }
+                taskEXIT_CRITICAL (&__spinlock__);
+                return p ? p : malloc (size);
+            }
+
+            void free (void *p) {
+                if (!p)
+                    return;
+                if (!__contains__ (p)) {
+                    ::free (p);
+                    return;
+                }
+                taskENTER_CRITICAL (&__spinlock__);
+                    *(void **) p = __freeList__;
+                    __freeList__ = p;
+                    __used__ --;
+                taskEXIT_CRITICAL (&__spinlock__);
+            }
+
+            // statistics
+            inline int getCapacity () __attribute__((always_inline)) { return __capacity__; }
+            inline int getUsed () __attribute__((always_inline)) { return __used__; }
+            inline int getPeak () __attribute__((always_inline)) { return __peak__; }
+            inline unsigned long getHeapFallbacks () __attribute__((always_inline)) { return __heapFallbacks__; }
+            inline size_t getBlockSize () __attribute__((always_inline)) { return __blockSize__; }
+            inline bool isInPsram () __attribute__((always_inline)) { return __inPsram__; }
+
+        private:
+
+            portMUX_TYPE __spinlock__ = portMUX_INITIALIZER_UNLOCKED;
+
+            char *__slab__ = NULL;
+            size_t __blockSize__ = 0;
+            bool __inPsram__ = false;
+            void *__freeList__ = NULL;
+
+            int __capacity__ = 0;
+            int __used__ = 0;
+            int __peak__ = 0;
+            unsigned long __heapFallbacks__ = 0;
+
+            inline bool __contains__ (void *p) __attribute__((always_inline)) { return __slab__ && (char *) p >= __slab__ && (char *) p < __slab__ + __capacity__ * __blockSize__; }
+    };
+
+#endif
@@ -0,0 +1,104 @@
+/*
+
+    socketOptions.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 6, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        socketOptions_t
+
+    socketOptions_t is a profile of socket options that servers apply to accepted connections and clients to their connections.
+    These profiles are predefined:
+
+        interactive - Nagle's algorithm off, so short replies (Telnet echo, FTP replies) leave immediately
+        bulk        - Nagle's algorithm on (full segments only) and bigger buffers (FTP data connections)
+        bulkNoDelay - bigger buffers with Nagle's algorithm off, for bulk connections that stay open after the end of
+                      each transfer and so can't rely on close to push the last partial segment out (FTP MODE B)
+
+    Lingering close (linger > 0) is possible but should be used with care: connections are closed while holding LwIpMutex,
+    so all the other network tasks would wait as well.
+
+    lwIP only supports some of these options, depending on how it was built: SO_RCVBUF needs LWIP_SO_RCVBUF, SO_LINGER needs
+    LWIP_SO_LINGER and SO_SNDBUF is not supported at all (lwIP sends from TCP_SND_BUF that is set at compile time, the same
+    goes for TCP window). Options that are not supported are silently skipped.
+
+*/
+
+
+#pragma once
+#ifndef __SOCKET_OPTIONS__
+    #define __SOCKET_OPTIONS__
+
+
+    #include <WiFi.h>
+    #include <lwip/sockets.h>
+    #include <errno.h>
+    #include <dmesg.hpp>
+    #include <ostream.hpp>
+
+
+    // TUNING PARAMETERS
+
+    #ifndef TCP_BULK_BUFFER_SIZE
+        #define TCP_BULK_BUFFER_SIZE (8 * 1440)         // send and receive buffer size for bulk profile, where lwIP supports it
+    #endif
+
+
+    struct socketOptions_t {
+
+        int sendBufferSize = 0;         // SO_SNDBUF, 0 = leave the default
+        int receiveBufferSize = 0;      // SO_RCVBUF, 0 = leave the default
+        int noDelay = -1;               // TCP_NODELAY, -1 = leave the default, 0 = Nagle's algorithm on, 1 = Nagle's algorithm off
+        int linger = -1;                // SO_LINGER, -1 = leave the default (close returns immediately and the data is sent in the background),
+                                        //             0 = abortive close (RST, unsent data is discarded), > 0 = close waits up to linger seconds for the data to be sent
+
+        // predefined profiles
+        static const socketOptions_t& interactive () {
+            static const socketOptions_t profile = { 0, 0, 1, -1 };
+            return profile;
+        }
+
+        static const socketOptions_t& bulk () {
+            static const socketOptions_t profile = { TCP_BULK_BUFFER_SIZE, TCP_BULK_BUFFER_SIZE, 0, -1 };
+            return profile;
+        }
+
+        static const socketOptions_t& bulkNoDelay () {
+            static const socketOptions_t profile = { TCP_BULK_BUFFER_SIZE, TCP_BULK_BUFFER_SIZE, 1, -1 };
+            return profile;
+        }
+
+        // sets the options on the socket, the caller should already hold LwIpMutex, returns false if any supported option failed
+        bool apply (int sockfd) const {
+            bool success = true;
+            if (sendBufferSize > 0)
+                success &= __setOption__ (sockfd, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof (sendBufferSize), "SO_SNDBUF");
+            if (receiveBufferSize > 0)
+                success &= __setOption__ (sockfd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof (receiveBufferSize), "SO_RCVBUF");
+            if (noDelay >= 0)
+                success &= __setOption__ (sockfd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof (noDelay), "TCP_NODELAY");
+            if (linger >= 0) {
+                struct linger l = { 1, linger };
+                success &= __setOption__ (sockfd, SOL_SOCKET, SO_LINGER, &l, sizeof (l), "SO_LINGER");
+            }
+            return success;
+        }
+
+        private:
+
+            static bool __setOption__ (int sockfd, int level, int optionName, const void *value, socklen_t length, const char *optionText) {
+                if (setsockopt (sockfd, level, optionName, value, length) == 0)
+                    return true;
+                if (errno == ENOPROTOOPT) // not supported by this lwIP build
+                    return true;
+                cout << ( dmesgQueue << "[socketOptions] " << optionText << " error: " << errno << " " << strerror (errno) );
+                return false;
+            }
+    };
+
+#endif
@@ -57,7 +57,7 @@
 #include <ostream.hpp>
 
 
-tcpClient_t::tcpClient_t (const char *serverName, int serverPort) : tcpConnection_t () {
+tcpClient_t::tcpClient_t (const char *serverName, int serverPort, int keepAliveIdleSeconds) : tcpConnection_t () {
     __errText__ = NULL;
 
     if (!WiFi.isConnected () || WiFi.localIP () == IPAddress (0, 0, 0, 0)) { // esp32 can crash without this check
@@ -81,22 +81,22 @@ tcpClient_t::tcpClient_t (const char *serverName, int serverPort) : tcpConnectio
       return;
     }
 
-    // get IP addresses for serverName
+    // take the first address of serverName
+    struct sockaddr_storage serverAddress = {};
+    socklen_t serverAddressSize = 0;
     bool isIPv6 = false;
     for (p = res; p != NULL; p = p->ai_next) {
-        void *addr;
-        if (p->ai_family == AF_INET) {
-            isIPv6 = false;
-            struct sockaddr_in *ipv4 = (struct sockaddr_in *) p->ai_addr;
-            addr = &(ipv4->sin_addr);
-        } else {
-            isIPv6 = true;
-            struct sockaddr_in6 *ipv6 = (struct sockaddr_in6 *) p->ai_addr;
-            addr = &(ipv6->sin6_addr);
-        }
-        inet_ntop (p->ai_family, addr, __serverIP__, sizeof (__serverIP__));
+        isIPv6 = p->ai_family != AF_INET;
+        serverAddressSize = p->ai_addrlen;
+        memcpy (&serverAddress, p->ai_addr, serverAddressSize);
         break;
     }
+    __serverAddress__ = ipAddress_t ((struct sockaddr *) &serverAddress);
+    if (isIPv6)
+        ((struct sockaddr_in6 *) &serverAddress)->sin6_port = htons (serverPort);
+    else
+        ((struct sockaddr_in *) &serverAddress)->sin_port = htons (serverPort);
+
     xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
       freeaddrinfo (res);
     // xSemaphoreGive (getLwIpMutex ());
@@ -111,22 +111,6 @@ tcpClient_t::tcpClient_t (const char *serverName, int serverPort) : tcpConnectio
         return;
       }
 
-      // get client's IP address
-      struct sockaddr_storage thisAddress = {};
-      socklen_t len = sizeof (thisAddress);
-      if (getsockname (__connectionSocket__, (struct sockaddr *) &thisAddress, &len) != -1) {
-        struct sockaddr_in6 *s = (struct sockaddr_in6 *) &thisAddress;
-        inet_ntop (AF_INET6, &s->sin6_addr, __clientIP__, sizeof (__clientIP__));
-        if (!isIPv6) {
-          char *p = __clientIP__;
-          for (char *q = p; *q; q++)
-            if (*q == ':')
-              p = q;
-          if (p != __clientIP__)
-            strcpy (__clientIP__, p + 1);
-        }
-      }
-
       // make connection socket non-blocking
       if (fcntl (__connectionSocket__, F_SETFL, O_NONBLOCK) < 0) {
         __errText__ = strerror (errno);
@@ -136,49 +120,19 @@ tcpClient_t::tcpClient_t (const char *serverName, int serverPort) : tcpConnectio
       }
 
       // connect to the server
-      if (isIPv6) {
-
-        struct sockaddr_in6 server_addr = {};
-        server_addr.sin6_family = AF_INET6;
-        server_addr.sin6_len = sizeof(server_addr);
-
-        if (inet_pton (AF_INET6, __serverIP__, &server_addr.sin6_addr) <= 0) {
-          __errText__ = "invalid network address";
-          cout << ( dmesgQueue << "[tcpClient] " << __errText__ << " " << __serverIP__ );
-        } else {
-          server_addr.sin6_port = htons (serverPort);
-          if (connect (__connectionSocket__, (struct sockaddr *) &server_addr, sizeof (server_addr)) < 0) {
-            if (errno != EINPROGRESS) {
-              __errText__ = strerror (errno);
-              cout << ( dmesgQueue << "[tcpClient] " << __errText__ );
-              ::close (__connectionSocket__);
-              __connectionSocket__ = -1;
-            }
-          } // if connect == 0 or errno == EINPROGRESS everithing is fine so far
-        } 
-
-      } else {
-
-        struct sockaddr_in server_addr = {};
-        server_addr.sin_family = AF_INET;
-        server_addr.sin_len = sizeof (server_addr);
-
-        if (inet_pton (AF_INET, __serverIP__, &server_addr.sin_addr) <= 0) {
-          __errText__ = "invalid network address";
-          cout << ( dmesgQueue << "[tcpClient] " << __errText__ << " " << __serverIP__ );
-        } else {
-          server_addr.sin_port = htons (serverPort);
-          if (connect (__connectionSocket__, (struct sockaddr *) &server_addr, sizeof (server_addr)) < 0) {
-            if (errno != EINPROGRESS) {
-              __errText__ = strerror (errno);
-              cout << ( dmesgQueue << "[tcpClient] " << __errText__ );
-              ::close (__connectionSocket__);
-              __connectionSocket__ = -1;
-            }
-          } // if connect == 0 or errno == EINPROGRESS everithing is fine so far
-        } 
-      
-      }
+      if (serverAddressSize == 0) {
+        __errText__ = "invalid network address";
+        cout << ( dmesgQueue << "[tcpClient] " << __errText__ << " " << serverName );
+        ::close (__connectionSocket__);
+        __connectionSocket__ = -1;
+      } else if (connect (__connectionSocket__, (struct sockaddr *) &serverAddress, serverAddressSize) < 0) {
+        if (errno != EINPROGRESS) {
+          __errText__ = strerror (errno);
+          cout << ( dmesgQueue << "[tcpClient] " << __errText__ );
+          ::close (__connectionSocket__);
+          __connectionSocket__ = -1;
+        }
+      } // if connect == 0 or errno == EINPROGRESS everithing is fine so far
 
     xSemaphoreGive (getLwIpMutex ());
 
@@ -246,9 +200,18 @@ tcpClient_t::tcpClient_t (const char *serverName, int serverPort) : tcpConnectio
   // set socket time-out (without error checking, this is just a back-up option)
   xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
     // set socket time-out (without error checking, this is just a back-up option)
-    struct timeval tv = { SOCKET_TIMEOUT, 0 };
+    struct timeval tv = { socketTimeOut, 0 };
     setsockopt (__connectionSocket__, SOL_SOCKET, SO_RCVTIMEO, (const char *) &tv, sizeof (tv));
     setsockopt (__connectionSocket__, SOL_SOCKET, SO_SNDTIMEO, (const char *) &tv, sizeof (tv));
+    // detect dead peers
+    if (keepAliveIdleSeconds)
+      setSocketKeepAlive (__connectionSocket__, keepAliveIdleSeconds, TCP_KEEPALIVE_INTERVAL, TCP_KEEPALIVE_COUNT);
+    // get client's address, it is known only after the connection is established
+    struct sockaddr_storage thisAddress = {};
+    socklen_t len = sizeof (thisAddress);
+    if (getsockname (__connectionSocket__, (struct sockaddr *) &thisAddress, &len) != -1)
+      __clientAddress__ = ipAddress_t ((struct sockaddr *) &thisAddress);
+    __registerSocket__ (__serverAddress__);
   xSemaphoreGive (getLwIpMutex ());
 
   networkTraffic () [__connectionSocket__] = {0, 0};
@@ -61,10 +61,6 @@
 
   // TUNING PARAMETERS
 
-  #ifndef SOCKET_TIMEOUT
-    #define SOCKET_TIMEOUT (1)
-  #endif
-
   #ifndef CONNECT_TIMEOUT
     #define CONNECT_TIMEOUT (10)
   #endif
@@ -72,11 +68,12 @@
 
   class tcpClient_t : public tcpConnection_t {
 
-    private:
+    protected:
       const char *__errText__;
 
   public:
-      tcpClient_t (const char *serverName, int serverPort);
+      // TCP keep-alive is turned on with TCP_KEEPALIVE_INTERVAL and TCP_KEEPALIVE_COUNT unless keepAliveIdleSeconds = 0, the same as for the connections accepted by the servers
+      tcpClient_t (const char *serverName, int serverPort, int keepAliveIdleSeconds = TCP_KEEPALIVE_IDLE);
 
       // error reporting
       inline operator bool () __attribute__((always_inline)) { return __errText__ != NULL; }
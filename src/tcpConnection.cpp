@@ -59,11 +59,33 @@
 #include <ostream.hpp>
 
 
+// run time values of tuning parameters
+tunable_t socketTimeOut ("SOCKET_TIMEOUT", SOCKET_TIMEOUT, 1, 60, "s");
+
+
+bool setSocketKeepAlive (int sockfd, int idleSeconds, int intervalSeconds, int count) {
+    int keepAlive = idleSeconds > 0;
+    if (setsockopt (sockfd, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof (keepAlive)) == -1) {
+        cout << ( dmesgQueue << "[tcpConn] " << "setsockopt error: " << errno << " " << strerror (errno) );
+        return false;
+    }
+    if (keepAlive) {
+        #if defined (TCP_KEEPIDLE) && defined (TCP_KEEPINTVL) && defined (TCP_KEEPCNT) // lwIP built with LWIP_TCP_KEEPALIVE, otherwise its defaults (2 hours idle) apply
+            if (setsockopt (sockfd, IPPROTO_TCP, TCP_KEEPIDLE, &idleSeconds, sizeof (idleSeconds)) == -1 ||
+                setsockopt (sockfd, IPPROTO_TCP, TCP_KEEPINTVL, &intervalSeconds, sizeof (intervalSeconds)) == -1 ||
+                setsockopt (sockfd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof (count)) == -1) {
+                    cout << ( dmesgQueue << "[tcpConn] " << "setsockopt error: " << errno << " " << strerror (errno) );
+                    return false;
+            }
+        #endif
+    }
+    return true;
+}
+
+
 tcpConnection_t::tcpConnection_t () {}
-tcpConnection_t::tcpConnection_t (int connectionSocket, char *clientIP, char *serverIP) {
+tcpConnection_t::tcpConnection_t (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) : __clientAddress__ (clientAddress), __serverAddress__ (serverAddress) {
     __connectionSocket__ = connectionSocket;
-    strncpy (__clientIP__, clientIP, sizeof (__clientIP__) - 1);
-    strncpy (__serverIP__, serverIP, sizeof (__serverIP__) - 1);
     networkTraffic () [__connectionSocket__] = {0, 0};
 
     // make connection socket non-blocking
@@ -72,20 +94,54 @@ tcpConnection_t::tcpConnection_t (int connectionSocket, char *clientIP, char *se
             cout << ( dmesgQueue << "[tcpConn] " << "error: " << errno << " " << strerror (errno) );
             xSemaphoreGive (getLwIpMutex ());
             close ();
+            return;
         }
+        __registerSocket__ (__clientAddress__);
+    xSemaphoreGive (getLwIpMutex ());
+}
+
+tcpConnection_t::~tcpConnection_t () {
+    close ();
+    if (__serverBandwidthLimit__)
+        __serverBandwidthLimit__->release ();
+}
+
+// server's address of accepted connection is only obtained from the socket if somebody asks for it
+const ipAddress_t& tcpConnection_t::getServerAddress () {
+    if (__serverAddress__.isUnspecified () && __connectionSocket__ != -1) {
+        struct sockaddr_storage thisAddress = {};
+        socklen_t len = sizeof (thisAddress);
+        xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+            int ret = getsockname (__connectionSocket__, (struct sockaddr *) &thisAddress, &len);
+        xSemaphoreGive (getLwIpMutex ());
+        if (ret != -1)
+            __serverAddress__ = ipAddress_t ((struct sockaddr *) &thisAddress);
+    }
+    return __serverAddress__;
+}
+
+bool tcpConnection_t::setKeepAlive (int idleSeconds, int intervalSeconds, int count) {
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        bool success = __connectionSocket__ != -1 && setSocketKeepAlive (__connectionSocket__, idleSeconds, intervalSeconds, count);
     xSemaphoreGive (getLwIpMutex ());
+    return success;
 }
 
-tcpConnection_t::~tcpConnection_t () { close (); }
+bool tcpConnection_t::setSocketOptions (const socketOptions_t& socketOptions) {
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        bool success = __connectionSocket__ != -1 && socketOptions.apply (__connectionSocket__);
+    xSemaphoreGive (getLwIpMutex ());
+    return success;
+}
 
 // recv with traffic reccording
 int tcpConnection_t::recv (void *buf, size_t len) {
     int received = -1;
 
     while (received < 0) { // read blocks of incoming data
-        xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-            received = ::recv (__connectionSocket__, (char *) buf, len, 0);
-        xSemaphoreGive (getLwIpMutex ());
+        if (!__waitForBandwidth__ (false))
+            return -1;
+        received = __recv__ (buf, len, 0);
 
         if (received <= 0)
             switch (errno) {
@@ -103,6 +159,11 @@ int tcpConnection_t::recv (void *buf, size_t len) {
                 case   0:   // connection closed by peer
                             cout << ( dmesgQueue << "[tcpConn] " << "connection closed by peer" );
                             return 0;
+                case 104:   // ECONNRESET
+                case 113:   // ECONNABORTED (also when keep-alive probes were not answered)
+                case 116:   // ETIMEDOUT
+                            __connectionLost__ (errno);
+                            return -1;
                 case 128:   // ENOTSOCK (or the client closed the connection), don't log
                             return -1;
                 default:
@@ -112,10 +173,12 @@ int tcpConnection_t::recv (void *buf, size_t len) {
     }
 
     stillActive ();
+    __consumeBandwidth__ (false, received);
     
     // since no semaphore is used here network traffic logging may not be completely accurate in multitaskin environment
     networkTraffic ().bytesReceived += received;
     networkTraffic () [__connectionSocket__].bytesReceived += received;
+    __accountTrafficPeriodically__ ();
 
     return received;
 }
@@ -147,9 +210,9 @@ int tcpConnection_t::recvString (char *buf, size_t len, const char *endingString
     int receivedThisTime;
 
     while (receivedTotal != len - 1) { // read blocks of incoming data
-        xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-            receivedThisTime = ::recv (__connectionSocket__, buf + receivedTotal, len - receivedTotal - 1, 0);
-        xSemaphoreGive (getLwIpMutex ());
+        if (!__waitForBandwidth__ (false))
+            return -1;
+        receivedThisTime = __recv__ (buf + receivedTotal, len - receivedTotal - 1, 0);
         if (receivedThisTime <= 0)
             switch (errno) {
                 case 107:   // ENOTCONN (all the sockets are non-blocking)
@@ -166,6 +229,11 @@ int tcpConnection_t::recvString (char *buf, size_t len, const char *endingString
                 case   0:   // connection closed by peer
                             cout << ( dmesgQueue << "[tcpConn] " << "connection closed by peer" );
                             return 0;
+                case 104:   // ECONNRESET
+                case 113:   // ECONNABORTED (also when keep-alive probes were not answered)
+                case 116:   // ETIMEDOUT
+                            __connectionLost__ (errno);
+                            return -1;
                 case 128:   // ENOTSOCK (or the client closed the connection), don't log
                             return -1;
                 default:
@@ -174,11 +242,13 @@ int tcpConnection_t::recvString (char *buf, size_t len, const char *endingString
             }
 
         stillActive ();
+        __consumeBandwidth__ (false, receivedThisTime);
         receivedTotal += receivedThisTime;
         
         // since no semaphore is used here network traffic logging may not be completely accurate in multitaskin environment
         networkTraffic ().bytesReceived += receivedThisTime;
         networkTraffic () [__connectionSocket__].bytesReceived += receivedThisTime;
+        __accountTrafficPeriodically__ ();
 
         // the following code assumes that the other side sends command or reply (according to the protocol) that ends with endingString
         buf [receivedTotal] = 0;
@@ -195,9 +265,7 @@ int tcpConnection_t::recvString (char *buf, size_t len, const char *endingString
 //           0 if no 
 //          -1 if error occured (including the case if the peer closed the connection)
 int tcpConnection_t::peek (void *buf, size_t len) { 
-    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-        int received = ::recv (__connectionSocket__, (char *) buf, len, MSG_PEEK);
-    xSemaphoreGive (getLwIpMutex ());
+    int received = __recv__ (buf, len, MSG_PEEK);
     if (received <= 0)
         switch (errno) {
             case 107:   // ENOTCONN (all the sockets are non-blocking)
@@ -212,6 +280,11 @@ int tcpConnection_t::peek (void *buf, size_t len) {
             case   0:   // connection closed by peer
                         cout << ( dmesgQueue << "[tcpConn] " << "connection closed by peer" );
                         return -1;
+            case 104:   // ECONNRESET
+            case 113:   // ECONNABORTED (also when keep-alive probes were not answered)
+            case 116:   // ETIMEDOUT
+                        __connectionLost__ (errno);
+                        return -1;
             case 128:   // ENOTSOCK (or the client closed the connection), don't log
                         return -1;
             default:
@@ -233,10 +306,10 @@ int tcpConnection_t::sendBlock (void *buf, size_t len) {
     
     size_t sentTotal = 0;
     while (sentTotal < len) {
+        if (!__waitForBandwidth__ (true))
+            return -1;
         size_t n = min (MAX_BLOCK_SIZE, len - sentTotal);
-        xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-            int sentThisTime = ::send (__connectionSocket__, (char *) buf + sentTotal, n, 0);    
-        xSemaphoreGive (getLwIpMutex ());
+        int sentThisTime = __send__ ((char *) buf + sentTotal, n);
 
         if (sentThisTime <= 0)
             switch (errno) {
@@ -254,6 +327,11 @@ int tcpConnection_t::sendBlock (void *buf, size_t len) {
                 case   0:   // connection closed by peer
                             cout << ( dmesgQueue << "[tcpConn] " << "connection closed by peer" );  
                             return 0;
+                case 104:   // ECONNRESET
+                case 113:   // ECONNABORTED (also when keep-alive probes were not answered)
+                case 116:   // ETIMEDOUT
+                            __connectionLost__ (errno);
+                            return -1;
                 case 128:   // ENOTSOCK (or the client closed the connection), don't log
                             return -1;
                 default:
@@ -262,13 +340,12 @@ int tcpConnection_t::sendBlock (void *buf, size_t len) {
             }
 
         stillActive ();
+        __consumeBandwidth__ (true, sentThisTime);
         sentTotal += sentThisTime;
 
         networkTraffic ().bytesSent += sentThisTime;
         networkTraffic () [__connectionSocket__].bytesSent += sentThisTime;
-
-        if (sentTotal < len) 
-            delay (25);
+        __accountTrafficPeriodically__ ();
     } 
 
     return sentTotal;
@@ -286,9 +363,104 @@ int tcpConnection_t::sendString (const char *buf) {
 void tcpConnection_t::close () {
     xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
         if (__connectionSocket__ != -1) {
+            __accountTraffic__ (); // the rest of it
+            socketRegistry () [__connectionSocket__] = {};
             ::close (__connectionSocket__);
             __connectionSocket__ = -1;
             // networkTraffic () [__connectionSocket__] = {0, 0};            
         }
     xSemaphoreGive (getLwIpMutex ());
 }
+
+
+void tcpConnection_t::__registerSocket__ (const ipAddress_t& remoteAddress) {
+    socketRegistryEntry_t entry = { this, remoteAddress };
+    socketRegistry () [__connectionSocket__] = entry;
+    topTalkers ().connectionEstablished (remoteAddress);
+}
+
+void tcpConnection_t::__accountTraffic__ () {
+    __lastAccountedMillis__ = millis ();
+    if (__connectionSocket__ == -1 || socketRegistry () [__connectionSocket__].connection != this)
+        return;
+    unsigned long bytesReceived = networkTraffic () [__connectionSocket__].bytesReceived;
+    unsigned long bytesSent = networkTraffic () [__connectionSocket__].bytesSent;
+    topTalkers ().traffic (socketRegistry () [__connectionSocket__].remoteAddress, bytesReceived - __accountedBytesReceived__, bytesSent - __accountedBytesSent__);
+    __accountedBytesReceived__ = bytesReceived;
+    __accountedBytesSent__ = bytesSent;
+}
+
+void socketRegistryEntry_t::fillEndpoints (int sockfd) {
+    if (endpointsFilled)
+        return;
+    struct sockaddr_storage addr = {};
+    socklen_t len = sizeof (addr);
+    if (getsockname (sockfd, (struct sockaddr *) &addr, &len) != -1) {
+        localAddress = ipAddress_t ((struct sockaddr *) &addr);
+        localPort = ntohs (((struct sockaddr_in *) &addr)->sin_port); // sin_port and sin6_port are at the same place
+    }
+    addr = {};
+    len = sizeof (addr);
+    if (getpeername (sockfd, (struct sockaddr *) &addr, &len) != -1)
+        remotePort = ntohs (((struct sockaddr_in *) &addr)->sin_port);
+    endpointsFilled = true;
+}
+
+void tcpConnection_t::__connectionLost__ (int err) {
+    // lwIP reports some failures (like unanswered keep-alive probes) as pending socket error, check it for the real reason
+    int soError = 0;
+    socklen_t len = sizeof (soError);
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        if (getsockopt (__connectionSocket__, SOL_SOCKET, SO_ERROR, &soError, &len) == 0 && soError)
+            err = soError;
+    xSemaphoreGive (getLwIpMutex ());
+    cout << ( dmesgQueue << "[tcpConn] " << "connection on socket " << __connectionSocket__ << " lost: " << err << " " << strerror (err) );
+}
+
+bool tcpConnection_t::__waitForBandwidth__ (bool sending) {
+    while (true) {
+        tokenBucket_t& own = sending ? __bandwidthLimit__.send : __bandwidthLimit__.recv;
+        tokenBucket_t& global = sending ? globalBandwidthLimit ().send : globalBandwidthLimit ().recv;
+        unsigned long ms = max (own.waitTime (), global.waitTime ());
+        if (__serverBandwidthLimit__)
+            ms = max (ms, sending ? __serverBandwidthLimit__->send.waitTime () : __serverBandwidthLimit__->recv.waitTime ());
+        if (!ms)
+            return true;
+
+        // waiting for bandwidth is not activity
+        if (idleTimeout ()) {
+            cout << ( dmesgQueue << "[tcpConn] " << "timeout" );
+            return false;
+        }
+        delay (ms);
+    }
+}
+
+void tcpConnection_t::__consumeBandwidth__ (bool sending, unsigned long bytes) {
+    if (sending) {
+        __bandwidthLimit__.send.consume (bytes);
+        globalBandwidthLimit ().send.consume (bytes);
+        if (__serverBandwidthLimit__)
+            __serverBandwidthLimit__->send.consume (bytes);
+    } else {
+        __bandwidthLimit__.recv.consume (bytes);
+        globalBandwidthLimit ().recv.consume (bytes);
+        if (__serverBandwidthLimit__)
+            __serverBandwidthLimit__->recv.consume (bytes);
+    }
+}
+
+
+int tcpConnection_t::__recv__ (void *buf, size_t len, int flags) {
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        int received = ::recv (__connectionSocket__, (char *) buf, len, flags);
+    xSemaphoreGive (getLwIpMutex ());
+    return received;
+}
+
+int tcpConnection_t::__send__ (const void *buf, size_t len) {
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        int sent = ::send (__connectionSocket__, (const char *) buf, len, 0);
+    xSemaphoreGive (getLwIpMutex ());
+    return sent;
+}
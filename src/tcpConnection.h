@@ -57,6 +57,35 @@
     #include <WiFi.h>
     #include <lwip/netdb.h>
     #include <LwIpMutex.h>
+    #include "ipAddress.h"
+    #include "tokenBucket.h"
+    #include "socketOptions.h"
+    #include "tunables.h"
+    #include "topTalkers.h"
+
+
+    // TUNING PARAMETERS
+
+    #ifndef SOCKET_TIMEOUT
+        #define SOCKET_TIMEOUT (1)                      // 1 s, socket's send and receive time-out (just a back-up option, connections are non-blocking)
+    #endif
+
+    #ifndef TCP_KEEPALIVE_IDLE
+        #define TCP_KEEPALIVE_IDLE 30                   // 30 s of silence before the first keep-alive probe is sent ...
+    #endif
+    #ifndef TCP_KEEPALIVE_INTERVAL
+        #define TCP_KEEPALIVE_INTERVAL 5                // ... then a probe every 5 s ...
+    #endif
+    #ifndef TCP_KEEPALIVE_COUNT
+        #define TCP_KEEPALIVE_COUNT 3                   // ... and after 3 unanswered probes the connection is dropped (the peer is considered dead after 45 s)
+    #endif
+
+    // run time values of tuning parameters
+    extern tunable_t socketTimeOut;
+
+
+    // turns TCP keep-alive on (or off if idleSeconds = 0) for the socket, the caller should already hold LwIpMutex
+    bool setSocketKeepAlive (int sockfd, int idleSeconds, int intervalSeconds, int count);
 
 
     // singelton network traffic declaration
@@ -79,12 +108,41 @@
     }
 
 
+    // singleton socket registry declaration, for each socket used by a tcpConnection_t it keeps the pointer to the connection
+    // and its remote address (already known when the connection is established), the rest of the endpoints is only obtained
+    // from lwIP the first time somebody (netstat) asks for it
+    class tcpConnection_t;
+    struct socketRegistryEntry_t {
+        tcpConnection_t *connection;    // NULL if the socket is not used by a tcpConnection_t
+        ipAddress_t remoteAddress;
+        ipAddress_t localAddress;       // valid after fillEndpoints
+        uint16_t localPort;             // valid after fillEndpoints
+        uint16_t remotePort;            // valid after fillEndpoints
+        bool endpointsFilled;
+
+        // obtains local address and both ports from the socket if they are not known yet, the caller should already hold LwIpMutex
+        void fillEndpoints (int sockfd);
+    };
+    struct socketRegistry_t {
+        socketRegistryEntry_t perSocket [MEMP_NUM_NETCONN];
+        socketRegistryEntry_t& operator [] (int sockfd);
+    };
+    // the registry is guarded by LwIpMutex since it changes together with the sockets
+    inline socketRegistry_t& socketRegistry () {
+        static socketRegistry_t instance {};
+        return instance;
+    }
+    inline socketRegistryEntry_t& socketRegistry_t::operator [] (int sockfd) {
+        return perSocket [sockfd - LWIP_SOCKET_OFFSET];
+    }
+
+
     class tcpConnection_t {
 
         public:
             tcpConnection_t ();
-            tcpConnection_t (int connectionSocket, char *clientIP, char *serverIP);
-            ~tcpConnection_t ();
+            tcpConnection_t (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress);
+            virtual ~tcpConnection_t ();
 
             // bool() operator to test if tcpConnection is ready
             inline operator bool () __attribute__((always_inline)) { return __connectionSocket__ != -1; }
@@ -96,25 +154,77 @@
             int sendBlock (void *buf, size_t len);
             int sendString (const char *buf);
 
-            void close ();
+            virtual void close ();
 
             inline int  getSocket () __attribute__((always_inline)) { return __connectionSocket__; }
-            inline char *getClientIP () __attribute__((always_inline)) { return __clientIP__; }
-            inline char *getServerIP () __attribute__((always_inline)) { return __serverIP__; }
+
+            // peer addresses are kept in binary form, text is only made on demand
+            inline const ipAddress_t& getClientAddress () __attribute__((always_inline)) { return __clientAddress__; }
+            const ipAddress_t& getServerAddress ();
+            inline Cstring<INET6_ADDRSTRLEN> getClientIP () __attribute__((always_inline)) { return __clientAddress__.toString (); }
+            inline Cstring<INET6_ADDRSTRLEN> getServerIP () __attribute__((always_inline)) { return getServerAddress ().toString (); }
 
             inline time_t getIdleTimeout () __attribute__((always_inline)) { return __idleTimeout__; }
             inline void setIdleTimeout (time_t seconds) __attribute__((always_inline)) { __idleTimeout__ = seconds; }
             inline void stillActive () __attribute__((always_inline)) { __lastActive__ = millis (); }
             inline bool idleTimeout () __attribute__((always_inline)) { return __idleTimeout__ == 0 ? 0 : millis () - __lastActive__ > __idleTimeout__ * 1000; }
 
+            // TCP keep-alive detects dead peers (the ones that disappeared without closing the connection) much sooner than idle time-out, which can stay long for legitimate idle sessions
+            bool setKeepAlive (int idleSeconds = TCP_KEEPALIVE_IDLE, int intervalSeconds = TCP_KEEPALIVE_INTERVAL, int count = TCP_KEEPALIVE_COUNT);
+
+            // socket options profile, like socketOptions_t::interactive () or socketOptions_t::bulk ()
+            bool setSocketOptions (const socketOptions_t& socketOptions);
+
+            // bandwidth shaping: connection's own limit, the limit shared by all the connections of the same server (if set) and the global limit all apply
+            inline bandwidthLimit_t& getBandwidthLimit () __attribute__((always_inline)) { return __bandwidthLimit__; }
+            inline void setServerBandwidthLimit (bandwidthLimit_t *serverBandwidthLimit) __attribute__((always_inline)) {
+                if (serverBandwidthLimit)
+                    serverBandwidthLimit->acquire (); // the connection keeps its reference until it is destroyed
+                if (__serverBandwidthLimit__)
+                    __serverBandwidthLimit__->release ();
+                __serverBandwidthLimit__ = serverBandwidthLimit;
+            }
+            inline bandwidthLimit_t *getServerBandwidthLimit () __attribute__((always_inline)) { return __serverBandwidthLimit__; }
+
 
         protected:
             int __connectionSocket__ = -1;
             time_t __idleTimeout__ = 0;
             unsigned long __lastActive__ = 0;
 
-            char __clientIP__ [INET6_ADDRSTRLEN] = {};
-            char __serverIP__ [INET6_ADDRSTRLEN] = {};
+            ipAddress_t __clientAddress__;
+            ipAddress_t __serverAddress__;  // if left unspecified it is obtained from the socket the first time it is needed
+
+            bandwidthLimit_t __bandwidthLimit__;
+            bandwidthLimit_t *__serverBandwidthLimit__ = NULL;
+
+            // enters the connection into socketRegistry, the caller should already hold LwIpMutex
+            void __registerSocket__ (const ipAddress_t& remoteAddress);
+
+            // passes the bytes transferred since the last time to topTalkers (), the caller should already hold LwIpMutex
+            void __accountTraffic__ ();
+            inline void __accountTrafficPeriodically__ () __attribute__((always_inline)) {
+                if (millis () - __lastAccountedMillis__ >= TOP_TALKERS_ACCOUNTING_INTERVAL) {
+                    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+                        __accountTraffic__ ();
+                    xSemaphoreGive (getLwIpMutex ());
+                }
+            }
+            unsigned long __accountedBytesReceived__ = 0;
+            unsigned long __accountedBytesSent__ = 0;
+            unsigned long __lastAccountedMillis__ = 0;
+
+            // logs why the connection has been lost if it was not closed by the peer
+            void __connectionLost__ (int err);
+
+            // waits until all the limits let the transfer through (returns false if idle time-out occured meanwhile), afterwards the transferred bytes are consumed from all the buckets
+            bool __waitForBandwidth__ (bool sending);
+            void __consumeBandwidth__ (bool sending, unsigned long bytes);
+
+            // raw socket I/O, all the reading and writing goes through these two functions so that derived classes (like tlsConnection_t) can put another layer in between
+            // they behave like ::recv and ::send on non-blocking socket: return the number of bytes or -1 and set errno (EAGAIN if the operation should be repeated)
+            virtual int __recv__ (void *buf, size_t len, int flags);
+            virtual int __send__ (const void *buf, size_t len);
     };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,227 @@
+/*
+
+    tcpConnectionT.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 13, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        tcpConnectionT<lockingPolicy, accountingPolicy, timeoutPolicy, blockSize>
+        lwIpMutexLocking_t, noLocking_t
+        trafficAccounting_t, noAccounting_t
+        idleTimeout_t, noTimeout_t
+
+    tcpConnectionT is a connection whose behaviour is chosen at compile time instead of run time. It has no virtual functions
+    and each policy is an empty (or almost empty) class with inline static or member functions, so the features that are not
+    selected do not exist in the code at all and the rest of the code inlines into recv and sendBlock:
+
+        lockingPolicy       lwIpMutexLocking_t  - every socket call is guarded with LwIpMutex (like tcpConnection_t)
+                            noLocking_t         - socket calls are not guarded (lwIP itself is thread-safe, LwIpMutex only
+                                                  serializes this library's own sequences of calls)
+
+        accountingPolicy    trafficAccounting_t - bytes are counted in networkTraffic () (like tcpConnection_t)
+                            noAccounting_t      - no counting
+
+        timeoutPolicy       idleTimeout_t       - the connection times out after being idle for setIdleTimeout seconds (like tcpConnection_t)
+                            noTimeout_t         - the connection waits until the peer closes it or the error occurs
+
+        blockSize           the largest block passed to lwIP's send at once
+
+    It does not replace tcpConnection_t for the built-in servers, it is meant for the calling program's own protocols, for
+    example together with tcpServer_t::acceptSocket ().
+
+        tcpConnectionT<lwIpMutexLocking_t, trafficAccounting_t, idleTimeout_t>  behaves like tcpConnection_t
+        tcpConnectionT<noLocking_t, noAccounting_t, noTimeout_t>                is the smallest one
+
+*/
+
+
+#pragma once
+#ifndef __TCP_CONNECTION_T__
+    #define __TCP_CONNECTION_T__
+
+
+    #include <WiFi.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <LwIpMutex.h>
+    #include "tcpConnection.h"  // networkTraffic ()
+
+
+    // locking policies
+
+    struct lwIpMutexLocking_t {
+        static inline void lock () __attribute__((always_inline)) { xSemaphoreTake (getLwIpMutex (), portMAX_DELAY); }
+        static inline void unlock () __attribute__((always_inline)) { xSemaphoreGive (getLwIpMutex ()); }
+    };
+
+    struct noLocking_t {
+        static inline void lock () __attribute__((always_inline)) {}
+        static inline void unlock () __attribute__((always_inline)) {}
+    };
+
+
+    // accounting policies
+
+    struct trafficAccounting_t {
+        static inline void received (int sockfd, int bytes) __attribute__((always_inline)) {
+            networkTraffic ().bytesReceived += bytes;
+            networkTraffic () [sockfd].bytesReceived += bytes;
+        }
+        static inline void sent (int sockfd, int bytes) __attribute__((always_inline)) {
+            networkTraffic ().bytesSent += bytes;
+            networkTraffic () [sockfd].bytesSent += bytes;
+        }
+        static inline void reset (int sockfd) __attribute__((always_inline)) { networkTraffic () [sockfd] = {0, 0}; }
+    };
+
+    struct noAccounting_t {
+        static inline void received (int sockfd, int bytes) __attribute__((always_inline)) {}
+        static inline void sent (int sockfd, int bytes) __attribute__((always_inline)) {}
+        static inline void reset (int sockfd) __attribute__((always_inline)) {}
+    };
+
+
+    // time-out policies (these have state, so the connection inherits from them)
+
+    class idleTimeout_t {
+        public:
+            inline void setIdleTimeout (time_t seconds) __attribute__((always_inline)) { __idleTimeout__ = seconds; }
+            inline void stillActive () __attribute__((always_inline)) { __lastActive__ = millis (); }
+            inline bool idleTimeout () __attribute__((always_inline)) { return __idleTimeout__ == 0 ? 0 : millis () - __lastActive__ > __idleTimeout__ * 1000; }
+            // how long the connection may still wait for the socket, at most 1 s if there is no time-out set
+            inline unsigned long waitMillis () __attribute__((always_inline)) {
+                if (__idleTimeout__ == 0)
+                    return 1000;
+                unsigned long idle = millis () - __lastActive__;
+                return idle >= __idleTimeout__ * 1000 ? 0 : __idleTimeout__ * 1000 - idle;
+            }
+        private:
+            time_t __idleTimeout__ = 0;
+            unsigned long __lastActive__ = millis ();
+    };
+
+    class noTimeout_t {
+        public:
+            inline void stillActive () __attribute__((always_inline)) {}
+            inline bool idleTimeout () __attribute__((always_inline)) { return false; }
+            inline unsigned long waitMillis () __attribute__((always_inline)) { return 1000; } // then the caller just tries again
+    };
+
+
+    template<class lockingPolicy = lwIpMutexLocking_t, class accountingPolicy = trafficAccounting_t, class timeoutPolicy = idleTimeout_t, size_t blockSize = 1440>
+    class tcpConnectionT : public timeoutPolicy {
+
+        public:
+
+            // takes over already connected socket (for example from tcpServer_t::acceptSocket ())
+            tcpConnectionT (int connectionSocket) : __connectionSocket__ (connectionSocket) {
+                if (__connectionSocket__ == -1)
+                    return; // acceptSocket () returned no socket
+                lockingPolicy::lock ();
+                    accountingPolicy::reset (__connectionSocket__);
+                    int ret = fcntl (__connectionSocket__, F_SETFL, O_NONBLOCK);
+                lockingPolicy::unlock ();
+                if (ret < 0)
+                    close ();
+            }
+
+            ~tcpConnectionT () { close (); }
+
+            // not copyable, the socket has only one owner
+            tcpConnectionT (const tcpConnectionT&) = delete;
+            tcpConnectionT& operator = (const tcpConnectionT&) = delete;
+
+            inline operator bool () __attribute__((always_inline)) { return __connectionSocket__ != -1; }
+            inline int getSocket () __attribute__((always_inline)) { return __connectionSocket__; }
+
+            // returns the number of bytes received, 0 if the peer closed the connection or -1 in case of error or time-out
+            int recv (void *buf, size_t len) {
+                while (true) {
+                    lockingPolicy::lock ();
+                        int received = ::recv (__connectionSocket__, (char *) buf, len, 0);
+                    lockingPolicy::unlock ();
+                    if (received > 0) {
+                        this->stillActive ();
+                        accountingPolicy::received (__connectionSocket__, received);
+                        return received;
+                    }
+                    if (received == 0)
+                        return 0;
+                    if (!__wait__ (false))
+                        return -1;
+                }
+            }
+
+            // returns len, 0 if the peer closed the connection or -1 in case of error or time-out
+            int recvBlock (void *buf, size_t len) {
+                size_t receivedTotal = 0;
+                while (receivedTotal < len) {
+                    int receivedThisTime = recv ((char *) buf + receivedTotal, len - receivedTotal);
+                    if (receivedThisTime <= 0)
+                        return receivedThisTime;
+                    receivedTotal += receivedThisTime;
+                }
+                return receivedTotal;
+            }
+
+            // returns len, 0 if the peer closed the connection or -1 in case of error or time-out
+            int sendBlock (const void *buf, size_t len) {
+                size_t sentTotal = 0;
+                while (sentTotal < len) {
+                    size_t n = len - sentTotal < blockSize ? len - sentTotal : blockSize;
+                    lockingPolicy::lock ();
+                        int sentThisTime = ::send (__connectionSocket__, (const char *) buf + sentTotal, n, 0);
+                    lockingPolicy::unlock ();
+                    if (sentThisTime > 0) {
+                        this->stillActive ();
+                        accountingPolicy::sent (__connectionSocket__, sentThisTime);
+                        sentTotal += sentThisTime;
+                        continue;
+                    }
+                    if (sentThisTime == 0)
+                        return 0;
+                    if (!__wait__ (true))
+                        return -1;
+                }
+                return sentTotal;
+            }
+
+            inline int sendString (const char *buf) __attribute__((always_inline)) { return sendBlock (buf, strlen (buf)); }
+
+            void close () {
+                if (__connectionSocket__ != -1) {
+                    lockingPolicy::lock ();
+                        ::close (__connectionSocket__);
+                    lockingPolicy::unlock ();
+                    __connectionSocket__ = -1;
+                }
+            }
+
+        private:
+
+            int __connectionSocket__;
+
+            // after recv or send returned -1: waits until the socket is ready again (or the idle time-out) and returns true if the call should be repeated
+            bool __wait__ (bool forWriting) {
+                if (errno != EAGAIN && errno != ENOTCONN) // ENOTCONN: all the sockets are non-blocking, like in tcpConnection_t
+                    return false;
+                if (this->idleTimeout ())
+                    return false;
+                unsigned long waitMillis = this->waitMillis ();
+                fd_set fds;
+                FD_ZERO (&fds);
+                FD_SET (__connectionSocket__, &fds);
+                struct timeval tv = { (time_t) (waitMillis / 1000), (suseconds_t) ((waitMillis % 1000) * 1000) };
+                // without locking, lwIP's select is thread-safe and the other tasks can use the network meanwhile
+                if (select (__connectionSocket__ + 1, forWriting ? NULL : &fds, forWriting ? &fds : NULL, NULL, &tv) < 0)
+                    return false;
+                return !this->idleTimeout ();
+            }
+    };
+
+#endif
@@ -57,11 +57,204 @@
 
 int __runningTcpConnections__ = 0;
 
+
+// run time values of tuning parameters
+tunable_t tcpListenerStackSize ("TCP_LISTENER_STACK_SIZE", TCP_LISTENER_STACK_SIZE, 2 * 1024, 16 * 1024, "bytes");
+tunable_t tcpListenerSelectTimeOut ("TCP_LISTENER_SELECT_TIME_OUT", TCP_LISTENER_SELECT_TIME_OUT, 10, 10000, "ms");
+
+
+// shared listener: one task waits on all the registered listening sockets at once and calls accept of the server whose socket is ready
+
+static tcpServer_t *__listenedServers__ [TCP_LISTENER_MAX_SERVERS] = {};
+static TaskHandle_t __listenerTaskHandle__ = NULL;
+
+// guards __listenedServers__ and __listenerPins__ of the servers, it is not held while the listener calls accept
+static SemaphoreHandle_t __listenerMutex__ () {
+  static SemaphoreHandle_t semaphore = xSemaphoreCreateMutex ();
+  return semaphore;
+}
+
+// loopback UDP socket that is always in the listener's select set, a datagram sent to it wakes the listener up when a new server registers
+static int __listenerWakeUpSocket__ = -1;
+static struct sockaddr_in __listenerWakeUpAddress__ = {};
+
+static void __createListenerWakeUpSocket__ () {
+  xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+    __listenerWakeUpSocket__ = socket (AF_INET, SOCK_DGRAM, 0);
+    if (__listenerWakeUpSocket__ != -1) {
+      __listenerWakeUpAddress__.sin_family = AF_INET;
+      __listenerWakeUpAddress__.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+      __listenerWakeUpAddress__.sin_port = 0; // let lwIP choose the port
+      socklen_t len = sizeof (__listenerWakeUpAddress__);
+      if (bind (__listenerWakeUpSocket__, (struct sockaddr *) &__listenerWakeUpAddress__, sizeof (__listenerWakeUpAddress__)) == -1 ||
+          getsockname (__listenerWakeUpSocket__, (struct sockaddr *) &__listenerWakeUpAddress__, &len) == -1 ||
+          fcntl (__listenerWakeUpSocket__, F_SETFL, O_NONBLOCK) < 0) {
+        close (__listenerWakeUpSocket__);
+        __listenerWakeUpSocket__ = -1;
+      }
+    }
+  xSemaphoreGive (getLwIpMutex ());
+
+  // not fatal, newly registered servers would only wait for select's time-out
+  if (__listenerWakeUpSocket__ == -1)
+    cout << ( dmesgQueue << "[tcpServer] " << "couldn't create listener's wake-up socket: " << errno << " " << strerror (errno) );
+}
+
+static void __wakeUpListener__ () {
+  if (__listenerWakeUpSocket__ == -1)
+    return;
+  xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+    sendto (__listenerWakeUpSocket__, "", 1, 0, (struct sockaddr *) &__listenerWakeUpAddress__, sizeof (__listenerWakeUpAddress__));
+  xSemaphoreGive (getLwIpMutex ());
+}
+
+bool tcpServer_t::__registerWithListener__ () {
+  xSemaphoreTake (__listenerMutex__ (), portMAX_DELAY);
+    int i = 0;
+    while (i < TCP_LISTENER_MAX_SERVERS && __listenedServers__ [i])
+      i++;
+    if (i == TCP_LISTENER_MAX_SERVERS) {
+      xSemaphoreGive (__listenerMutex__ ());
+      cout << ( dmesgQueue << "[tcpServer] " << "too many servers for the listener, increase TCP_LISTENER_MAX_SERVERS" );
+      return false;
+    }
+
+    // start the listener with the first server
+    if (!__listenerTaskHandle__) {
+      __createListenerWakeUpSocket__ ();
+      #define tskNORMAL_PRIORITY (tskIDLE_PRIORITY + 1)
+      if (pdPASS != xTaskCreate (__listener__, "tcpListener", tcpListenerStackSize, NULL, tskNORMAL_PRIORITY, &__listenerTaskHandle__)) {
+        __listenerTaskHandle__ = NULL;
+        xSemaphoreGive (__listenerMutex__ ());
+        cout << ( dmesgQueue << "[tcpServer] " << "xTaskCreate error" );
+        return false;
+      }
+    }
+
+    __listenedServers__ [i] = this;
+    xTaskNotifyGive (__listenerTaskHandle__); // in case the listener is waiting for servers
+    __wakeUpListener__ (); // in case the listener is waiting in select
+  xSemaphoreGive (__listenerMutex__ ());
+
+  cout << ( dmesgQueue << "[tcpServer] " << "listening on port " << __serverPort__ );
+  return true;
+}
+
+void tcpServer_t::__unregisterFromListener__ () {
+  bool registered = false;
+  xSemaphoreTake (__listenerMutex__ (), portMAX_DELAY);
+    for (int i = 0; i < TCP_LISTENER_MAX_SERVERS; i++)
+      if (__listenedServers__ [i] == this) {
+        __listenedServers__ [i] = NULL;
+        registered = true;
+      }
+  xSemaphoreGive (__listenerMutex__ ());
+  if (!registered) // already unregistered (by derived class' destructor)
+    return;
+
+  // the listener can't pin this server any more but it may still be accepting a connection for it
+  while (true) {
+    xSemaphoreTake (__listenerMutex__ (), portMAX_DELAY);
+      int pins = __listenerPins__;
+    xSemaphoreGive (__listenerMutex__ ());
+    if (!pins)
+      break;
+    delay (1);
+  }
+
+  cout << ( dmesgQueue << "[tcpServer] " << "on port " << __serverPort__ << " stopped" );
+}
+
+void tcpServer_t::__listener__ (void *) {
+  cout << ( dmesgQueue << "[tcpServer] " << "listener started on core " << xPortGetCoreID () );
+
+  while (true) {
+    // collect listening sockets
+    fd_set readfds;
+    FD_ZERO (&readfds);
+    int maxfd = -1;
+    bool serversRegistered = false;
+    xSemaphoreTake (__listenerMutex__ (), portMAX_DELAY);
+      for (int i = 0; i < TCP_LISTENER_MAX_SERVERS; i++)
+        if (__listenedServers__ [i] && __listenedServers__ [i]->__listeningSocket__ != -1) {
+          FD_SET (__listenedServers__ [i]->__listeningSocket__, &readfds);
+          maxfd = max (maxfd, __listenedServers__ [i]->__listeningSocket__);
+          serversRegistered = true;
+        }
+    xSemaphoreGive (__listenerMutex__ ());
+
+    // sleep until some server registers
+    if (!serversRegistered) {
+      ulTaskNotifyTake (pdTRUE, portMAX_DELAY);
+      continue;
+    }
+
+    if (__listenerWakeUpSocket__ != -1) {
+      FD_SET (__listenerWakeUpSocket__, &readfds);
+      maxfd = max (maxfd, __listenerWakeUpSocket__);
+    }
+
+    // wait for incoming connections, without LwIpMutex so the other tasks can use the network meanwhile (lwIP's select is thread-safe),
+    // newly registered servers wake the listener up through the wake-up socket, the time-out is only a back-up
+    long selectTimeOut = tcpListenerSelectTimeOut;
+    struct timeval tv = { selectTimeOut / 1000, (selectTimeOut % 1000) * 1000 };
+    int ready = select (maxfd + 1, &readfds, NULL, NULL, &tv);
+    if (ready == -1) {
+      delay (25); // some listening socket has probably just been closed, the set will be collected again
+      continue;
+    }
+
+    if (ready > 0 && __listenerWakeUpSocket__ != -1 && FD_ISSET (__listenerWakeUpSocket__, &readfds)) {
+      // drain wake-up datagrams, the set of listening sockets will be collected again anyway
+      char c [8];
+      xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        while (recv (__listenerWakeUpSocket__, c, sizeof (c), 0) > 0)
+          ;
+      xSemaphoreGive (getLwIpMutex ());
+    }
+
+    // dispatch to the servers whose sockets are ready: pin them under the mutex and accept without it, so that accepting
+    // (and creating connection instances) doesn't block (un)registering of the servers
+    if (ready > 0) {
+      tcpServer_t *readyServers [TCP_LISTENER_MAX_SERVERS];
+      int readyCount = 0;
+      xSemaphoreTake (__listenerMutex__ (), portMAX_DELAY);
+        for (int i = 0; i < TCP_LISTENER_MAX_SERVERS; i++)
+          if (__listenedServers__ [i] && __listenedServers__ [i]->__listeningSocket__ != -1 && FD_ISSET (__listenedServers__ [i]->__listeningSocket__, &readfds)) {
+            __listenedServers__ [i]->__listenerPins__ ++;
+            readyServers [readyCount ++] = __listenedServers__ [i];
+          }
+      xSemaphoreGive (__listenerMutex__ ());
+
+      for (int i = 0; i < readyCount; i++) {
+        readyServers [i]->accept ();
+        xSemaphoreTake (__listenerMutex__ (), portMAX_DELAY);
+          readyServers [i]->__listenerPins__ --;
+        xSemaphoreGive (__listenerMutex__ ());
+      }
+    }
+
+    static UBaseType_t lastHighWaterMark = tcpListenerStackSize;
+    UBaseType_t highWaterMark = uxTaskGetStackHighWaterMark (NULL);
+    if (lastHighWaterMark > highWaterMark) {
+      cout << ( dmesgQueue << "[tcpServer] " << "new listener's stack high water mark: " << highWaterMark << " bytes not used" );
+      lastHighWaterMark = highWaterMark;
+    }
+  }
+}
+
+
 tcpServer_t::tcpServer_t (int serverPort,
-                          bool (*firewallCallback) (char *clientIP, char *serverIP),
+                          bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress),
                           bool runListenerInItsOwnTask) : __serverPort__ (serverPort), 
                                                           __firewallCallback__ (firewallCallback),
                                                           __runListenerInItsOwnTask__ (runListenerInItsOwnTask) {
+
+  __bandwidthLimit__ = new (std::nothrow) bandwidthLimit_t;
+  if (!__bandwidthLimit__) {
+    cout << ( dmesgQueue << "[tcpServer] " << "out of memory" );
+    return;
+  }
   
   xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
 
@@ -128,41 +321,10 @@ tcpServer_t::tcpServer_t (int serverPort,
   __state__ = RUNNING;
 
 
-  // start listener task if needed
+  // register with the shared listener if needed
   if (runListenerInItsOwnTask) {
-    #define tskNORMAL_PRIORITY (tskIDLE_PRIORITY + 1)
-    BaseType_t taskCreated = xTaskCreate ([] (void *thisInstance) {
-      tcpServer_t *ths = (tcpServer_t *) thisInstance;
-      cout << ( dmesgQueue << "[tcpServer] " << "listener on port " << ths->__serverPort__ << " started on core " << xPortGetCoreID () );
-
-      while (ths->__listeningSocket__ > -1) {
-        delay (25);
-        ths->accept ();
-
-        static UBaseType_t lastHighWaterMark = TCP_LISTENER_STACK_SIZE;
-        UBaseType_t highWaterMark = uxTaskGetStackHighWaterMark (NULL);
-        if (lastHighWaterMark > highWaterMark) {
-          cout << ( dmesgQueue << "[tcpServer] " << "new listener's stack high water mark: " << highWaterMark << " bytes not used" );
-          lastHighWaterMark = highWaterMark;
-        }
-      }
-
-      cout << ( dmesgQueue << "[tcpServer] " << "on port " << ths->__serverPort__ << " stopped" );
-
-      xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-        if (ths->__listeningSocket__ != -1) {
-          close (ths->__listeningSocket__);
-          ths->__listeningSocket__ = -1;
-        }
-      xSemaphoreGive (getLwIpMutex ());
-
-      ths->__state__ = NOT_RUNNING;
-      vTaskDelete (NULL);
-    }, "tcpListener", TCP_LISTENER_STACK_SIZE, this, tskNORMAL_PRIORITY, NULL);
-
-    if (pdPASS != taskCreated) {
+    if (!__registerWithListener__ ()) {
       __state__ = NOT_RUNNING;
-      cout << ( dmesgQueue << "[tcpServer] " << "xTaskCreate error" );
       xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
         if (__listeningSocket__ != -1) {
           close (__listeningSocket__);
@@ -176,6 +338,10 @@ tcpServer_t::tcpServer_t (int serverPort,
 }
 
 tcpServer_t::~tcpServer_t () {
+  // after this the shared listener won't call accept any more
+  if (__runListenerInItsOwnTask__)
+    __unregisterFromListener__ ();
+
   xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
     if (__listeningSocket__ != -1) {
       close (__listeningSocket__);
@@ -183,17 +349,25 @@ tcpServer_t::~tcpServer_t () {
     }
   xSemaphoreGive (getLwIpMutex ());
 
+  if (__bandwidthLimit__)
+    __bandwidthLimit__->release (); // connections that are still running keep it until they end
 
-  // wait until listener task finishes before unloading so that variables are still in the memory while it is running
-  if (__runListenerInItsOwnTask__) {
-    while (__state__ != NOT_RUNNING)
-      delay (25);
-  }
+  __state__ = NOT_RUNNING;
 }
 
-tcpConnection_t *tcpServer_t::accept () {
+bool tcpServer_t::waitForConnection (unsigned long timeOutMillis) {
+  if (__listeningSocket__ == -1)
+    return false;
+  // without LwIpMutex, like the shared listener
+  fd_set readfds;
+  FD_ZERO (&readfds);
+  FD_SET (__listeningSocket__, &readfds);
+  struct timeval tv = { (time_t) (timeOutMillis / 1000), (suseconds_t) ((timeOutMillis % 1000) * 1000) };
+  return select (__listeningSocket__ + 1, &readfds, NULL, NULL, &tv) > 0;
+}
+
+int tcpServer_t::acceptSocket (ipAddress_t& clientAddress, ipAddress_t& serverAddress) {
   int connectionSocket;
-  char clientIP [INET6_ADDRSTRLEN];
   struct sockaddr_storage connectingAddress;
   socklen_t connectingAddressSize = sizeof (connectingAddress);
 
@@ -201,7 +375,7 @@ tcpConnection_t *tcpServer_t::accept () {
     xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
       if (__listeningSocket__ == -1) {
         xSemaphoreGive (getLwIpMutex ());
-        return NULL;
+        return -1;
       }
 
       connectionSocket = ::accept (__listeningSocket__, (struct sockaddr *) &connectingAddress, &connectingAddressSize);
@@ -213,54 +387,72 @@ tcpConnection_t *tcpServer_t::accept () {
           cout << ( dmesgQueue << "[tcpServer] " << "accept error: " << errno << " " << strerror (errno) );
         }      
         xSemaphoreGive (getLwIpMutex ());
-        return NULL;
+        return -1;
       }
 
       // set socket time-out (without error checking, this is just a back-up option)
-      struct timeval tv = { SOCKET_TIMEOUT, 0 };
+      struct timeval tv = { socketTimeOut, 0 };
       setsockopt (connectionSocket, SOL_SOCKET, SO_RCVTIMEO, (const char *) &tv, sizeof (tv));
       setsockopt (connectionSocket, SOL_SOCKET, SO_SNDTIMEO, (const char *) &tv, sizeof (tv));
+
+      // apply socket options profile
+      __socketOptions__.apply (connectionSocket);
+
+      // detect dead peers
+      if (__keepAliveIdle__)
+        setSocketKeepAlive (connectionSocket, __keepAliveIdle__, __keepAliveInterval__, __keepAliveCount__);
       
     xSemaphoreGive (getLwIpMutex ());
 
-  // as long as only one task accesses the socket the follwing LwIP functions can be used withot semaphore
+  // client's address is already here, IPv4 clients arrive as IPv4-mapped IPv6 addresses on dual-stack socket
+  clientAddress = ipAddress_t ((struct sockaddr *) &connectingAddress);
 
-  // get client's IP
-  if (connectingAddress.ss_family == AF_INET) {
-    struct sockaddr_in *s = (struct sockaddr_in *) &connectingAddress;
-    inet_ntop (AF_INET, &s->sin_addr, clientIP, sizeof (clientIP));
-  } else {
-    struct sockaddr_in6 *s = (struct sockaddr_in6 *) &connectingAddress;
-    inet_ntop (AF_INET6, &s->sin6_addr, clientIP, sizeof (clientIP));
+  // check compiled firewall rules
+  if (__firewall__ && !__firewall__->allows (clientAddress)) {
+    cout << ( dmesgQueue << "[tcpServer] " << "firewall rules rejected connection from " << clientAddress.toString () );
+    close (connectionSocket);
+    return -1;
   }
 
-  // get server's IP
-  char serverIP [INET6_ADDRSTRLEN] = "";
-  struct sockaddr_storage thisAddress = {};
-  socklen_t len = sizeof (thisAddress);
-  if (getsockname (connectionSocket, (struct sockaddr *) &thisAddress, &len) != -1) {
-    struct sockaddr_in6 *s = (struct sockaddr_in6 *) &thisAddress;
-    inet_ntop (AF_INET6, &s->sin6_addr, serverIP, sizeof (serverIP));
-    if (connectingAddress.ss_family == AF_INET) {
-      char *p = serverIP;
-      for (char *q = p; *q; q++)
-        if (*q == ':')
-          p = q;
-      if (p != serverIP)
-        strcpy (serverIP, p + 1);
-    }
+  // check connection rate from client's address
+  if (__connectionRateLimiter__ && !__connectionRateLimiter__->allows (clientAddress)) {
+    cout << ( dmesgQueue << "[tcpServer] " << "connection rate limit exceeded by " << clientAddress.toString () );
+    close (connectionSocket);
+    return -1;
   }
 
-  // check firewall
-  if (__firewallCallback__ && !__firewallCallback__ (clientIP, serverIP)) {
-    cout << ( dmesgQueue << "[tcpServer] " << "firewall rejected connection from " << clientIP << " to " << serverIP );
-    close (connectionSocket);
-    return NULL;
+  // server's address is only needed here if firewall wants to see it, otherwise the connection obtains it later if needed
+  serverAddress = ipAddress_t ();
+
+  // check firewall callback
+  if (__firewallCallback__) {
+    struct sockaddr_storage thisAddress = {};
+    socklen_t len = sizeof (thisAddress);
+    if (getsockname (connectionSocket, (struct sockaddr *) &thisAddress, &len) != -1)
+      serverAddress = ipAddress_t ((struct sockaddr *) &thisAddress);
+
+    if (!__firewallCallback__ (clientAddress, serverAddress)) {
+      cout << ( dmesgQueue << "[tcpServer] " << "firewall rejected connection from " << clientAddress.toString () << " to " << serverAddress.toString () );
+      close (connectionSocket);
+      return -1;
+    }
   }
 
-  return __createConnectionInstance__ (connectionSocket, clientIP, serverIP);
+  return connectionSocket;
+}
+
+tcpConnection_t *tcpServer_t::accept () {
+  ipAddress_t clientAddress;
+  ipAddress_t serverAddress;
+  int connectionSocket = acceptSocket (clientAddress, serverAddress);
+  if (connectionSocket == -1)
+    return NULL;
+  return __createConnectionInstance__ (connectionSocket, clientAddress, serverAddress);
 }
 
-tcpConnection_t *tcpServer_t::__createConnectionInstance__ (int connectionSocket, char *clientIP, char *serverIP) {
-    return new (std::nothrow) tcpConnection_t (connectionSocket, clientIP, serverIP);
+tcpConnection_t *tcpServer_t::__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) {
+    tcpConnection_t *connection = new (std::nothrow) tcpConnection_t (connectionSocket, clientAddress, serverAddress);
+    if (connection)
+        connection->setServerBandwidthLimit (&getBandwidthLimit ());
+    return connection;
 }
@@ -60,6 +60,9 @@
   #include <arpa/inet.h>
   #include <fcntl.h>
   #include "LwIpMutex.h"
+  #include "ipAddress.h"
+  #include "firewall.h"
+  #include "connectionRateLimiter.h"
   #include "tcpConnection.h"
 
 
@@ -73,9 +76,16 @@
     #define TCP_LISTENER_STACK_SIZE (2 * 1024 + 512)
   #endif
 
-  #ifndef SOCKET_TIMEOUT
-    #define SOCKET_TIMEOUT (1)
+  #ifndef TCP_LISTENER_MAX_SERVERS
+    #define TCP_LISTENER_MAX_SERVERS 8                // max number of servers served by the shared listener task
   #endif
+  #ifndef TCP_LISTENER_SELECT_TIME_OUT
+    #define TCP_LISTENER_SELECT_TIME_OUT 500          // 500 ms, back-up for the wake-up socket: the longest the shared listener waits before it checks for newly registered servers
+  #endif
+
+  // run time values of tuning parameters
+  extern tunable_t tcpListenerStackSize;
+  extern tunable_t tcpListenerSelectTimeOut;
 
 
   extern int __runningTcpConnections__;
@@ -85,7 +95,7 @@
     public:
 
         tcpServer_t (int serverPort,
-                     bool (*firewallCallback) (char *clientIP, char *serverIP),
+                     bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress),
                      bool runListenerInItsOwnTask = true);
 
         virtual ~tcpServer_t ();
@@ -96,11 +106,46 @@
         // accepts incoming connection
         virtual tcpConnection_t *accept ();
 
+        // accepts incoming connection socket (after all the checks) without creating a connection instance, returns -1 if there is none, the caller takes over the socket
+        int acceptSocket (ipAddress_t& clientAddress, ipAddress_t& serverAddress);
+
+        // for servers without listener's task: waits until a connection is pending (or time-out), returns true if accept would get it
+        bool waitForConnection (unsigned long timeOutMillis);
+
+        // compiled CIDR rules are checked on the binary client's address before anything else is done with the connection (the firewall callback is still called afterwards if set)
+        inline void setFirewall (firewall_t *firewall) __attribute__((always_inline)) { __firewall__ = firewall; }
+
+        // connections from the same IP address exceeding limiter's rate are rejected at accept time, each server should have its own limiter
+        inline void setConnectionRateLimiter (connectionRateLimiter_t *connectionRateLimiter) __attribute__((always_inline)) { __connectionRateLimiter__ = connectionRateLimiter; }
+        inline connectionRateLimiter_t *getConnectionRateLimiter () __attribute__((always_inline)) { return __connectionRateLimiter__; }
+
+        // TCP keep-alive for accepted connections (by default off), idleSeconds = 0 turns it off again
+        inline void setKeepAlive (int idleSeconds = TCP_KEEPALIVE_IDLE, int intervalSeconds = TCP_KEEPALIVE_INTERVAL, int count = TCP_KEEPALIVE_COUNT) __attribute__((always_inline)) {
+            __keepAliveIdle__ = idleSeconds;
+            __keepAliveInterval__ = intervalSeconds;
+            __keepAliveCount__ = count;
+        }
+
+        // socket options profile applied to accepted connections (by default lwIP's defaults are left as they are)
+        inline void setSocketOptions (const socketOptions_t& socketOptions) __attribute__((always_inline)) { __socketOptions__ = socketOptions; }
+
+        // bandwidth limit shared by all the connections of this server (by default unlimited), only for the server that started successfully
+        inline bandwidthLimit_t& getBandwidthLimit () __attribute__((always_inline)) { return *__bandwidthLimit__; }
+
     private:
 
         int __serverPort__;
 
-        bool (*__firewallCallback__) (char *clientIP, char *serverIP);
+        bool (*__firewallCallback__) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress);
+        firewall_t *__firewall__ = NULL;
+        connectionRateLimiter_t *__connectionRateLimiter__ = NULL;
+        bandwidthLimit_t *__bandwidthLimit__; // the connections hold references to it, so it may outlive the server
+
+        socketOptions_t __socketOptions__;
+
+        int __keepAliveIdle__ = 0;
+        int __keepAliveInterval__ = TCP_KEEPALIVE_INTERVAL;
+        int __keepAliveCount__ = TCP_KEEPALIVE_COUNT;
 
         enum STATE_TYPE { STARTING = 0, NOT_RUNNING = 1, RUNNING = 2 } __state__ = STARTING;
 
@@ -108,7 +153,20 @@
 
         bool __runListenerInItsOwnTask__;
 
-        virtual tcpConnection_t *__createConnectionInstance__ (int connectionSocket, char *clientIP, char *serverIP);
+        virtual tcpConnection_t *__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress);
+
+        // shared listener task
+        int __listenerPins__ = 0; // > 0 while the listener is accepting a connection for this server, guarded by listener's mutex
+        bool __registerWithListener__ ();
+
+    protected:
+
+        // derived classes call it in their destructors so that the listener doesn't call their __createConnectionInstance__ while they are being destroyed
+        void __unregisterFromListener__ ();
+
+    private:
+
+        static void __listener__ (void *);
 
   };
 
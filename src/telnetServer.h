@@ -88,6 +88,7 @@
         #include <tcpClient.h>
         #include <dmesg.hpp>
         #include <ostream.hpp>
+        #include <objectPool.h>
 
         #ifdef __THREAD_SAFE_FS__
                 #include <FS.h>
@@ -134,6 +135,9 @@
         #ifndef TELNET_DMESG_COMMAND
                 #define TELNET_DMESG_COMMAND 1      // 0=exclude, 1=include, dmesg included by default
         #endif
+        #ifndef TELNET_SYSCTL_COMMAND
+                #define TELNET_SYSCTL_COMMAND 1     // 0=exclude, 1=include, sysctl included by default
+        #endif
         #ifndef TELNET_UPTIME_COMMAND
                 #define TELNET_UPTIME_COMMAND 1     // 0=exclude, 1=include, date included by default
         #endif
@@ -158,6 +162,9 @@
         #ifndef TELNET_NETSTAT_COMMAND
                 #define TELNET_NETSTAT_COMMAND 1    // 0=exclude, 1=include, netstat included by default
         #endif
+        #ifndef TELNET_IFTOP_COMMAND
+                #define TELNET_IFTOP_COMMAND 1      // 0=exclude, 1=include, iftop included by default
+        #endif
         #ifndef TELNET_KILL_COMMAND
                 #define TELNET_KILL_COMMAND 1       // 0=exclude, 1=include, kill included by default
         #endif
@@ -294,6 +301,14 @@
                 #define TELNET_CONNECTION_TIME_OUT 256
         #endif
 
+        // run time values of tuning parameters
+        tunable_t telnetConnectionStackSize ("TELNET_CONNECTION_STACK_SIZE", TELNET_CONNECTION_STACK_SIZE, 4 * 1024, 16 * 1024, "bytes");
+        tunable_t telnetConnectionTimeOut ("TELNET_CONNECTION_TIME_OUT", TELNET_CONNECTION_TIME_OUT, 0, 3600, "s");
+
+        #ifndef TELNET_CONNECTION_POOL_SIZE
+                #define TELNET_CONNECTION_POOL_SIZE 2           // number of connection objects preallocated when the server starts, more connections are still possible but they are allocated on the heap
+        #endif
+
         #ifndef TELNET_CMDLINE_BUFFER_SIZE
                 #define TELNET_CMDLINE_BUFFER_SIZE 300
         #endif
@@ -383,6 +398,8 @@
 
                                         static UBaseType_t __lastHighWaterMark__;
 
+                                        static objectPool_t __pool__;
+
                                         unsigned char __peekedChar__ = 0;
                                         char __cmdLine__ [TELNET_CMDLINE_BUFFER_SIZE];
                                         char __prompt__ = 0;
@@ -396,19 +413,24 @@
                                         telnetConnection_t (    threadSafeFS::FS& fileSystem,                                                                    // file system that FTP server would use
                                                                 Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password),
                                                                 int connectionSocket,                                                                       // socket number
-                                                                char *clientIP,                                                                             // client's IP
-                                                                char *serverIP,                                                                             // server's IP (the address to which the connection arrived)
+                                                                const ipAddress_t& clientAddress,                                                           // client's IP
+                                                                const ipAddress_t& serverAddress,                                                           // server's IP (the address to which the connection arrived)
                                                                 String (*telnetCommandHandlerCallback) (int argc, char *argv  [], telnetConnection_t *tcn)  // telnetCommandHandlerCallback function provided by calling program
                                                         );
                                 #endif
 
                                         telnetConnection_t (    Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password),
                                                                 int connectionSocket,                                                                       // socket number
-                                                                char *clientIP,                                                                             // client's IP
-                                                                char *serverIP,                                                                             // server's IP (the address to which the connection arrived)
+                                                                const ipAddress_t& clientAddress,                                                           // client's IP
+                                                                const ipAddress_t& serverAddress,                                                           // server's IP (the address to which the connection arrived)
                                                                 String (*telnetCommandHandlerCallback) (int argc, char *argv  [], telnetConnection_t *tcn)  // telnetCommandHandlerCallback function provided by calling program
                                                         );
 
+                                // connections are taken from the pool preallocated by the server
+                                static void *operator new (size_t size, const std::nothrow_t&) noexcept { return __pool__.allocate (size); }
+                                static void operator delete (void *p) { __pool__.free (p); }
+                                static void operator delete (void *p, const std::nothrow_t&) noexcept { __pool__.free (p); }
+
                                 inline char *getUserName ();
                                 #ifdef __THREAD_SAFE_FS__
                                         inline char *getHomeDirectory ();
@@ -447,6 +469,10 @@
                                 #if TELNET_DMESG_COMMAND == 1
                                         const char *__dmesg__ (bool follow, bool trueTime);
                                 #endif
+                                #if TELNET_SYSCTL_COMMAND == 1
+                                        const char *__sysctl__ ();
+                                        Cstring<300> __sysctl__ (char *nameOrAssignment);
+                                #endif
                                 #if TELNET_QUIT_COMMAND == 1
                                         const char *__quit__ ();
                                 #endif
@@ -476,6 +502,9 @@
                                 #if TELNET_NETSTAT_COMMAND == 1
                                         const char *__netstat__ (unsigned long delaySeconds);
                                 #endif
+                                #if TELNET_IFTOP_COMMAND == 1
+                                        const char *__iftop__ (unsigned long delaySeconds);
+                                #endif
                                 #if TELNET_KILL_COMMAND == 1
                                         Cstring<300> __kill__ (int sockfd);
                                 #endif
@@ -533,7 +562,7 @@
                                                 Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password) = NULL,
                                                 String (*telnetCommandHandlerCallback) (int argc, char *argv [], telnetConnection_t *tcn) = NULL,       // telnetCommadHandlerCallback function provided by calling program
                                                 int serverPort = 23,                                                                                    // Telnet server port
-                                                bool (*firewallCallback) (char *clientIP, char *serverIP) = NULL,                                       // a reference to callback function that will be celled when new connection arrives 
+                                                bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL,   // a reference to callback function that will be celled when new connection arrives 
                                                 bool runListenerInItsOwnTask = true                                                                     // a calling program may repeatedly call accept itself to save some memory tat listener task would use
                                         );
                         #endif
@@ -541,16 +570,21 @@
                                 telnetServer_t (Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password) = NULL,
                                                 String (*telnetCommandHandlerCallback) (int argc, char *argv [], telnetConnection_t *tcn) = NULL,       // telnetCommadHandlerCallback function provided by calling program
                                                 int serverPort = 23,                                                                                    // Telnet server port
-                                                bool (*firewallCallback) (char *clientIP, char *serverIP) = NULL,                                       // a reference to callback function that will be celled when new connection arrives 
+                                                bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL,   // a reference to callback function that will be celled when new connection arrives 
                                                 bool runListenerInItsOwnTask = true                                                                     // a calling program may repeatedly call accept itself to save some memory tat listener task would use
                                         );
 
+                                ~telnetServer_t ();
 
-                                        tcpConnection_t *__createConnectionInstance__ (int connectionSocket, char *clientIP, char *serverIP) override;
+
+                                        tcpConnection_t *__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) override;
 
                                         // accept any connection, the client will get notified in __createConnectionInstance__
                                         inline tcpConnection_t *accept () __attribute__((always_inline)) { return tcpServer_t::accept (); }                                       
 
+                                        // connection pool (shared by all Telnet servers) statistics
+                                        static inline objectPool_t& getConnectionPool () __attribute__((always_inline)) { return telnetConnection_t::__pool__; }
+
         };
 
 
@@ -558,15 +592,16 @@
 
         // static member initialization
         UBaseType_t telnetServer_t::telnetConnection_t::__lastHighWaterMark__ = TELNET_CONNECTION_STACK_SIZE;
+        objectPool_t telnetServer_t::telnetConnection_t::__pool__;
 
         #ifdef __THREAD_SAFE_FS__
                 telnetServer_t::telnetConnection_t::telnetConnection_t (threadSafeFS::FS& fileSystem,
                                                                         Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password),
                                                                         int connectionSocket,
-                                                                        char *clientIP,
-                                                                        char *serverIP,
+                                                                        const ipAddress_t& clientAddress,
+                                                                        const ipAddress_t& serverAddress,
                                                                         String (*telnetCommandHandlerCallback) (int argc, char *argv  [], telnetConnection_t *tcn)
-                                                                ) : tcpConnection_t (connectionSocket, clientIP, serverIP),
+                                                                ) : tcpConnection_t (connectionSocket, clientAddress, serverAddress),
                                                                     __fileSystem__ (&fileSystem),
                                                                     __getUserHomeDirectory__ (getUserHomeDirectory),
                                                                     __telnetCommandHandlerCallback__ (telnetCommandHandlerCallback) {
@@ -575,10 +610,10 @@
 
                 telnetServer_t::telnetConnection_t::telnetConnection_t (Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password),
                                                                         int connectionSocket,
-                                                                        char *clientIP,
-                                                                        char *serverIP,
+                                                                        const ipAddress_t& clientAddress,
+                                                                        const ipAddress_t& serverAddress,
                                                                         String (*telnetCommandHandlerCallback) (int argc, char *argv [], telnetConnection_t *tcn)
-                                                                ) : tcpConnection_t (connectionSocket, clientIP, serverIP),
+                                                                ) : tcpConnection_t (connectionSocket, clientAddress, serverAddress),
                                                                         __getUserHomeDirectory__ (getUserHomeDirectory),
                                                                         __telnetCommandHandlerCallback__ (telnetCommandHandlerCallback) {
                 }
@@ -764,7 +799,7 @@
                 if (__getUserHomeDirectory__ == NULL) { // if no user management
 
                         // tell the client to go into character mode, not to echo and send back its window size, then say hello 
-                        sprintf (__cmdLine__, IAC WILL ECHO IAC WILL SUPPRESS_GO_AHEAD IAC DO NAWS HOSTNAME " says hello to %s.\r\n", getClientIP ());
+                        sprintf (__cmdLine__, IAC WILL ECHO IAC WILL SUPPRESS_GO_AHEAD IAC DO NAWS HOSTNAME " says hello to %s.\r\n", getClientIP ().c_str ());
                         if (sendString (__cmdLine__) <= 0)
                                 return;
 
@@ -778,7 +813,7 @@
 
                 } else {
 
-                        sprintf (__cmdLine__, IAC WILL ECHO IAC WILL SUPPRESS_GO_AHEAD IAC DO NAWS HOSTNAME " says hello to %s, please login.\r\nuser: ", getClientIP ());
+                        sprintf (__cmdLine__, IAC WILL ECHO IAC WILL SUPPRESS_GO_AHEAD IAC DO NAWS HOSTNAME " says hello to %s, please login.\r\nuser: ", getClientIP ().c_str ());
                         if (sendString (__cmdLine__) <= 0) 
                                 return;
                         if (recvLine (__userName__, 64) != 13)
@@ -996,6 +1031,31 @@
                                                                 }
                 #endif
 
+                #if TELNET_SYSCTL_COMMAND == 1
+                        else if (telnetArgv0Is ("sysctl"))      {
+                                                                        if (argc == 1 || (argc == 2 && telnetArgv1Is ("-a")))   return __sysctl__ ();
+                                                                        if (argc == 2 && *argv [1] != '-' && !strchr (argv [1], '=')) return __sysctl__ (argv [1]);
+                                                                        if (strcmp (__userName__, "root"))                      return "Only root may change tuning parameters";
+                                                                        if (argc == 2 && *argv [1] != '-')                      return __sysctl__ (argv [1]);
+                                                                        if (argc == 3 && telnetArgv1Is ("-w"))                  return __sysctl__ (argv [2]);
+                                                                        #ifdef __THREAD_SAFE_FS__
+                                                                                if (argc == 2 && (telnetArgv1Is ("-p") || telnetArgv1Is ("-s"))) {
+                                                                                        if (!__fileSystem__)                            return "Error, file system was not passed to the Telnet server constructor";
+                                                                                        if (!__fileSystem__->mounted ())                return "File system not mounted. You may have to format flash disk first";
+                                                                                }
+                                                                                if (argc == 2 && telnetArgv1Is ("-p")) {
+                                                                                        int n = loadTunables (*__fileSystem__);
+                                                                                        if (n < 0)                                      return "Can't read " TUNABLES_CONFIGURATION_FILE;
+                                                                                                                                        return Cstring<300> (n) + " value(s) set from " TUNABLES_CONFIGURATION_FILE;
+                                                                                }
+                                                                                if (argc == 2 && telnetArgv1Is ("-s"))          return saveTunables (*__fileSystem__) ? "Saved to " TUNABLES_CONFIGURATION_FILE : "Can't write " TUNABLES_CONFIGURATION_FILE;
+                                                                                                                                return "Wrong syntax, use sysctl [-a] | <name> | [-w] <name>=<value> | -p | -s";
+                                                                        #else
+                                                                                                                                return "Wrong syntax, use sysctl [-a] | <name> | [-w] <name>=<value>";
+                                                                        #endif
+                                                                }
+                #endif
+
                 #if TELNET_QUIT_COMMAND == 1                                                  
                         else if (telnetArgv0Is ("quit"))        { return argc == 1 ? __quit__ () : "Wrong syntax, use quit"; }
                 #endif
@@ -1062,6 +1122,16 @@
                                                                 }
                 #endif
 
+                #if TELNET_IFTOP_COMMAND == 1
+                        else if (telnetArgv0Is ("iftop"))       {
+                                                                        if (argc == 1)                                          return __iftop__ (0);
+                                                                        if (argc == 2) {
+                                                                                int n = atoi (argv [1]); if (n > 0 && n < 3600) return __iftop__ (n);
+                                                                        }
+                                                                                                                                return "Wrong syntax, use iftop [<n>]   (where 0 < n <= 3600)";
+                                                                }
+                #endif
+
                 #if TELNET_KILL_COMMAND == 1
                         else if (telnetArgv0Is ("kill"))        { 
                                                                         if (!strcmp (__userName__, "root")) {
@@ -1200,26 +1270,37 @@
                                                 Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password),
                                                 String (*telnetCommandHandlerCallback) (int argc, char *argv [], telnetConnection_t *tcn),
                                                 int serverPort,
-                                                bool (*firewallCallback) (char *clientIP, char *serverIP),
+                                                bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress),
                                                 bool runListenerInItsOwnTask
                                         ) : tcpServer_t (serverPort, firewallCallback, runListenerInItsOwnTask),
                                             __fileSystem__ (&fileSystem),
                                             __getUserHomeDirectory__ (getUserHomeDirectory),
                                             __telnetCommandHandlerCallback__ (telnetCommandHandlerCallback) {
+                        setKeepAlive (); // reclaim sessions of vanished clients long before TELNET_CONNECTION_TIME_OUT
+                        setSocketOptions (socketOptions_t::interactive ());
+                        telnetConnection_t::__pool__.begin (sizeof (telnetConnection_t), TELNET_CONNECTION_POOL_SIZE, CONNECTION_POOLS_IN_PSRAM);
                 }
         #endif
 
                 telnetServer_t::telnetServer_t (Cstring<255> (*getUserHomeDirectory) (const Cstring<64>& userName, const Cstring<64>& password),
                                                 String (*telnetCommandHandlerCallback) (int argc, char *argv [], telnetConnection_t *tcn),
                                                 int serverPort,
-                                                bool (*firewallCallback) (char *clientIP, char *serverIP),
+                                                bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress),
                                                 bool runListenerInItsOwnTask
                                         ) : tcpServer_t (serverPort, firewallCallback, runListenerInItsOwnTask),
                                                 __getUserHomeDirectory__ (getUserHomeDirectory),
                                                 __telnetCommandHandlerCallback__ (telnetCommandHandlerCallback) {
+                        setKeepAlive (); // reclaim sessions of vanished clients long before TELNET_CONNECTION_TIME_OUT
+                        setSocketOptions (socketOptions_t::interactive ());
+                        telnetConnection_t::__pool__.begin (sizeof (telnetConnection_t), TELNET_CONNECTION_POOL_SIZE, CONNECTION_POOLS_IN_PSRAM);
                 }
 
-        tcpConnection_t *telnetServer_t::__createConnectionInstance__ (int connectionSocket, char *clientIP, char *serverIP) {
+                telnetServer_t::~telnetServer_t () {
+                        // the listener must not call __createConnectionInstance__ while telnetServer_t's members are being destroyed
+                        __unregisterFromListener__ ();
+                }
+
+        tcpConnection_t *telnetServer_t::__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) {
                 #define telnetServiceUnavailableReply "Telnet service is currently unavailable.\r\nFree heap: %lu bytes\r\nFree heap in one piece: %u bytes\r\n"
 
                 telnetConnection_t *connection;
@@ -1229,20 +1310,20 @@
                                 connection = new (std::nothrow) telnetConnection_t (    *__fileSystem__, 
                                                                                         __getUserHomeDirectory__, 
                                                                                         connectionSocket, 
-                                                                                        clientIP, 
-                                                                                        serverIP, 
+                                                                                        clientAddress, 
+                                                                                        serverAddress, 
                                                                                         __telnetCommandHandlerCallback__);                                                                      
                         else
                                 connection = new (std::nothrow) telnetConnection_t (    __getUserHomeDirectory__, 
                                                                                         connectionSocket, 
-                                                                                        clientIP, 
-                                                                                        serverIP, 
+                                                                                        clientAddress, 
+                                                                                        serverAddress, 
                                                                                         __telnetCommandHandlerCallback__);
                 #else
                                 connection = new (std::nothrow) telnetConnection_t (    __getUserHomeDirectory__, 
                                                                                         connectionSocket, 
-                                                                                        clientIP, 
-                                                                                        serverIP, 
+                                                                                        clientAddress, 
+                                                                                        serverAddress, 
                                                                                         __telnetCommandHandlerCallback__);
                 #endif
 
@@ -1255,7 +1336,8 @@
                         return NULL;
                 }
 
-                connection->setIdleTimeout (TELNET_CONNECTION_TIME_OUT);
+                connection->setIdleTimeout (telnetConnectionTimeOut);
+                connection->setServerBandwidthLimit (&getBandwidthLimit ());
 
                 #define tskNORMAL_PRIORITY (tskIDLE_PRIORITY + 1)
                 if (pdPASS != xTaskCreate ([] (void *thisInstance) {
@@ -1273,7 +1355,7 @@
                                                                         delete ths;
                                                                         vTaskDelete (NULL); // it is connection's responsibility to close itself
                                                                    }
-                                                , "telnetConn", TELNET_CONNECTION_STACK_SIZE, connection, tskNORMAL_PRIORITY, NULL)) {
+                                                , "telnetConn", telnetConnectionStackSize, connection, tskNORMAL_PRIORITY, NULL)) {
                         cout << ( dmesgQueue << "[telnetServer] " << "can't create connection task, out of memory" );
 
                         char s [128];
@@ -1315,6 +1397,13 @@
                                                 #if TELNET_DMESG_COMMAND == 1
                                                         "\r\n      dmesg [-follow] [-time]"
                                                 #endif
+                                                #if TELNET_SYSCTL_COMMAND == 1
+                                                        #ifdef __THREAD_SAFE_FS__
+                                                                "\r\n      sysctl [-a] | <name> | [-w] <name>=<value> | -p | -s   (-p loads, -s saves " TUNABLES_CONFIGURATION_FILE ")"
+                                                        #else
+                                                                "\r\n      sysctl [-a] | <name> | [-w] <name>=<value>"
+                                                        #endif
+                                                #endif
                                                 #if TELNET_QUIT_COMMAND == 1
                                                         "\r\n      quit"
                                                 #endif
@@ -1348,6 +1437,9 @@
                                                 #if TELNET_NETSTAT_COMMAND == 1
                                                         "\r\n      netstat [<n>]   (where 0 < n <= 3600)"
                                                 #endif
+                                                #if TELNET_IFTOP_COMMAND == 1
+                                                        "\r\n      iftop [<n>]     (where 0 < n <= 3600)"
+                                                #endif
                                                 #if TELNET_KILL_COMMAND == 1
                                                         "\r\n      kill <socket>   (where socket is a valid socket)"
                                                 #endif
@@ -1565,6 +1657,34 @@
                 }
         #endif
 
+        #if TELNET_SYSCTL_COMMAND == 1
+                const char *telnetServer_t::telnetConnection_t::__sysctl__ () {
+                        char buf [200];
+                        for (tunable_t *t = tunable_t::first (); t; t = t->next ()) {
+                                sprintf (buf, "%-36s = %7li %-5s (default %li, range %li ... %li)\r\n", t->getName (), t->get (), t->getUnit (), t->getDefault (), t->getMin (), t->getMax ());
+                                if (sendString (buf) <= 0)
+                                        return "\r";
+                        }
+                        return "\r"; // different than "" to let the calling function know that the command has been processed
+                }
+
+                Cstring<300> telnetServer_t::telnetConnection_t::__sysctl__ (char *nameOrAssignment) {
+                        char *value = strchr (nameOrAssignment, '=');
+                        if (value)
+                                *value++ = 0;
+                        tunable_t *t = tunable_t::find (nameOrAssignment);
+                        if (!t)
+                                return Cstring<300> ("Unknown tuning parameter ") + nameOrAssignment;
+                        if (value) {
+                                char *endOfNumber;
+                                long l = strtol (value, &endOfNumber, 10);
+                                if (!*value || *endOfNumber || !t->set (l))
+                                        return Cstring<300> ("Wrong value, ") + t->getName () + " range is " + Cstring<300> (t->getMin ()) + " ... " + Cstring<300> (t->getMax ());
+                        }
+                        return Cstring<300> (t->getName ()) + " = " + Cstring<300> (t->get ()) + " " + t->getUnit ();
+                }
+        #endif
+
         #if TELNET_QUIT_COMMAND == 1
                 const char *telnetServer_t::telnetConnection_t::__quit__ () {
                         close ();
@@ -1877,7 +1997,7 @@
                         networkTraffic_t netTraff = networkTraffic ();
                         networkTraffic_t lastNetTraff = {};
 
-                        char buf [300]; 
+                        char buf [400]; // socket's row and its bandwidth row
                         do {
                                 // clear screen
                                 if (delaySeconds) 
@@ -1890,6 +2010,12 @@
                                 if (sendString (buf) <= 0) 
                                         return "\r";
 
+                                // display global bandwidth limit: actual / configured rate (0 = unlimited)
+                                sprintf (buf, "bandwidth [B/s], actual/limit:  received %lu/%lu, sent %lu/%lu\r\n", globalBandwidthLimit ().recv.getActualRate (), globalBandwidthLimit ().recv.getRate (), 
+                                                                                                                       globalBandwidthLimit ().send.getActualRate (), globalBandwidthLimit ().send.getRate ());
+                                if (sendString (buf) <= 0) 
+                                        return "\r";
+
                                 // display header
                                 sprintf (buf, "\r\n"
                                                 "sck local address                           port remote address                          port  received      sent\r\n"
@@ -1897,78 +2023,54 @@
                                 if (sendString (buf) <= 0) 
                                         return "\r";
 
-                                // scan through sockets
-                                for (int sockfd = LWIP_SOCKET_OFFSET; sockfd < LWIP_SOCKET_OFFSET + MEMP_NUM_NETCONN; sockfd ++) { // socket numbers are within this range
-                                        // get socket type
-                                        int type;
-                                        socklen_t length = sizeof (type);
-                                        xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-                                                int i = getsockopt (sockfd, SOL_SOCKET, SO_TYPE, &type, &length);
-                                        xSemaphoreGive (getLwIpMutex ());
-                                        if (i == -1 || type != SOCK_STREAM)
-                                                continue; // skip SOCK_DGRAM socket
-
-                                        // get server's IP address
-                                        char thisIP [INET6_ADDRSTRLEN] = ""; 
-                                        int thisPort = 0;
-                                        char remoteIP [INET6_ADDRSTRLEN] = "";
-                                        int remotePort = 0;
-
-                                        struct sockaddr_storage addr = {}; 
-                                        socklen_t len = sizeof (addr);
+                                // scan through socket registry, one entry at a time under LwIpMutex, which is not held while sending
+                                for (int sockfd = LWIP_SOCKET_OFFSET; sockfd < LWIP_SOCKET_OFFSET + MEMP_NUM_NETCONN; sockfd ++) {
                                         xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-                                        i = getsockname (sockfd, (struct sockaddr *) &addr, &len);
-                                        xSemaphoreGive (getLwIpMutex ());
-                                        if (i != -1) {
-                                                struct sockaddr_in6* s = (struct sockaddr_in6 *) &addr; 
-                                                inet_ntop (AF_INET6, &s->sin6_addr, thisIP, sizeof (thisIP));
-                                                // this works fine when the connection is IPv6, but when it is a 
-                                                // IPv4 connection we are getting IPv6 representation of IPv4 address like "::FFFF:10.18.1.140"
-                                                if (strstr (thisIP, ".")) {
-                                                        char *p = thisIP;
-                                                        for (char *q = p; *q; q++)
-                                                        if (*q == ':')
-                                                                p = q;
-                                                        if (p != thisIP)
-                                                        strcpy (thisIP, p + 1);
-                                                }
-                                                thisPort = ntohs (s->sin6_port);
-
-                                                // get client's IP address
-                                                addr = {}; 
-                                                // len = sizeof (addr);
-                                                xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-                                                        i = getpeername (sockfd, (struct sockaddr *) &addr, &len);
-                                                xSemaphoreGive (getLwIpMutex ());
-                                                if (i != -1) {
-                                                        struct sockaddr_in6* s = (struct sockaddr_in6 *) &addr; 
-                                                        inet_ntop (AF_INET6, &s->sin6_addr, remoteIP, sizeof (remoteIP));
-                                                        // this works fine when the connection is IPv6, but when it is a 
-                                                        // IPv4 connection we are getting something like "::FFFF:10.18.1.140"
-                                                        if (strstr (remoteIP, ".")) {
-                                                        char *p = remoteIP;
-                                                        for (char *q = p; *q; q++)
-                                                                if (*q == ':')
-                                                                p = q;
-                                                        if (p != remoteIP)
-                                                                strcpy (remoteIP, p + 1);
+                                                socketRegistryEntry_t& entry = socketRegistry () [sockfd];
+                                                if (!entry.connection) {
+                                                        // not used by tcpConnection_t (listening and UDP sockets or the calling program's own ones), probe lwIP to see if it is opened at all
+                                                        struct sockaddr_storage addr = {};
+                                                        socklen_t len = sizeof (addr);
+                                                        if (getsockname (sockfd, (struct sockaddr *) &addr, &len) == -1) {
+                                                                xSemaphoreGive (getLwIpMutex ());
+                                                                continue; // not opened
                                                         }
-                                                        remotePort = ntohs (s->sin6_port);
-                                                } 
-
-                                                if (*thisIP && *remoteIP) {
-                                                        sprintf (buf, "\r\n %2i %-39s%5i %-39s%5i %9lu %9lu", sockfd, thisIP, thisPort, remoteIP, remotePort, netTraff [sockfd].bytesReceived - lastNetTraff [sockfd].bytesReceived, netTraff [sockfd].bytesSent - lastNetTraff [sockfd].bytesSent);
+                                                        ipAddress_t localAddress ((struct sockaddr *) &addr);
+                                                        int localPort = ntohs (((struct sockaddr_in *) &addr)->sin_port); // sin_port and sin6_port are at the same place
+                                                        ipAddress_t remoteAddress;
+                                                        int remotePort = 0;
+                                                        addr = {};
+                                                        len = sizeof (addr);
+                                                        if (getpeername (sockfd, (struct sockaddr *) &addr, &len) != -1) {
+                                                                remoteAddress = ipAddress_t ((struct sockaddr *) &addr);
+                                                                remotePort = ntohs (((struct sockaddr_in *) &addr)->sin_port);
+                                                        }
+                                                        sprintf (buf, "\r\n %2i %-39s%5i %-39s%5i %9lu %9lu", sockfd, localAddress.toString ().c_str (), localPort, remoteAddress.toString ().c_str (), remotePort, netTraff [sockfd].bytesReceived - lastNetTraff [sockfd].bytesReceived, netTraff [sockfd].bytesSent - lastNetTraff [sockfd].bytesSent);
+                                                        xSemaphoreGive (getLwIpMutex ());
                                                         if (sendString (buf) <= 0) 
-                                                        return "\r";
-
-                                                        // update variables for delta calculation
-                                                        lastNetTraff = netTraff;
-                                                        netTraff = networkTraffic ();
+                                                                return "\r";
+                                                        continue;
                                                 }
-                                        
-                                        } // getsockname
+                                                entry.fillEndpoints (sockfd);
+                                                sprintf (buf, "\r\n %2i %-39s%5i %-39s%5i %9lu %9lu", sockfd, entry.localAddress.toString ().c_str (), entry.localPort, entry.remoteAddress.toString ().c_str (), entry.remotePort, netTraff [sockfd].bytesReceived - lastNetTraff [sockfd].bytesReceived, netTraff [sockfd].bytesSent - lastNetTraff [sockfd].bytesSent);
+
+                                                // connection's and its server's bandwidth: actual / configured rate (0 = unlimited), the connection can't go away while LwIpMutex is held
+                                                bandwidthLimit_t& connectionLimit = entry.connection->getBandwidthLimit ();
+                                                sprintf (buf + strlen (buf), "\r\n    bandwidth [B/s], actual/limit:  connection received %lu/%lu, sent %lu/%lu", connectionLimit.recv.getActualRate (), connectionLimit.recv.getRate (), 
+                                                                                                                                                   connectionLimit.send.getActualRate (), connectionLimit.send.getRate ());
+                                                bandwidthLimit_t *serverLimit = entry.connection->getServerBandwidthLimit ();
+                                                if (serverLimit)
+                                                        sprintf (buf + strlen (buf), ", server received %lu/%lu, sent %lu/%lu", serverLimit->recv.getActualRate (), serverLimit->recv.getRate (), 
+                                                                                                                                 serverLimit->send.getActualRate (), serverLimit->send.getRate ());
+                                        xSemaphoreGive (getLwIpMutex ());
+                                        if (sendString (buf) <= 0) 
+                                                return "\r";
                                 } // for
 
+                                // update variables for delta calculation
+                                lastNetTraff = netTraff;
+                                netTraff = networkTraffic ();
+
                                 // wait for a key press
                                 unsigned long startMillis = millis ();
                                 while (millis () - startMillis < (delaySeconds * 1000)) {
@@ -1983,13 +2085,57 @@
                 }
         #endif
 
+        #if TELNET_IFTOP_COMMAND == 1
+                const char *telnetServer_t::telnetConnection_t::__iftop__ (unsigned long delaySeconds) {
+                        char buf [200];
+                        do {
+                                // clear screen
+                                if (delaySeconds)
+                                        if (sendString ("\x1b[2J") <= 0)
+                                        return "\r";
+
+                                // take a copy of the table, open connections add their traffic to it while they transfer data
+                                topTalker_t talkers [TOP_TALKERS_TABLE_SIZE];
+                                int count = topTalkers ().copy (talkers, TOP_TALKERS_TABLE_SIZE);
+
+                                // display the table
+                                if (sendString ("remote address                          connections       received           sent       (error) last seen\r\n") <= 0)
+                                        return "\r";
+                                if (sendString ("--------------------------------------------------------------------------------------------------------") <= 0)
+                                        return "\r";
+                                unsigned long now = millis ();
+                                for (int i = 0; i < count; i++) {
+                                        sprintf (buf, "\r\n%-39s %11lu %14llu %14llu %13llu %6lus ago", talkers [i].address.toString ().c_str (), talkers [i].connections, talkers [i].bytesReceived, talkers [i].bytesSent, talkers [i].error, (now - talkers [i].lastSeen) / 1000);
+                                        if (sendString (buf) <= 0)
+                                                return "\r";
+                                }
+
+                                // wait for a key press
+                                unsigned long startMillis = millis ();
+                                while (millis () - startMillis < (delaySeconds * 1000)) {
+                                        delay (100);
+                                        if (peekChar ()) {
+                                                recvChar (); // read pending character
+                                                return "\r"; // return if user pressed Ctrl-C or any key
+                                        }
+                                }
+                        } while (delaySeconds);
+                        return "\r"; // different than "" to let the calling function know that the command has been processed
+                }
+        #endif
+
         #if TELNET_KILL_COMMAND == 1
                 Cstring<300> telnetServer_t::telnetConnection_t::__kill__ (int sockfd) {
+                        // shut the connection down and let the task that owns it close the socket, so that it doesn't use already closed (and maybe reused) socket number
                         xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
-                                int i = ::close (sockfd);
+                                if (!socketRegistry () [sockfd].connection) {
+                                        xSemaphoreGive (getLwIpMutex ());
+                                        return "Socket is not used by a TCP connection";
+                                }
+                                int i = shutdown (sockfd, SHUT_RDWR);
                         xSemaphoreGive (getLwIpMutex ());
                         if (i < 0) {
-                                dmesgQueue << "[telnetConn] close error: " << errno << " " << strerror (errno);
+                                dmesgQueue << "[telnetConn] shutdown error: " << errno << " " << strerror (errno);
                                 return Cstring<300> ("Error: ") + Cstring<300> (errno) + " " + strerror (errno);
                         }
                         return "Socked closed";
@@ -2045,15 +2191,12 @@
                         }
                         d.close ();
                         */
-                        bool firstRecord = true;
-                        for (auto f : __fileSystem__->open (fullPath)) {
-                                Cstring<255> fullFileName = fullPath;
-                                if (fullFileName [fullFileName.length () - 1] != '/') fullFileName += '/'; fullFileName += f.name ();
-                                        if (sendString (firstRecord ? __fileSystem__->fileInformation (fullFileName) : Cstring<300> ("\r\n") + __fileSystem__->fileInformation (fullFileName)) <= 0) { 
-                                        return "\r"; 
-                                }
-                                firstRecord = false;
-                        }                        
+                        // the same listing as FTP LIST, from the file system's cache if possible
+                        threadSafeFS::DirectoryListing listing = __fileSystem__->listDirectory (fullPath);
+                        if (!listing)
+                                return "Out of memory";
+                        if (listing.length () > 2)
+                                sendBlock ((void *) listing.c_str (), listing.length () - 2); // without the last \r\n
                         return "\r"; // different than "" to let the calling function know that the command has been processed
                 }
         #endif
@@ -2713,7 +2856,27 @@
                                         s = "\r\n   ";
                                 }
                         }
+                        bool anyOutput = __fileSystem__->readOpenedFiles.size () || __fileSystem__->writeOpenedFiles.size ();
                         xSemaphoreGive (getFsMutex ());
+
+                        // directory listing cache (ls, FTP LIST)
+                        unsigned long hits = __fileSystem__->getListingCacheHits ();
+                        unsigned long misses = __fileSystem__->getListingCacheMisses ();
+                        if (hits + misses) {
+                                char c [150];
+                                sprintf (c, "%sDirectory listing cache: %lu hits, %lu misses (%lu %% hit rate), %lu ms per directory read on a miss", anyOutput ? "\r\n" : "", hits, misses, hits * 100 / (hits + misses), misses ? __fileSystem__->getListingMillis () / misses : 0);
+                                sendString (c);
+                                anyOutput = true;
+                        }
+
+                        // file metadata cache (FTP SIZE, MDTM)
+                        hits = __fileSystem__->getMetadataCacheHits ();
+                        misses = __fileSystem__->getMetadataCacheMisses ();
+                        if (hits + misses) {
+                                char c [100];
+                                sprintf (c, "%sFile metadata cache: %lu hits, %lu misses (%lu %% hit rate)", anyOutput ? "\r\n" : "", hits, misses, hits * 100 / (hits + misses));
+                                sendString (c);
+                        }
                         return "\r";
                 }
         #endif
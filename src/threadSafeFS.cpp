@@ -16,6 +16,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <utime.h>
 #include <algorithm.hpp>
 
 
@@ -168,6 +169,7 @@ void threadSafeFS::File::close () {
     } else {
         it = ::find (__threadSafeFileSystem__->writeOpenedFiles.begin (), __threadSafeFileSystem__->writeOpenedFiles.end (), __file__->path ());
         __threadSafeFileSystem__->writeOpenedFiles.erase (it); // file opened in write mode
+        __threadSafeFileSystem__->__invalidateCaches__ (__file__->path ()); // size and time have changed
     }
 
     __file__->close ();
@@ -193,7 +195,7 @@ threadSafeFS::File threadSafeFS::File::openNextFile (const char* mode) {
         xSemaphoreGive (getFsMutex ());
         return threadSafeFS::File ();   // invalid
     }  
-    if (strchr (mode, 'w') || strchr (mode, 'a')) { // open for writing
+    if (strchr (mode, 'w') || strchr (mode, 'a') || strchr (mode, '+')) { // open for writing ("r+" as well)
         if (__threadSafeFileSystem__->writeOpenedFiles.push_front (f.path ())) { // couldn't update writeOpenedFiles list
             f.close (); 
             xSemaphoreGive (getFsMutex ());
@@ -373,14 +375,17 @@ threadSafeFS::File::Iterator threadSafeFS::File::end () {
 
 // FS implementation
 
-threadSafeFS::FS::FS (fs::FS& fileSystem) : __fileSystem__ (fileSystem) {}
+threadSafeFS::FS::FS (fs::FS& fileSystem, const char* mountPoint) : __fileSystem__ (fileSystem) {
+    if (mountPoint)
+        __mountPoint__ = mountPoint;
+}
 
 threadSafeFS::File threadSafeFS::FS::open (const char* path, const char* mode) {
     Cstring<255> fullPath = "/"; if (*path == '/') fullPath = path; else fullPath += path;
     xSemaphoreTake (getFsMutex (), portMAX_DELAY);
 
     // test first
-    if (strchr (mode, 'w') || strchr (mode, 'a')) { // open for writing
+    if (strchr (mode, 'w') || strchr (mode, 'a') || strchr (mode, '+')) { // open for writing ("r+" as well)
         if (find (readOpenedFiles.begin (), readOpenedFiles.end (), fullPath) != readOpenedFiles.end () // file already opened in read mode
                 ||
             find (writeOpenedFiles.begin (), writeOpenedFiles.end (), fullPath) != writeOpenedFiles.end () // file already opened in write mode
@@ -402,12 +407,13 @@ threadSafeFS::File threadSafeFS::FS::open (const char* path, const char* mode) {
         return threadSafeFS::File ();   // invalid
     }  
 
-    if (strchr (mode, 'w') || strchr (mode, 'a')) { // open for writing
+    if (strchr (mode, 'w') || strchr (mode, 'a') || strchr (mode, '+')) { // open for writing ("r+" as well)
         if (writeOpenedFiles.push_front (f.path ())) { // couldn't update writeOpenedFiles list
                 f.close (); 
                 xSemaphoreGive (getFsMutex ());
                 return threadSafeFS::File ();   // invalid                
             }
+        __invalidateCaches__ (f.path ()); // the file may have just been created
     } else if (strchr (mode, 'r')) { // open for reading
         if (readOpenedFiles.push_front (f.path ())) { // couldn't update readOpenedFiles list
                 f.close ();
@@ -438,6 +444,7 @@ bool threadSafeFS::FS::exists (const String& path) {
 bool threadSafeFS::FS::remove (const char* path) {
     xSemaphoreTake (getFsMutex (), portMAX_DELAY);
     bool b = __fileSystem__.remove (path);
+    __invalidateCaches__ (path);
     xSemaphoreGive (getFsMutex ());
     return b;
 }
@@ -449,6 +456,8 @@ bool threadSafeFS::FS::remove (const String& path) {
 bool threadSafeFS::FS::rename (const char* from, const char* to) {
     xSemaphoreTake (getFsMutex (), portMAX_DELAY);
     bool b = __fileSystem__.rename (from, to);
+    __invalidateCaches__ (from);
+    __invalidateCaches__ (to);
     xSemaphoreGive (getFsMutex ());
     return b;
 }
@@ -460,6 +469,7 @@ bool threadSafeFS::FS::rename (const String& from, const String& to) {
 bool threadSafeFS::FS::mkdir (const char* path) {
     xSemaphoreTake (getFsMutex (), portMAX_DELAY);
     bool b = __fileSystem__.mkdir (path);
+    __invalidateCaches__ (path);
     xSemaphoreGive (getFsMutex ());
     return b;
 }
@@ -471,6 +481,7 @@ bool threadSafeFS::FS::mkdir (const String& path) {
 bool threadSafeFS::FS::rmdir (const char* path) {
     xSemaphoreTake (getFsMutex (), portMAX_DELAY);
     bool b = __fileSystem__.rmdir (path);
+    __invalidateCaches__ (path);
     xSemaphoreGive (getFsMutex ());
     return b;
 }
@@ -578,28 +589,319 @@ bool threadSafeFS::FS::userHasRightToAccessDirectory (Cstring<255> fullPath, Cst
 
 // returns UNIX like text with file information - this is what FTP clients expect
 Cstring<300> threadSafeFS::FS::fileInformation (const char *fileOrDirectory, bool showFullPath) {
+    File f = open (fileOrDirectory, FILE_READ);
+    return fileInformation (f, showFullPath || !strcmp (fileOrDirectory, "/") ? fileOrDirectory : NULL);
+}
+
+Cstring<300> threadSafeFS::FS::fileInformation (File& f, const char *displayedName) {
     Cstring<300> s;
+    if (!f) return s;
+    struct tm fTime = {};
+    time_t lTime = f.getLastWrite ();
+    localtime_r (&lTime, &fTime);
+    sprintf (s, "%crw-rw-rw-   1 root     root          %7u ", f.isDirectory () ? 'd' : '-', f.size ());
+    strftime ((char *) s.c_str () + strlen (s.c_str ()), 25, " %b %d %H:%M      ", &fTime);
+    if (displayedName)
+        s += displayedName;
+    else
+        s += f.name ();
+    return s;
+}
+
+// directory listing cache
+
+threadSafeFS::DirectoryListing::DirectoryListing (__text_t__ *text) : __text__ (text) {
+    __text__->refCount = 1;
+}
+
+threadSafeFS::DirectoryListing::DirectoryListing (const DirectoryListing& other) : __text__ (other.__text__) {
+    if (__text__)
+        __atomic_add_fetch (&__text__->refCount, 1, __ATOMIC_ACQ_REL);
+}
+
+threadSafeFS::DirectoryListing& threadSafeFS::DirectoryListing::operator = (const DirectoryListing& other) {
+    if (__text__ != other.__text__) {
+        __release__ ();
+        __text__ = other.__text__;
+        if (__text__)
+            __atomic_add_fetch (&__text__->refCount, 1, __ATOMIC_ACQ_REL);
+    }
+    return *this;
+}
+
+threadSafeFS::DirectoryListing::~DirectoryListing () {
+    __release__ ();
+}
+
+void threadSafeFS::DirectoryListing::__release__ () {
+    if (__text__ && __atomic_sub_fetch (&__text__->refCount, 1, __ATOMIC_ACQ_REL) == 0)
+        free (__text__);
+    __text__ = NULL;
+}
+
+// cache keys are full paths without the trailing /
+static Cstring<255> __listingKey__ (const char *path) {
+    Cstring<255> key = "/"; if (*path == '/') key = path; else key += path;
+    if (key.length () > 1 && key [key.length () - 1] == '/') key [key.length () - 1] = 0;
+    return key;
+}
+
+threadSafeFS::DirectoryListing threadSafeFS::FS::listDirectory (const char *fullPath) {
+    Cstring<255> key = __listingKey__ (fullPath);
+
+    // 1. try the cache
+    unsigned long generation;
     xSemaphoreTake (getFsMutex (), portMAX_DELAY);
-    fs::File f = __fileSystem__.open (fileOrDirectory, FILE_READ);
-    if (f) {
-        struct tm fTime = {};
-        time_t lTime = f.getLastWrite ();
-        localtime_r (&lTime, &fTime);
-        sprintf (s, "%crw-rw-rw-   1 root     root          %7u ", f.isDirectory () ? 'd' : '-', f.size ());
-        strftime ((char *) s.c_str () + strlen (s.c_str ()), 25, " %b %d %H:%M      ", &fTime);
-        if (showFullPath || !strcmp (fileOrDirectory, "/")) {
-            s += fileOrDirectory;
-        } else {
-            int lastSlash = 0;
-            for (int i = 1; fileOrDirectory [i]; i++)
-                if (fileOrDirectory [i] == '/') 
-                    lastSlash = i;
-            s += fileOrDirectory + lastSlash + 1;
+        for (int i = 0; i < DIRECTORY_LISTING_CACHE_ENTRIES; i++)
+            if (__listingCache__ [i].listing && __listingCache__ [i].path == key) {
+                __listingCache__ [i].lastUsed = millis ();
+                __listingCacheHits__ ++;
+                DirectoryListing listing = __listingCache__ [i].listing;
+                xSemaphoreGive (getFsMutex ());
+                return listing;
+            }
+        __listingCacheMisses__ ++;
+        generation = __cacheGeneration__;
+    xSemaphoreGive (getFsMutex ());
+
+    // 2. read the directory, the text grows as needed
+    unsigned long startMillis = millis ();
+    size_t capacity = 1024;
+    size_t length = 0;
+    DirectoryListing::__text_t__ *text = (DirectoryListing::__text_t__ *) malloc (sizeof (DirectoryListing::__text_t__) + capacity);
+    if (!text)
+        return DirectoryListing ();
+    for (auto f : open (key)) {
+        Cstring<300> line = fileInformation (f);
+        size_t lineLength = line.length ();
+        if (length + lineLength + 2 >= capacity) {
+            capacity = max (2 * capacity, length + lineLength + 3);
+            DirectoryListing::__text_t__ *newText = (DirectoryListing::__text_t__ *) realloc (text, sizeof (DirectoryListing::__text_t__) + capacity);
+            if (!newText) {
+                free (text);
+                return DirectoryListing ();
+            }
+            text = newText;
         }
-        f.close ();
+        memcpy (text->text + length, line.c_str (), lineLength);
+        memcpy (text->text + length + lineLength, "\r\n", 2);
+        length += lineLength + 2;
     }
+    text->text [length] = 0;
+    text->length = length;
+    DirectoryListing listing (text);
+    unsigned long listingMillis = millis () - startMillis;
+
+    // 3. cache it, unless something has changed while reading, a file in it is being written (its size keeps changing) or it is too large
+    xSemaphoreTake (getFsMutex (), portMAX_DELAY);
+        __listingMillis__ += listingMillis;
+        if (DIRECTORY_LISTING_CACHE_ENTRIES > 0 && length <= DIRECTORY_LISTING_CACHE_SIZE && generation == __cacheGeneration__ && !__hasWriteOpenedFiles__ (key)) {
+            // drop the least recently used listings until there is a free entry and enough space
+            while (true) {
+                int freeEntry = -1;
+                int lruEntry = -1;
+                for (int i = 0; i < DIRECTORY_LISTING_CACHE_ENTRIES; i++)
+                    if (!__listingCache__ [i].listing)
+                        freeEntry = i;
+                    else if (lruEntry == -1 || millis () - __listingCache__ [i].lastUsed > millis () - __listingCache__ [lruEntry].lastUsed)
+                        lruEntry = i;
+                if (freeEntry >= 0 && __listingCacheSize__ + length <= DIRECTORY_LISTING_CACHE_SIZE) {
+                    __listingCache__ [freeEntry].path = key;
+                    __listingCache__ [freeEntry].listing = listing;
+                    __listingCache__ [freeEntry].lastUsed = millis ();
+                    __listingCacheSize__ += length;
+                    break;
+                }
+                if (lruEntry < 0)
+                    break;
+                __dropListing__ (lruEntry);
+            }
+        }
     xSemaphoreGive (getFsMutex ());
-    return s;
+
+    return listing;
+}
+
+bool threadSafeFS::FS::__hasWriteOpenedFiles__ (const char *directory) {
+    size_t directoryLength = strlen (directory);
+    if (directoryLength == 1)
+        directoryLength = 0; // root directory, "/" is the separator as well
+    for (auto& path : writeOpenedFiles) {
+        const char *p = path.c_str ();
+        if (!strncmp (p, directory, directoryLength) && p [directoryLength] == '/' && !strchr (p + directoryLength + 1, '/'))
+            return true;
+    }
+    return false;
+}
+
+void threadSafeFS::FS::__invalidateCaches__ (const char *path) {
+    __cacheGeneration__ ++;
+
+    // the listing of the parent directory and the listings of path and below it (if it is a directory)
+    Cstring<255> key = __listingKey__ (path);
+    Cstring<255> parent = key;
+    int lastSlash = 0;
+    for (int i = 0; parent [i]; i++)
+        if (parent [i] == '/')
+            lastSlash = i;
+    parent [lastSlash ? lastSlash : 1] = 0;
+
+    size_t keyLength = key.length ();
+    for (int i = 0; i < DIRECTORY_LISTING_CACHE_ENTRIES; i++)
+        if (__listingCache__ [i].listing) {
+            const char *p = __listingCache__ [i].path.c_str ();
+            if (__listingCache__ [i].path == parent || (!strncmp (p, key.c_str (), keyLength) && (p [keyLength] == 0 || p [keyLength] == '/')))
+                __dropListing__ (i);
+        }
+
+    // the same goes for the metadata
+    const char *p = __metadataDirectory__.c_str ();
+    if (__metadataDirectory__ == parent || (!strncmp (p, key.c_str (), keyLength) && (p [keyLength] == 0 || p [keyLength] == '/')))
+        __dropMetadata__ ();
+}
+
+void threadSafeFS::FS::__dropListing__ (int index) {
+    __listingCacheSize__ -= __listingCache__ [index].listing.length ();
+    __listingCache__ [index].listing = DirectoryListing ();
+}
+
+
+// file metadata cache
+
+bool threadSafeFS::FS::stat (const char *fullPath, size_t& size, time_t& lastWrite, bool& isDirectory) {
+    Cstring<255> key = __listingKey__ (fullPath);
+    int lastSlash = 0;
+    for (int i = 0; key [i]; i++)
+        if (key [i] == '/')
+            lastSlash = i;
+    Cstring<255> directory = key;
+    directory [lastSlash ? lastSlash : 1] = 0;
+    const char *name = key.c_str () + lastSlash + 1;
+
+    auto findEntry = [&] (const char *entries, size_t length) -> bool {
+        for (size_t i = 0; i < length; i += ((__metadataEntry__ *) (entries + i))->entryLength) {
+            __metadataEntry__ *e = (__metadataEntry__ *) (entries + i);
+            if (!strcmp (e->name, name)) {
+                size = e->size;
+                lastWrite = e->lastWrite;
+                isDirectory = e->isDirectory;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // a file that is being written changes all the time, neither the cache nor open (which refuses write-opened files) can be used, ask the file system directly
+    xSemaphoreTake (getFsMutex (), portMAX_DELAY);
+        if (find (writeOpenedFiles.begin (), writeOpenedFiles.end (), key) != writeOpenedFiles.end ()) {
+            fs::File f = __fileSystem__.open (key, FILE_READ);
+            bool found = f;
+            if (f) {
+                size = f.size ();
+                lastWrite = f.getLastWrite ();
+                isDirectory = false;
+                f.close ();
+            }
+            xSemaphoreGive (getFsMutex ());
+            return found;
+        }
+    xSemaphoreGive (getFsMutex ());
+
+    // 1. try the cache, sync clients ask about one file after another in the same directory
+    unsigned long generation = 0;
+    bool readDirectory = FILE_METADATA_CACHE_SIZE > 0 && *name;
+    if (readDirectory) {
+        xSemaphoreTake (getFsMutex (), portMAX_DELAY);
+            if (__metadataDirectory__ == directory && __metadataCache__) {
+                __metadataCacheHits__ ++;
+                bool found = findEntry (__metadataCache__, __metadataCacheLength__);
+                xSemaphoreGive (getFsMutex ());
+                return found;
+            }
+            __metadataCacheMisses__ ++;
+            readDirectory = !(__metadataDirectory__ == directory && __metadataDirectoryTooLarge__);
+            generation = __cacheGeneration__;
+        xSemaphoreGive (getFsMutex ());
+    }
+
+    // 2. read all the entries of the directory in one pass, which costs about as much as opening one file by its path
+    if (readDirectory) {
+        char *entries = (char *) malloc (FILE_METADATA_CACHE_SIZE);
+        if (entries) {
+            size_t length = 0;
+            bool tooLarge = false;
+            for (auto f : open (directory)) {
+                Cstring<255> n = f.name ();
+                size_t entryLength = (sizeof (__metadataEntry__) + n.length () + 1 + alignof (__metadataEntry__) - 1) & ~(alignof (__metadataEntry__) - 1);
+                if (length + entryLength > FILE_METADATA_CACHE_SIZE) {
+                    tooLarge = true;
+                    break;
+                }
+                __metadataEntry__ *e = (__metadataEntry__ *) (entries + length);
+                e->size = f.size ();
+                e->lastWrite = f.getLastWrite ();
+                e->entryLength = entryLength;
+                e->isDirectory = f.isDirectory ();
+                strcpy (e->name, n.c_str ());
+                length += entryLength;
+            }
+
+            if (length && !tooLarge) {
+                bool found = findEntry (entries, length);
+                xSemaphoreTake (getFsMutex (), portMAX_DELAY);
+                    if (generation == __cacheGeneration__) { // nothing has changed while reading
+                        __dropMetadata__ ();
+                        __metadataDirectory__ = directory;
+                        __metadataCache__ = entries;
+                        __metadataCacheLength__ = length;
+                        entries = NULL;
+                    }
+                xSemaphoreGive (getFsMutex ());
+                free (entries);
+                return found;
+            }
+            free (entries);
+
+            if (tooLarge) {
+                xSemaphoreTake (getFsMutex (), portMAX_DELAY);
+                    if (generation == __cacheGeneration__) {
+                        __dropMetadata__ ();
+                        __metadataDirectory__ = directory;
+                        __metadataDirectoryTooLarge__ = true;
+                    }
+                xSemaphoreGive (getFsMutex ());
+            }
+        }
+    }
+
+    // 3. open the file
+    File f = open (key);
+    if (!f)
+        return false;
+    size = f.size ();
+    lastWrite = f.getLastWrite ();
+    isDirectory = f.isDirectory ();
+    return true;
+}
+
+bool threadSafeFS::FS::setLastWrite (const char *fullPath, time_t lastWrite) {
+    if (__mountPoint__ == "")
+        return false; // fs::FS doesn't tell where it is mounted
+    bool b;
+    xSemaphoreTake (getFsMutex (), portMAX_DELAY);
+        struct utimbuf t = { lastWrite, lastWrite };
+        b = !utime ((Cstring<300> (__mountPoint__.c_str ()) + fullPath).c_str (), &t);
+        __invalidateCaches__ (fullPath);
+    xSemaphoreGive (getFsMutex ());
+    return b;
+}
+
+void threadSafeFS::FS::__dropMetadata__ () {
+    free (__metadataCache__);
+    __metadataCache__ = NULL;
+    __metadataCacheLength__ = 0;
+    __metadataDirectory__ = "";
+    __metadataDirectoryTooLarge__ = false;
 }
 
 // reads entire configuration file in the buffer - returns success, it also removes \r characters, double spaces, comments, ...
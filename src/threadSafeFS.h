@@ -7,6 +7,10 @@
 
   A FS wrapper with mutex for multitasking.
 
+  FS also keeps a small LRU cache of formatted directory listings (listDirectory) for FTP LIST and Telnet ls, and sizes and
+  times of the entries of the last directory stat was asked about for FTP SIZE and MDTM. Any change made through FS
+  (writing a file, remove, rename, mkdir, rmdir, setLastWrite) drops the affected listings and metadata.
+
   March 12, 2026, Bojan Jurca
 
 */
@@ -23,6 +27,19 @@
     #include <list.hpp>
 
 
+    // TUNING PARAMETERS
+
+    #ifndef DIRECTORY_LISTING_CACHE_ENTRIES
+        #define DIRECTORY_LISTING_CACHE_ENTRIES 4           // number of directory listings kept in memory, 0 disables the cache
+    #endif
+    #ifndef DIRECTORY_LISTING_CACHE_SIZE
+        #define DIRECTORY_LISTING_CACHE_SIZE (8 * 1024)     // max bytes of all cached listings together, larger listings are not cached
+    #endif
+    #ifndef FILE_METADATA_CACHE_SIZE
+        #define FILE_METADATA_CACHE_SIZE (4 * 1024)         // max bytes of cached metadata (about 24 bytes + name length per directory entry), 0 disables the cache
+    #endif
+
+
     SemaphoreHandle_t getFsMutex ();
 
     namespace threadSafeFS {
@@ -113,6 +130,33 @@
         };
 
 
+        // formatted directory listing, shared between the cache and the readers (copying only increases the reference count) so it stays valid even if the cache drops it meanwhile
+        class DirectoryListing {
+            friend class FS;
+
+            public:
+                DirectoryListing () = default;
+                DirectoryListing (const DirectoryListing& other);
+                DirectoryListing& operator = (const DirectoryListing& other);
+                ~DirectoryListing ();
+
+                operator bool () const { return __text__ != NULL; }
+                const char *c_str () const { return __text__ ? __text__->text : ""; }
+                size_t length () const { return __text__ ? __text__->length : 0; }
+
+            private:
+                struct __text_t__ {
+                    int refCount;
+                    size_t length;
+                    char text [1];
+                };
+                __text_t__ *__text__ = NULL;
+
+                DirectoryListing (__text_t__ *text); // takes the first reference
+                void __release__ ();
+        };
+
+
         class FS {
             friend class File;
 
@@ -123,7 +167,7 @@
             list<Cstring<255>> readOpenedFiles;
             list<Cstring<255>> writeOpenedFiles;
 
-            FS (fs::FS& fileSystem); // for file systems
+            FS (fs::FS& fileSystem, const char* mountPoint = NULL); // mountPoint (like "/littlefs") is only needed by setLastWrite, which fails without it
 
             /*
             bool format ();
@@ -163,8 +207,64 @@
             bool userHasRightToAccessDirectory (Cstring<255> fullPath, Cstring<255> homeDirectory);
 
             Cstring<300> fileInformation (const char* fileOrDirectory, bool showFullPath = false);
+            Cstring<300> fileInformation (File& f, const char *displayedName = NULL); // the same for a file that is already opened, for example while iterating through a directory, without opening it again (displayedName replaces file's name)
 
             bool readConfiguration (char* buffer, size_t bufferSize, const char* fileName);
+
+            // fileInformation of all the directory entries, each line ends with \r\n, from the cache if possible
+            DirectoryListing listDirectory (const char* fullPath);
+
+            // directory listing cache statistics
+            unsigned long getListingCacheHits () { return __listingCacheHits__; }
+            unsigned long getListingCacheMisses () { return __listingCacheMisses__; }
+            unsigned long getListingMillis () { return __listingMillis__; } // total time spent reading directories on cache misses
+
+            // size and last write time without opening the file, from the cached entries of its directory if possible, returns false if it doesn't exist
+            bool stat (const char* fullPath, size_t& size, time_t& lastWrite, bool& isDirectory);
+
+            // sets last write time through VFS utime, the file system must keep the times (CONFIG_LITTLEFS_USE_MTIME, CONFIG_SPIFFS_USE_MTIME, FAT always does)
+            // and mountPoint must have been passed to the constructor, since fs::FS doesn't tell where it is mounted
+            bool setLastWrite (const char* fullPath, time_t lastWrite);
+            inline const char *getMountPoint () { return __mountPoint__.c_str (); } // "" if not known
+
+            // file metadata cache statistics
+            unsigned long getMetadataCacheHits () { return __metadataCacheHits__; }
+            unsigned long getMetadataCacheMisses () { return __metadataCacheMisses__; }
+
+        private:
+
+            struct __cachedListing__ {
+                Cstring<255> path;
+                DirectoryListing listing;
+                unsigned long lastUsed = 0;
+            };
+            __cachedListing__ __listingCache__ [DIRECTORY_LISTING_CACHE_ENTRIES > 0 ? DIRECTORY_LISTING_CACHE_ENTRIES : 1];
+            size_t __listingCacheSize__ = 0;
+            unsigned long __cacheGeneration__ = 0; // changes with every modification, a listing or metadata read meanwhile is not cached
+            unsigned long __listingCacheHits__ = 0;
+            unsigned long __listingCacheMisses__ = 0;
+            unsigned long __listingMillis__ = 0;
+
+            struct __metadataEntry__ {
+                uint32_t size;
+                time_t lastWrite;
+                uint16_t entryLength; // bytes up to the next entry
+                bool isDirectory;
+                char name [];
+            };
+            Cstring<255> __metadataDirectory__;
+            char *__metadataCache__ = NULL; // entries of __metadataDirectory__
+            size_t __metadataCacheLength__ = 0;
+            bool __metadataDirectoryTooLarge__ = false; // don't read it again only to find out that it doesn't fit
+            unsigned long __metadataCacheHits__ = 0;
+            unsigned long __metadataCacheMisses__ = 0;
+
+            Cstring<31> __mountPoint__;
+
+            void __invalidateCaches__ (const char* path); // the caller must hold the FS mutex
+            void __dropListing__ (int index);
+            bool __hasWriteOpenedFiles__ (const char* directory); // the caller must hold the FS mutex
+            void __dropMetadata__ ();
         };
 
 
@@ -173,4 +273,7 @@
     // fprintf compatibility with standard C
     size_t fprintf (threadSafeFS::File &f, const char *fmt, ...);
 
-#endif
\ No newline at end of file
+#endif
+
+// defines loadTunables and saveTunables regardless of whether tunables.h was included before or after this file
+#include "tunables.h"
\ No newline at end of file
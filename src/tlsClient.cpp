@@ -0,0 +1,152 @@
+/*
+
+    tlsClient.cpp
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 20, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        tlsClient_t
+        tlsLayer_t
+
+*/
+
+
+#include <WiFi.h>
+#include <mbedtls/error.h>
+#include "tlsClient.h"
+#include <dmesg.hpp>
+#include <ostream.hpp>
+
+
+// client side TLS session cache, shared by all tlsClient_t instances
+
+struct tlsClientSession_t {
+    char serverName [254];          // the full name, the longest DNS name has 253 characters
+    int serverPort;
+    mbedtls_ssl_session session;    // zero initialized static memory is the same as mbedtls_ssl_session_init
+    unsigned long lastUsed;
+};
+
+static tlsClientSession_t __tlsClientSessions__ [TLS_CLIENT_SESSION_CACHE_SIZE] = {};
+
+static SemaphoreHandle_t __tlsClientSessionsMutex__ () {
+    static SemaphoreHandle_t semaphore = xSemaphoreCreateMutex ();
+    return semaphore;
+}
+
+static tlsClientSession_t *__findTlsClientSession__ (const char *serverName, int serverPort) {
+    for (int i = 0; i < TLS_CLIENT_SESSION_CACHE_SIZE; i++)
+        if (__tlsClientSessions__ [i].serverPort == serverPort && !strcmp (__tlsClientSessions__ [i].serverName, serverName))
+            return &__tlsClientSessions__ [i];
+    return NULL;
+}
+
+
+tlsClient_t::tlsClient_t (const char *serverName, int serverPort, const char *caCertificate) : tcpClient_t (serverName, serverPort) {
+    mbedtls_ssl_config_init (&__tlsConfig__);
+    mbedtls_x509_crt_init (&__caCertificate__);
+
+    if (__errText__ || __connectionSocket__ == -1)
+        return; // TCP connection failed, the reason is already in __errText__
+
+    if (mbedtls_ssl_config_defaults (&__tlsConfig__, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT)) {
+        __errText__ = "TLS configuration error";
+        cout << ( dmesgQueue << "[tlsClient] " << __errText__ );
+        close ();
+        return;
+    }
+    mbedtls_ssl_conf_rng (&__tlsConfig__, tlsRandom, NULL);
+    if (caCertificate) {
+        if (mbedtls_x509_crt_parse (&__caCertificate__, (const unsigned char *) caCertificate, strlen (caCertificate) + 1)) {
+            __errText__ = "invalid CA certificate";
+            cout << ( dmesgQueue << "[tlsClient] " << __errText__ );
+            close ();
+            return;
+        }
+        mbedtls_ssl_conf_ca_chain (&__tlsConfig__, &__caCertificate__, NULL);
+        mbedtls_ssl_conf_authmode (&__tlsConfig__, MBEDTLS_SSL_VERIFY_REQUIRED);
+    } else {
+        mbedtls_ssl_conf_authmode (&__tlsConfig__, MBEDTLS_SSL_VERIFY_NONE);
+    }
+    #ifdef MBEDTLS_SSL_SESSION_TICKETS
+        mbedtls_ssl_conf_session_tickets (&__tlsConfig__, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    #endif
+
+    if (!__tls__.begin (&__connectionSocket__, &__tlsConfig__, serverName)) {
+        __errText__ = "TLS setup error";
+        close ();
+        return;
+    }
+
+    // offer the cached session to the server
+    xSemaphoreTake (__tlsClientSessionsMutex__ (), portMAX_DELAY);
+        tlsClientSession_t *cached = __findTlsClientSession__ (serverName, serverPort);
+        if (cached)
+            __sessionOffered__ = mbedtls_ssl_set_session (__tls__.getContext (), &cached->session) == 0;
+    xSemaphoreGive (__tlsClientSessionsMutex__ ());
+
+    int ret = __tls__.handshake ();
+    if (ret) {
+        char errText [64];
+        mbedtls_strerror (ret, errText, sizeof (errText));
+        cout << ( dmesgQueue << "[tlsClient] " << "handshake error: " << errText );
+        __errText__ = "TLS handshake failed";
+
+        // forget the session, it may be the reason for failure
+        xSemaphoreTake (__tlsClientSessionsMutex__ (), portMAX_DELAY);
+            tlsClientSession_t *stale = __findTlsClientSession__ (serverName, serverPort);
+            if (stale) {
+                mbedtls_ssl_session_free (&stale->session);
+                memset (stale, 0, sizeof (tlsClientSession_t));
+            }
+        xSemaphoreGive (__tlsClientSessionsMutex__ ());
+
+        close ();
+        return;
+    }
+
+    // remember the (new or resumed) session for the next connection, replace the least recently used entry if needed
+    xSemaphoreTake (__tlsClientSessionsMutex__ (), portMAX_DELAY);
+        tlsClientSession_t *entry = __findTlsClientSession__ (serverName, serverPort);
+        if (!entry && strlen (serverName) < sizeof (entry->serverName)) { // names that are not valid DNS names (too long) are not cached
+            entry = &__tlsClientSessions__ [0];
+            for (int i = 1; i < TLS_CLIENT_SESSION_CACHE_SIZE; i++)
+                if (__tlsClientSessions__ [i].lastUsed < entry->lastUsed)
+                    entry = &__tlsClientSessions__ [i];
+            strcpy (entry->serverName, serverName);
+            entry->serverPort = serverPort;
+        }
+        if (entry) {
+            mbedtls_ssl_session_free (&entry->session);
+            mbedtls_ssl_session_init (&entry->session);
+            if (mbedtls_ssl_get_session (__tls__.getContext (), &entry->session) == 0) {
+                entry->lastUsed = millis ();
+            } else {
+                mbedtls_ssl_session_free (&entry->session);
+                memset (entry, 0, sizeof (tlsClientSession_t));
+            }
+        }
+    xSemaphoreGive (__tlsClientSessionsMutex__ ());
+}
+
+tlsClient_t::~tlsClient_t () {
+    close ();
+    __tls__.end ();
+    mbedtls_ssl_config_free (&__tlsConfig__);
+    mbedtls_x509_crt_free (&__caCertificate__);
+}
+
+void tlsClient_t::close () {
+    if (__connectionSocket__ != -1)
+        __tls__.closeNotify ();
+    tcpConnection_t::close ();
+}
+
+int tlsClient_t::__recv__ (void *buf, size_t len, int flags) { return __tls__.recv (buf, len, flags); }
+
+int tlsClient_t::__send__ (const void *buf, size_t len) { return __tls__.send (buf, len); }
@@ -0,0 +1,80 @@
+/*
+
+    tlsClient.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 20, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        tlsClient_t
+        tlsLayer_t
+
+    Inheritance diagram:
+
+      ┌─────────────────┐
+      │ tcpConnection_t ┼┐
+      └─────────────────┘│     ┌──────────────────────┐
+                         └─────┼─ tcpClient_t         │
+                               │   └── tlsClient_t    │
+                               └──────────────────────┘
+
+    tlsClient_t connects the same way as tcpClient_t and then performs the TLS handshake before the constructor returns.
+
+    After a successful handshake the TLS session (together with the session ticket if the server issued one) is kept in
+    a small cache shared by all tlsClient_t instances, one entry per server name and port. The next connection to the
+    same server offers this session and, if the server still remembers it, skips the asymmetric cryptography.
+
+*/
+
+
+#pragma once
+#ifndef __TLS_CLIENT__
+    #define __TLS_CLIENT__
+
+
+    #include <WiFi.h>
+    #include <mbedtls/ssl.h>
+    #include <mbedtls/x509_crt.h>
+    #include "tcpClient.h"
+    #include "tlsConnection.h"
+
+
+    // TUNING PARAMETERS
+
+    #ifndef TLS_CLIENT_SESSION_CACHE_SIZE
+        #define TLS_CLIENT_SESSION_CACHE_SIZE 4         // number of servers whose TLS sessions tlsClient_t remembers for resumption
+    #endif
+
+
+    class tlsClient_t : public tcpClient_t {
+
+        public:
+
+            // if CA certificate (PEM format) is given the server's certificate is verified against it, otherwise it is not verified at all
+            tlsClient_t (const char *serverName, int serverPort, const char *caCertificate = NULL);
+            ~tlsClient_t ();
+
+            void close () override;
+
+            // true if a cached TLS session was offered to the server (whether the server accepted it can be seen in tlsServer_t::getResumedSessions or in openssl s_server's output)
+            inline bool sessionOffered () __attribute__((always_inline)) { return __sessionOffered__; }
+
+        protected:
+
+            int __recv__ (void *buf, size_t len, int flags) override;
+            int __send__ (const void *buf, size_t len) override;
+
+        private:
+
+            mbedtls_ssl_config __tlsConfig__;
+            mbedtls_x509_crt __caCertificate__;
+            tlsLayer_t __tls__;
+
+            bool __sessionOffered__ = false;
+    };
+
+#endif
@@ -0,0 +1,218 @@
+/*
+
+    tlsConnection.cpp
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 20, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        tlsLayer_t
+        tlsConnection_t
+
+*/
+
+
+#include <WiFi.h>
+#include <errno.h>
+#include <esp_random.h>
+#include <mbedtls/error.h>
+#include <mbedtls/net_sockets.h>
+#include "tlsConnection.h"
+#include <dmesg.hpp>
+#include <ostream.hpp>
+
+
+// run time values of tuning parameters
+tunable_t tlsHandshakeTimeOut ("TLS_HANDSHAKE_TIME_OUT", TLS_HANDSHAKE_TIME_OUT, 1, 60, "s");
+
+
+int tlsRandom (void *context, unsigned char *buf, size_t len) {
+    esp_fill_random (buf, len);
+    return 0;
+}
+
+
+tlsLayer_t::tlsLayer_t () { mbedtls_ssl_init (&__ssl__); }
+
+tlsLayer_t::~tlsLayer_t () { mbedtls_ssl_free (&__ssl__); }
+
+void tlsLayer_t::end () {
+    mbedtls_ssl_free (&__ssl__);
+    mbedtls_ssl_init (&__ssl__);
+    __initialized__ = false;
+    __peeked__ = 0;
+}
+
+bool tlsLayer_t::begin (int *connectionSocket, const mbedtls_ssl_config *config, const char *hostname) {
+    __connectionSocket__ = connectionSocket;
+
+    int ret = mbedtls_ssl_setup (&__ssl__, config);
+    if (ret == 0 && hostname)
+        ret = mbedtls_ssl_set_hostname (&__ssl__, hostname);
+    if (ret != 0) {
+        char errText [64];
+        mbedtls_strerror (ret, errText, sizeof (errText));
+        cout << ( dmesgQueue << "[tls] " << "setup error: " << errText );
+        return false;
+    }
+
+    mbedtls_ssl_set_bio (&__ssl__, this, __bioSend__, __bioRecv__, NULL);
+    __initialized__ = true;
+    return true;
+}
+
+int tlsLayer_t::handshake () {
+    if (!__initialized__)
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+
+    unsigned long startMillis = millis ();
+    int ret;
+    while ((ret = mbedtls_ssl_handshake (&__ssl__)) != 0) {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+            return ret;
+        if (millis () - startMillis > tlsHandshakeTimeOut * 1000)
+            return MBEDTLS_ERR_SSL_TIMEOUT;
+        delay (25);
+    }
+    return 0;
+}
+
+int tlsLayer_t::recv (void *buf, size_t len, int flags) {
+    if (!__initialized__) {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    // peek: decrypt the data into peek buffer where it stays until it is actually read
+    if (flags & MSG_PEEK) {
+        if (__peeked__ == 0) {
+            int ret = mbedtls_ssl_read (&__ssl__, __peekBuffer__, sizeof (__peekBuffer__));
+            if (ret <= 0)
+                return __result__ (ret);
+            __peeked__ = ret;
+        }
+        size_t n = min (len, __peeked__);
+        memcpy (buf, __peekBuffer__, n);
+        return n;
+    }
+
+    // read the data that has already been peeked first
+    if (__peeked__) {
+        size_t n = min (len, __peeked__);
+        memcpy (buf, __peekBuffer__, n);
+        memmove (__peekBuffer__, __peekBuffer__ + n, __peeked__ - n);
+        __peeked__ -= n;
+        return n;
+    }
+
+    int ret = mbedtls_ssl_read (&__ssl__, (unsigned char *) buf, len);
+    if (ret <= 0)
+        return __result__ (ret);
+    return ret;
+}
+
+int tlsLayer_t::send (const void *buf, size_t len) {
+    if (!__initialized__) {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    // if mbedtls_ssl_write returns WANT_WRITE it has to be called again with the same arguments which is exactly what tcpConnection_t::sendBlock does
+    int ret = mbedtls_ssl_write (&__ssl__, (const unsigned char *) buf, len);
+    if (ret <= 0)
+        return __result__ (ret);
+    return ret;
+}
+
+void tlsLayer_t::closeNotify () {
+    if (handshakeOver ())
+        mbedtls_ssl_close_notify (&__ssl__); // just one attempt, the socket is going to be closed anyway
+}
+
+// translates mbedTLS return code into ::recv/::send like return value and errno
+int tlsLayer_t::__result__ (int ret) {
+    switch (ret) {
+        case MBEDTLS_ERR_SSL_WANT_READ:
+        case MBEDTLS_ERR_SSL_WANT_WRITE:
+        #ifdef MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET
+            case MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET:
+        #endif
+                                                errno = EAGAIN;
+                                                return -1;
+        case 0:
+        case MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY:
+        case MBEDTLS_ERR_SSL_CONN_EOF:
+                                                errno = 0; // connection closed by peer
+                                                return 0;
+        case MBEDTLS_ERR_NET_RECV_FAILED:
+        case MBEDTLS_ERR_NET_SEND_FAILED:
+                                                errno = __socketErrno__; // let the connection handle socket errors the same way as without TLS
+                                                return -1;
+        default:
+                                                char errText [64];
+                                                mbedtls_strerror (ret, errText, sizeof (errText));
+                                                cout << ( dmesgQueue << "[tls] " << "error: " << errText );
+                                                errno = EPROTO; // TLS protocol error (handshake failure, bad record, ...), not a lost connection
+                                                return -1;
+    }
+}
+
+int tlsLayer_t::__bioSend__ (void *ctx, const unsigned char *buf, size_t len) {
+    tlsLayer_t *ths = (tlsLayer_t *) ctx;
+
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        int sent = ::send (*ths->__connectionSocket__, (const char *) buf, len, 0);
+    xSemaphoreGive (getLwIpMutex ());
+
+    if (sent >= 0)
+        return sent;
+    if (errno == EAGAIN || errno == ENOTCONN) // all the sockets are non-blocking
+        return MBEDTLS_ERR_SSL_WANT_WRITE;
+    ths->__socketErrno__ = errno;
+    return MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+int tlsLayer_t::__bioRecv__ (void *ctx, unsigned char *buf, size_t len) {
+    tlsLayer_t *ths = (tlsLayer_t *) ctx;
+
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        int received = ::recv (*ths->__connectionSocket__, (char *) buf, len, 0);
+    xSemaphoreGive (getLwIpMutex ());
+
+    if (received > 0)
+        return received;
+    if (received == 0)
+        return MBEDTLS_ERR_SSL_CONN_EOF;
+    if (errno == EAGAIN || errno == ENOTCONN) // all the sockets are non-blocking
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    ths->__socketErrno__ = errno;
+    return MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+
+tlsConnection_t::tlsConnection_t (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress, const mbedtls_ssl_config *tlsConfig, int *runningConnections) : tcpConnection_t (connectionSocket, clientAddress, serverAddress) {
+    __runningConnections__ = runningConnections;
+    if (__connectionSocket__ != -1 && !__tls__.begin (&__connectionSocket__, tlsConfig))
+        tcpConnection_t::close ();
+}
+
+tlsConnection_t::~tlsConnection_t () {
+    close ();
+    __tls__.end (); // free TLS context while the server's tlsConfig still exists
+    if (__runningConnections__)
+        __atomic_sub_fetch (__runningConnections__, 1, __ATOMIC_SEQ_CST);
+}
+
+void tlsConnection_t::close () {
+    if (__connectionSocket__ != -1)
+        __tls__.closeNotify ();
+    tcpConnection_t::close ();
+}
+
+int tlsConnection_t::__recv__ (void *buf, size_t len, int flags) { return __tls__.recv (buf, len, flags); }
+
+int tlsConnection_t::__send__ (const void *buf, size_t len) { return __tls__.send (buf, len); }
@@ -0,0 +1,133 @@
+/*
+
+    tlsConnection.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 20, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        tlsLayer_t
+        tlsConnection_t
+
+    Inheritance diagram:
+
+      ┌─────────────────┐
+      │ tcpConnection_t ┼┐
+      └─────────────────┘│
+                         │     ┌───────────────────────────┐
+                         ├─────┼─ tlsConnection_t          │  server side TLS connection, created by tlsServer_t
+                         │     └───────────────────────────┘
+                         │     ┌───────────────────────────┐
+                         └─────┼─ tcpClient_t              │
+                               │   └── tlsClient_t         │  client side TLS connection
+                               └───────────────────────────┘
+
+    Both, tlsConnection_t and tlsClient_t, use tlsLayer_t that puts mbedTLS between tcpConnection_t's recv/send functions
+    and the socket. The handshake is performed by the first read or write (or explicitly by calling handshake ()).
+
+    The expensive part of TLS handshake on ESP32 is the asymmetric cryptography, which may take more than a second. Repeated
+    connections can skip it by resuming previous TLS sessions:
+
+     - tlsServer_t keeps a session ID cache and issues session tickets,
+     - tlsClient_t remembers the last session with each server (see tlsClient.h).
+
+*/
+
+
+#pragma once
+#ifndef __TLS_CONNECTION__
+    #define __TLS_CONNECTION__
+
+
+    #include <WiFi.h>
+    #include <mbedtls/ssl.h>
+    #include "tcpConnection.h"
+
+
+    // TUNING PARAMETERS
+
+    #ifndef TLS_HANDSHAKE_TIME_OUT
+        #define TLS_HANDSHAKE_TIME_OUT 10               // 10 s, the time handshake () waits for the handshake to complete
+    #endif
+    #ifndef TLS_PEEK_BUFFER_SIZE
+        #define TLS_PEEK_BUFFER_SIZE 16                 // decrypted data can not be peeked at in the socket so peek () keeps it here until it is actually read
+    #endif
+
+    // run time values of tuning parameters
+    extern tunable_t tlsHandshakeTimeOut;
+
+
+    // random number generator for mbedTLS (ESP32 hardware RNG) so that connections do not need their own entropy and DRBG contexts
+    int tlsRandom (void *context, unsigned char *buf, size_t len);
+
+
+    class tlsLayer_t {
+
+        public:
+
+            tlsLayer_t ();
+            ~tlsLayer_t ();
+
+            // prepares TLS context for the (already connected) socket, hostname is used for SNI and certificate verification on the client side
+            bool begin (int *connectionSocket, const mbedtls_ssl_config *config, const char *hostname = NULL);
+
+            // blocks until the handshake completes, returns 0 or mbedTLS error code
+            int handshake ();
+
+            // behave like ::recv and ::send on non-blocking socket
+            int recv (void *buf, size_t len, int flags);
+            int send (const void *buf, size_t len);
+
+            // sends close notify alert if the TLS session is established
+            void closeNotify ();
+
+            // frees TLS context (before mbedtls_ssl_config it uses gets freed)
+            void end ();
+
+            inline bool handshakeOver () __attribute__((always_inline)) { return __initialized__ && mbedtls_ssl_is_handshake_over (&__ssl__); }
+            inline mbedtls_ssl_context *getContext () __attribute__((always_inline)) { return &__ssl__; }
+
+        private:
+
+            mbedtls_ssl_context __ssl__;
+            bool __initialized__ = false;
+            int *__connectionSocket__ = NULL;   // points to the socket of the connection that owns this TLS layer
+            int __socketErrno__ = 0;            // errno of the last failed socket operation, so that the connection can handle it the same way as without TLS
+
+            unsigned char __peekBuffer__ [TLS_PEEK_BUFFER_SIZE];
+            size_t __peeked__ = 0;
+
+            int __result__ (int ret);
+
+            static int __bioSend__ (void *ctx, const unsigned char *buf, size_t len);
+            static int __bioRecv__ (void *ctx, unsigned char *buf, size_t len);
+    };
+
+
+    class tlsConnection_t : public tcpConnection_t {
+
+        public:
+
+            // runningConnections (if not NULL) is the server's counter of connections that use tlsConfig, the server increments it before creating the connection and the connection decrements it when it no longer needs tlsConfig
+            tlsConnection_t (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress, const mbedtls_ssl_config *tlsConfig, int *runningConnections = NULL);
+            ~tlsConnection_t ();
+
+            void close () override;
+
+            // the handshake is normally performed by the first recv or send call, but it can also be forced
+            inline int handshake () __attribute__((always_inline)) { return __tls__.handshake (); }
+
+        protected:
+
+            tlsLayer_t __tls__;
+            int *__runningConnections__;
+
+            int __recv__ (void *buf, size_t len, int flags) override;
+            int __send__ (const void *buf, size_t len) override;
+    };
+
+#endif
@@ -0,0 +1,173 @@
+/*
+
+    tlsServer.cpp
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 20, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        tlsServer_t
+        tlsConnection_t
+
+*/
+
+
+#include <WiFi.h>
+#include <mbedtls/error.h>
+#include "tlsServer.h"
+#include <dmesg.hpp>
+#include <ostream.hpp>
+
+
+tlsServer_t::tlsServer_t (int serverPort,
+                          const char *certificate,
+                          const char *privateKey,
+                          bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress),
+                          bool runListenerInItsOwnTask) : tcpServer_t (serverPort, firewallCallback, runListenerInItsOwnTask) {
+
+    __sessionMutex__ = xSemaphoreCreateMutex ();
+
+    mbedtls_ssl_config_init (&__tlsConfig__);
+    mbedtls_x509_crt_init (&__certificate__);
+    mbedtls_pk_init (&__privateKey__);
+    #ifdef MBEDTLS_SSL_CACHE_C
+        mbedtls_ssl_cache_init (&__sessionCache__);
+    #endif
+    #if defined (MBEDTLS_SSL_TICKET_C) && defined (MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_ticket_init (&__ticketContext__);
+    #endif
+
+    int ret;
+    const char *step;
+
+    if ((ret = mbedtls_x509_crt_parse (&__certificate__, (const unsigned char *) certificate, strlen (certificate) + 1))) {
+        step = "certificate";
+        goto error;
+    }
+    if ((ret = mbedtls_pk_parse_key (&__privateKey__, (const unsigned char *) privateKey, strlen (privateKey) + 1, NULL, 0, tlsRandom, NULL))) {
+        step = "private key";
+        goto error;
+    }
+    if ((ret = mbedtls_ssl_config_defaults (&__tlsConfig__, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT))) {
+        step = "config";
+        goto error;
+    }
+    mbedtls_ssl_conf_rng (&__tlsConfig__, tlsRandom, NULL);
+    if ((ret = mbedtls_ssl_conf_own_cert (&__tlsConfig__, &__certificate__, &__privateKey__))) {
+        step = "own certificate";
+        goto error;
+    }
+
+    // session resumption by session ID
+    #ifdef MBEDTLS_SSL_CACHE_C
+        mbedtls_ssl_cache_set_max_entries (&__sessionCache__, TLS_SERVER_SESSION_CACHE_SIZE);
+        mbedtls_ssl_cache_set_timeout (&__sessionCache__, TLS_SESSION_TIME_OUT);
+        mbedtls_ssl_conf_session_cache (&__tlsConfig__, this, __sessionCacheGet__, __sessionCacheSet__);
+    #endif
+
+    // session resumption by session ticket
+    #if defined (MBEDTLS_SSL_TICKET_C) && defined (MBEDTLS_SSL_SESSION_TICKETS)
+        if ((ret = mbedtls_ssl_ticket_setup (&__ticketContext__, tlsRandom, NULL, MBEDTLS_CIPHER_AES_256_GCM, TLS_SESSION_TIME_OUT))) {
+            step = "session ticket";
+            goto error;
+        }
+        mbedtls_ssl_conf_session_tickets_cb (&__tlsConfig__, __ticketWrite__, __ticketParse__, this);
+    #endif
+
+    __tlsReady__ = true;
+    return;
+
+error:
+    char errText [64];
+    mbedtls_strerror (ret, errText, sizeof (errText));
+    cout << ( dmesgQueue << "[tlsServer] " << step << " error: " << errText );
+}
+
+tlsServer_t::~tlsServer_t () {
+    // stop creating new connections and wait until the running ones stop using TLS configuration, session cache and ticket context
+    __unregisterFromListener__ ();
+    __tlsReady__ = false;
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&__runningConnections__, __ATOMIC_SEQ_CST) > 0) {
+        cout << ( dmesgQueue << "[tlsServer] " << "waiting for " << __atomic_load_n (&__runningConnections__, __ATOMIC_SEQ_CST) << " connection(s) to end" );
+        while (__atomic_load_n (&__runningConnections__, __ATOMIC_SEQ_CST) > 0)
+            delay (25);
+    }
+
+    #if defined (MBEDTLS_SSL_TICKET_C) && defined (MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_ticket_free (&__ticketContext__);
+    #endif
+    #ifdef MBEDTLS_SSL_CACHE_C
+        mbedtls_ssl_cache_free (&__sessionCache__);
+    #endif
+    mbedtls_ssl_config_free (&__tlsConfig__);
+    mbedtls_pk_free (&__privateKey__);
+    mbedtls_x509_crt_free (&__certificate__);
+    vSemaphoreDelete (__sessionMutex__);
+}
+
+tcpConnection_t *tlsServer_t::__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) {
+    // count the connection before checking __tlsReady__ so that the destructor either waits for it or this function sees that the server is stopping
+    __atomic_add_fetch (&__runningConnections__, 1, __ATOMIC_SEQ_CST);
+    if (!__tlsReady__) {
+        __atomic_sub_fetch (&__runningConnections__, 1, __ATOMIC_SEQ_CST);
+        xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+            close (connectionSocket);
+        xSemaphoreGive (getLwIpMutex ());
+        return NULL;
+    }
+    tcpConnection_t *connection = new (std::nothrow) tlsConnection_t (connectionSocket, clientAddress, serverAddress, &__tlsConfig__, &__runningConnections__);
+    if (connection)
+        connection->setServerBandwidthLimit (&getBandwidthLimit ());
+    else
+        __atomic_sub_fetch (&__runningConnections__, 1, __ATOMIC_SEQ_CST);
+    return connection;
+}
+
+#ifdef MBEDTLS_SSL_CACHE_C
+
+    int tlsServer_t::__sessionCacheGet__ (void *data, unsigned char const *sessionId, size_t sessionIdLen, mbedtls_ssl_session *session) {
+        tlsServer_t *ths = (tlsServer_t *) data;
+        xSemaphoreTake (ths->__sessionMutex__, portMAX_DELAY);
+            int ret = mbedtls_ssl_cache_get (&ths->__sessionCache__, sessionId, sessionIdLen, session);
+            if (ret == 0)
+                ths->__resumedSessions__ ++;
+        xSemaphoreGive (ths->__sessionMutex__);
+        return ret;
+    }
+
+    int tlsServer_t::__sessionCacheSet__ (void *data, unsigned char const *sessionId, size_t sessionIdLen, const mbedtls_ssl_session *session) {
+        tlsServer_t *ths = (tlsServer_t *) data;
+        xSemaphoreTake (ths->__sessionMutex__, portMAX_DELAY);
+            int ret = mbedtls_ssl_cache_set (&ths->__sessionCache__, sessionId, sessionIdLen, session);
+        xSemaphoreGive (ths->__sessionMutex__);
+        return ret;
+    }
+
+#endif
+
+#if defined (MBEDTLS_SSL_TICKET_C) && defined (MBEDTLS_SSL_SESSION_TICKETS)
+
+    int tlsServer_t::__ticketWrite__ (void *data, const mbedtls_ssl_session *session, unsigned char *start, const unsigned char *end, size_t *tlen, uint32_t *lifetime) {
+        tlsServer_t *ths = (tlsServer_t *) data;
+        xSemaphoreTake (ths->__sessionMutex__, portMAX_DELAY);
+            int ret = mbedtls_ssl_ticket_write (&ths->__ticketContext__, session, start, end, tlen, lifetime);
+        xSemaphoreGive (ths->__sessionMutex__);
+        return ret;
+    }
+
+    int tlsServer_t::__ticketParse__ (void *data, mbedtls_ssl_session *session, unsigned char *buf, size_t len) {
+        tlsServer_t *ths = (tlsServer_t *) data;
+        xSemaphoreTake (ths->__sessionMutex__, portMAX_DELAY);
+            int ret = mbedtls_ssl_ticket_parse (&ths->__ticketContext__, session, buf, len);
+            if (ret == 0)
+                ths->__resumedSessions__ ++;
+        xSemaphoreGive (ths->__sessionMutex__);
+        return ret;
+    }
+
+#endif
@@ -0,0 +1,113 @@
+/*
+
+    tlsServer.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    March 20, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        tlsServer_t
+        tlsConnection_t
+
+    Inheritance diagram:
+
+             ┌─────────────┐
+             │ tcpServer_t ┼┐
+             └─────────────┘│     ┌──────────────┐
+                            └─────┼─ tlsServer_t │
+                                  └──────────────┘
+
+    tlsServer_t accepts connections the same way as tcpServer_t but creates tlsConnection_t instances that share the server's
+    TLS configuration. Clients that reconnect can resume their previous TLS session, either by session ID (the server keeps
+    TLS_SERVER_SESSION_CACHE_SIZE sessions in its cache) or by session ticket (the server keeps nothing, the client brings
+    the session state encrypted with the server's ticket key).
+
+    The TLS handshake is performed by the first read or write on the connection, not in the listener.
+
+*/
+
+
+#pragma once
+#ifndef __TLS_SERVER__
+    #define __TLS_SERVER__
+
+
+    #include <WiFi.h>
+    #include <mbedtls/ssl.h>
+    #include <mbedtls/x509_crt.h>
+    #include <mbedtls/pk.h>
+    #include <mbedtls/ssl_cache.h>
+    #include <mbedtls/ssl_ticket.h>
+    #include "tcpServer.h"
+    #include "tlsConnection.h"
+
+
+    // TUNING PARAMETERS
+
+    #ifndef TLS_SERVER_SESSION_CACHE_SIZE
+        #define TLS_SERVER_SESSION_CACHE_SIZE 8         // number of TLS sessions tlsServer_t keeps for resumption by session ID
+    #endif
+    #ifndef TLS_SESSION_TIME_OUT
+        #define TLS_SESSION_TIME_OUT 3600               // 3600 s = 1 h, how long sessions (and session tickets) can be resumed
+    #endif
+
+
+    class tlsServer_t : public tcpServer_t {
+
+        public:
+
+            // certificate and private key are in PEM format
+            tlsServer_t (int serverPort,
+                         const char *certificate,
+                         const char *privateKey,
+                         bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL,
+                         bool runListenerInItsOwnTask = true);
+
+            ~tlsServer_t ();
+
+            // bool() operator to test if tlsServer started successfully
+            inline operator bool () __attribute__((always_inline)) { return __tlsReady__ && tcpServer_t::operator bool (); }
+
+            // the number of handshakes that resumed previous TLS session (by session ID or by session ticket) instead of performing the full handshake
+            inline unsigned long getResumedSessions () __attribute__((always_inline)) { return __resumedSessions__; }
+
+        protected:
+
+            // for classes derived from tlsServer_t that create their own connection instances: increment the counter (atomically) before checking
+            // that the server is ready and pass it to tlsConnection_t constructor, so that the destructor waits until the connection ends
+            inline const mbedtls_ssl_config *getTlsConfig () __attribute__((always_inline)) { return &__tlsConfig__; }
+            inline int *getRunningConnections () __attribute__((always_inline)) { return &__runningConnections__; }
+
+        private:
+
+            volatile bool __tlsReady__ = false;
+            int __runningConnections__ = 0;     // connections that still use __tlsConfig__, session cache and ticket context
+
+            mbedtls_ssl_config __tlsConfig__;
+            mbedtls_x509_crt __certificate__;
+            mbedtls_pk_context __privateKey__;
+
+            // mbedTLS session cache and ticket context are not thread-safe without MBEDTLS_THREADING_C so they are accessed through the callbacks below
+            SemaphoreHandle_t __sessionMutex__;
+            unsigned long __resumedSessions__ = 0;
+
+            #ifdef MBEDTLS_SSL_CACHE_C
+                mbedtls_ssl_cache_context __sessionCache__;
+                static int __sessionCacheGet__ (void *data, unsigned char const *sessionId, size_t sessionIdLen, mbedtls_ssl_session *session);
+                static int __sessionCacheSet__ (void *data, unsigned char const *sessionId, size_t sessionIdLen, const mbedtls_ssl_session *session);
+            #endif
+
+            #if defined (MBEDTLS_SSL_TICKET_C) && defined (MBEDTLS_SSL_SESSION_TICKETS)
+                mbedtls_ssl_ticket_context __ticketContext__;
+                static int __ticketWrite__ (void *data, const mbedtls_ssl_session *session, unsigned char *start, const unsigned char *end, size_t *tlen, uint32_t *lifetime);
+                static int __ticketParse__ (void *data, mbedtls_ssl_session *session, unsigned char *buf, size_t len);
+            #endif
+
+            tcpConnection_t *__createConnectionInstance__ (int connectionSocket, const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) override;
+    };
+
+#endif
@@ -0,0 +1,159 @@
+/*
+
+    tokenBucket.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 2, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        tokenBucket_t
+        bandwidthLimit_t
+
+    tokenBucket_t limits the rate of bytes passing through it. The bucket fills at rate bytes per second up to burst bytes.
+    Before sending (or receiving) a block the caller waits for waitTime () milliseconds, which is 0 while there are tokens
+    in the bucket, and afterwards consumes the number of bytes actually transferred. The bucket may go into debt this way,
+    so blocks larger than the burst still pass, the following blocks just wait longer. Rate 0 means unlimited, in which case
+    the bucket only measures the actual rate.
+
+    The buckets are shared between tasks (per server and global limits), so they are guarded with a spinlock - the critical
+    sections are only a few instructions long.
+
+*/
+
+
+#pragma once
+#ifndef __TOKEN_BUCKET__
+    #define __TOKEN_BUCKET__
+
+
+    #include <WiFi.h>
+
+
+    // TUNING PARAMETERS
+
+    #ifndef TOKEN_BUCKET_MAX_WAIT
+        #define TOKEN_BUCKET_MAX_WAIT 100               // 100 ms, the longest single wait so that the waiting connections still check their idle time-out
+    #endif
+
+
+    class tokenBucket_t {
+
+        public:
+
+            // rate and burst in bytes per second and bytes, rate 0 means unlimited, burst 0 means 1/10 s worth of rate
+            void setRate (unsigned long rate, unsigned long burst = 0) {
+                if (!burst)
+                    burst = rate / 10 ? rate / 10 : 1;
+                taskENTER_CRITICAL (&__spinlock__);
+                    __rate__ = rate;
+                    __burst__ = burst;
+                    __tokens__ = burst;
+                    __lastMicros__ = micros ();
+                taskEXIT_CRITICAL (&__spinlock__);
+            }
+
+            inline unsigned long getRate () __attribute__((always_inline)) { return __rate__; }
+            inline unsigned long getBurst () __attribute__((always_inline)) { return __burst__; }
+
+            // the rate measured over the last (about) 1 s period
+            unsigned long getActualRate () {
+                taskENTER_CRITICAL (&__spinlock__);
+                    __measure__ (millis ());
+                    unsigned long actualRate = __actualRate__;
+                taskEXIT_CRITICAL (&__spinlock__);
+                return actualRate;
+            }
+
+            // milliseconds to wait before the next transfer, 0 if it can be done now
+            unsigned long waitTime () {
+                unsigned long ms = 0;
+                taskENTER_CRITICAL (&__spinlock__);
+                    if (__rate__) {
+                        __refill__ ();
+                        if (__tokens__ <= 0)
+                            ms = min ((unsigned long) ((1 - __tokens__) * 1000 / __rate__) + 1, (unsigned long) TOKEN_BUCKET_MAX_WAIT);
+                    }
+                taskEXIT_CRITICAL (&__spinlock__);
+                return ms;
+            }
+
+            // bytes actually transferred
+            void consume (unsigned long bytes) {
+                taskENTER_CRITICAL (&__spinlock__);
+                    if (__rate__) {
+                        __refill__ ();
+                        __tokens__ -= bytes;
+                    }
+                    __measure__ (millis ());
+                    __windowBytes__ += bytes;
+                taskEXIT_CRITICAL (&__spinlock__);
+            }
+
+        private:
+
+            portMUX_TYPE __spinlock__ = portMUX_INITIALIZER_UNLOCKED;
+
+            unsigned long __rate__ = 0;
+            unsigned long __burst__ = 0;
+            long __tokens__ = 0;
+            unsigned long __lastMicros__ = 0;
+
+            unsigned long __windowMillis__ = 0;
+            unsigned long __windowBytes__ = 0;
+            unsigned long __actualRate__ = 0;
+
+            // call from critical section only
+            void __refill__ () {
+                unsigned long now = micros ();
+                uint64_t tokens = (uint64_t) (now - __lastMicros__) * __rate__ / 1000000;
+                if (tokens) { // else keep accumulating time
+                    __lastMicros__ = now;
+                    // clamp before converting to long, after a long idle time tokens may not fit into it
+                    int64_t room = (int64_t) __burst__ - __tokens__;
+                    if (room > 0)
+                        __tokens__ += (long) (tokens < (uint64_t) room ? tokens : (uint64_t) room);
+                }
+            }
+
+            // call from critical section only
+            void __measure__ (unsigned long now) {
+                unsigned long elapsed = now - __windowMillis__;
+                if (elapsed >= 1000) {
+                    __actualRate__ = (uint64_t) __windowBytes__ * 1000 / elapsed;
+                    __windowBytes__ = 0;
+                    __windowMillis__ = now;
+                }
+            }
+    };
+
+
+    // limits for both directions, server's limit is reference counted since its connections may outlive the server
+    struct bandwidthLimit_t {
+        tokenBucket_t send;
+        tokenBucket_t recv;
+
+        int refCount = 1; // the owner's reference
+
+        inline bandwidthLimit_t *acquire () __attribute__((always_inline)) {
+            __atomic_add_fetch (&refCount, 1, __ATOMIC_ACQ_REL);
+            return this;
+        }
+
+        // only for the instances created with new
+        inline void release () __attribute__((always_inline)) {
+            if (__atomic_sub_fetch (&refCount, 1, __ATOMIC_ACQ_REL) == 0)
+                delete this;
+        }
+    };
+
+    // singleton global limit that applies to all the TCP connections together
+    inline bandwidthLimit_t& globalBandwidthLimit () {
+        static bandwidthLimit_t instance;
+        return instance;
+    }
+
+#endif
@@ -0,0 +1,79 @@
+/*
+
+    topTalkers.cpp
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 20, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        topTalkers_t
+
+*/
+
+
+#include <WiFi.h>
+#include <LwIpMutex.h>
+#include "topTalkers.h"
+
+
+topTalkers_t& topTalkers () {
+    static topTalkers_t instance;
+    return instance;
+}
+
+void topTalkers_t::connectionEstablished (const ipAddress_t& address) {
+    topTalker_t& e = __entry__ (address);
+    e.connections ++;
+    e.lastSeen = millis ();
+}
+
+void topTalkers_t::traffic (const ipAddress_t& address, unsigned long bytesReceived, unsigned long bytesSent) {
+    if (!bytesReceived && !bytesSent)
+        return;
+    topTalker_t& e = __entry__ (address);
+    e.bytesReceived += bytesReceived;
+    e.bytesSent += bytesSent;
+    e.lastSeen = millis ();
+}
+
+int topTalkers_t::copy (topTalker_t *to, int size) {
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        int n = min (size, __count__);
+        // selection of the n heaviest entries, the table is small
+        bool taken [TOP_TALKERS_TABLE_SIZE] = {};
+        for (int i = 0; i < n; i++) {
+            int heaviest = -1;
+            for (int j = 0; j < __count__; j++)
+                if (!taken [j] && (heaviest == -1 || __table__ [j].getWeight () > __table__ [heaviest].getWeight ()))
+                    heaviest = j;
+            taken [heaviest] = true;
+            to [i] = __table__ [heaviest];
+        }
+    xSemaphoreGive (getLwIpMutex ());
+    return n;
+}
+
+topTalker_t& topTalkers_t::__entry__ (const ipAddress_t& address) {
+    int lightest = 0;
+    for (int i = 0; i < __count__; i++) {
+        if (__table__ [i].address == address)
+            return __table__ [i];
+        if (__table__ [i].getWeight () < __table__ [lightest].getWeight ())
+            lightest = i;
+    }
+
+    if (__count__ < TOP_TALKERS_TABLE_SIZE) {
+        __table__ [__count__] = { address };
+        return __table__ [__count__ ++];
+    }
+
+    // space-saving: the newcomer inherits the traffic of the evicted address as its error
+    uint64_t inherited = __table__ [lightest].getWeight ();
+    __table__ [lightest] = { address };
+    __table__ [lightest].error = inherited;
+    return __table__ [lightest];
+}
@@ -0,0 +1,82 @@
+/*
+
+    topTalkers.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 20, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        topTalkers_t
+
+    topTalkers_t accumulates TCP traffic per remote IP address, so it is still known who used the bandwidth after the
+    connections (and their socket numbers) are gone. Each connection is counted when it is established. Its bytes are
+    added while it transfers data, at most TOP_TALKERS_ACCOUNTING_INTERVAL apart, and the rest when it is closed. That way
+    long-lived connections weigh as much as they have transferred so far.
+
+    The table is bounded (TOP_TALKERS_TABLE_SIZE addresses) and uses space-saving eviction: when a new address arrives and
+    the table is full, it takes over the entry with the least traffic and inherits that traffic as its possible error. An
+    address that sends a lot can therefore never be pushed out by many addresses that send little, the bytes shown for it
+    are exact and error is the most it may be underestimated by the traffic it had before it got (back) into the table.
+
+*/
+
+
+#pragma once
+#ifndef __TOP_TALKERS__
+    #define __TOP_TALKERS__
+
+
+    #include <WiFi.h>
+    #include "ipAddress.h"
+
+
+    // TUNING PARAMETERS
+
+    #ifndef TOP_TALKERS_TABLE_SIZE
+        #define TOP_TALKERS_TABLE_SIZE 16               // number of remote IP addresses tracked at the same time
+    #endif
+    #ifndef TOP_TALKERS_ACCOUNTING_INTERVAL
+        #define TOP_TALKERS_ACCOUNTING_INTERVAL 1000    // 1 s, how often a connection passes its traffic to the table (each time takes LwIpMutex)
+    #endif
+
+
+    struct topTalker_t {
+        ipAddress_t address;
+        uint64_t bytesReceived;
+        uint64_t bytesSent;
+        uint64_t error;             // traffic inherited from the evicted address
+        unsigned long connections;
+        unsigned long lastSeen;     // millis (), the real time may not be known yet
+
+        inline uint64_t getWeight () const __attribute__((always_inline)) { return bytesReceived + bytesSent + error; }
+    };
+
+
+    class topTalkers_t {
+
+        public:
+
+            // the caller should already hold LwIpMutex (this is where connections get established, transfer data and get closed)
+            void connectionEstablished (const ipAddress_t& address);
+            void traffic (const ipAddress_t& address, unsigned long bytesReceived, unsigned long bytesSent); // adds the bytes transferred since the last call
+
+            // copies the table sorted by traffic, the most talkative address first, returns the number of entries
+            int copy (topTalker_t *to, int size);
+
+        private:
+
+            topTalker_t __table__ [TOP_TALKERS_TABLE_SIZE] = {};
+            int __count__ = 0;
+
+            // returns the address's entry, taking over the one with the least traffic if the address is not in the table yet
+            topTalker_t& __entry__ (const ipAddress_t& address);
+    };
+
+    // singleton instance, guarded by LwIpMutex
+    topTalkers_t& topTalkers ();
+
+#endif
@@ -0,0 +1,178 @@
+/*
+
+    tunables.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 15, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        tunable_t
+
+    tunable_t is a tuning parameter that can be changed while the program is running. Its default value comes from the
+    TUNING PARAMETERS macro of the same name, so compile time defaults still work as before. Each module defines its own
+    tunables (as global variables, so they all register themselves before setup () runs) and reads the current value at
+    the time it needs it, for example when a connection is accepted or a task is created, so a new value only applies from
+    then on.
+
+    Only the parameters that are read at run time can be tunables. Sizes of arrays and template parameters (buffer sizes,
+    DMESG_CIRCULAR_QUEUE_LENGTH, ...) remain compile time only.
+
+    The values can be stored in a configuration file (by default /etc/sysctl.conf) with lines of form:
+
+        # comment
+        FTP_DATA_CONNECTION_TIME_OUT = 10
+
+    and loaded at start-up with loadTunables (fileSystem). Telnet sysctl command inspects and changes them live.
+
+    loadTunables and saveTunables need threadSafeFS. They are defined by whichever of tunables.h and threadSafeFS.h is
+    included last (threadSafeFS.h includes this file again at its end), so the order of includes doesn't matter. That is
+    also why this file has no #pragma once.
+
+*/
+
+
+#ifndef __TUNABLES__
+    #define __TUNABLES__
+
+
+    #include <WiFi.h>
+    #include <dmesg.hpp>
+    #include <ostream.hpp>
+
+
+    // TUNING PARAMETERS
+
+    #ifndef TUNABLES_CONFIGURATION_FILE
+        #define TUNABLES_CONFIGURATION_FILE "/etc/sysctl.conf"
+    #endif
+    #ifndef MAX_TUNABLES_CONFIGURATION_FILE
+        #define MAX_TUNABLES_CONFIGURATION_FILE 1 * 1024    // 1 KB will usually do - the whole configuration file is read in the memory
+    #endif
+
+
+    class tunable_t {
+
+        public:
+
+            tunable_t (const char *name, long defaultValue, long minValue, long maxValue, const char *unit) : __name__ (name),
+                                                                                                                __value__ (defaultValue),
+                                                                                                                __defaultValue__ (defaultValue),
+                                                                                                                __minValue__ (minValue),
+                                                                                                                __maxValue__ (maxValue),
+                                                                                                                __unit__ (unit) {
+                // link itself into the registry, this happens during static initialization, before any task is running
+                __next__ = __first__ ();
+                __first__ () = this;
+            }
+
+            // not copyable, the registry keeps the pointer
+            tunable_t (const tunable_t&) = delete;
+            tunable_t& operator = (const tunable_t&) = delete;
+
+            // reading and writing a 32 bit value is atomic on ESP32 so no locking is needed
+            inline operator long () const __attribute__((always_inline)) { return __value__; }
+            inline long get () const __attribute__((always_inline)) { return __value__; }
+
+            // returns false if the value is out of range
+            bool set (long value) {
+                if (value < __minValue__ || value > __maxValue__)
+                    return false;
+                if (value != __value__)
+                    cout << ( dmesgQueue << "[tunables] " << __name__ << " " << __value__ << " -> " << value );
+                __value__ = value;
+                return true;
+            }
+
+            inline void reset () __attribute__((always_inline)) { __value__ = __defaultValue__; }
+
+            inline const char *getName () const __attribute__((always_inline)) { return __name__; }
+            inline long getDefault () const __attribute__((always_inline)) { return __defaultValue__; }
+            inline long getMin () const __attribute__((always_inline)) { return __minValue__; }
+            inline long getMax () const __attribute__((always_inline)) { return __maxValue__; }
+            inline const char *getUnit () const __attribute__((always_inline)) { return __unit__; }
+
+            // registry iteration: for (tunable_t *t = tunable_t::first (); t; t = t->next ())
+            static inline tunable_t *first () __attribute__((always_inline)) { return __first__ (); }
+            inline tunable_t *next () const __attribute__((always_inline)) { return __next__; }
+
+            // returns NULL if there is no tunable with this name
+            static tunable_t *find (const char *name) {
+                for (tunable_t *t = __first__ (); t; t = t->__next__)
+                    if (!strcmp (t->__name__, name))
+                        return t;
+                return NULL;
+            }
+
+        private:
+
+            const char *__name__;
+            volatile long __value__;
+            long __defaultValue__;
+            long __minValue__;
+            long __maxValue__;
+            const char *__unit__;
+
+            tunable_t *__next__;
+
+            // function local static pointer gets initialized before any constructor runs, regardless of the order of modules
+            static inline tunable_t *&__first__ () __attribute__((always_inline)) {
+                static tunable_t *first = NULL;
+                return first;
+            }
+    };
+
+#endif
+
+
+#if defined (__THREAD_SAFE_FS__) && !defined (__TUNABLES_FS__)
+    #define __TUNABLES_FS__
+
+    // sets the tunables from configuration file, returns the number of values set or -1 if the file could not be read
+    inline int loadTunables (threadSafeFS::FS& fileSystem, const char *fileName = TUNABLES_CONFIGURATION_FILE) {
+        char buffer [MAX_TUNABLES_CONFIGURATION_FILE + 1];
+        if (!fileSystem.readConfiguration (buffer, sizeof (buffer) - 1, fileName))
+            return -1;
+        strcat (buffer, "\n");
+
+        // readConfiguration leaves lines of form "name value"
+        int count = 0;
+        char *line = buffer;
+        char *endOfLine;
+        while ((endOfLine = strchr (line, '\n'))) {
+            *endOfLine = 0;
+            char *value = strchr (line, ' ');
+            if (value) {
+                *value++ = 0;
+                tunable_t *t = tunable_t::find (line);
+                if (!t)
+                    cout << ( dmesgQueue << "[tunables] unknown tunable " << line << " in " << fileName );
+                else if (!t->set (atol (value)))
+                    cout << ( dmesgQueue << "[tunables] " << line << " value " << value << " out of range in " << fileName );
+                else
+                    count ++;
+            }
+            line = endOfLine + 1;
+        }
+        return count;
+    }
+
+    // writes the values that differ from defaults to configuration file, returns false in case of error
+    inline bool saveTunables (threadSafeFS::FS& fileSystem, const char *fileName = TUNABLES_CONFIGURATION_FILE) {
+        threadSafeFS::File f = fileSystem.open (fileName, FILE_WRITE);
+        if (!f) {
+            cout << ( dmesgQueue << "[tunables] can't write " << fileName );
+            return false;
+        }
+        bool success = fprintf (f, "# tuning parameters that differ from compile time defaults\n") > 0;
+        for (tunable_t *t = tunable_t::first (); t; t = t->next ())
+            if (t->get () != t->getDefault ())
+                success &= fprintf (f, "%s = %li\n", t->getName (), t->get ()) > 0;
+        f.close ();
+        return success;
+    }
+
+#endif
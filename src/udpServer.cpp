@@ -0,0 +1,145 @@
+/*
+
+    udpServer.cpp
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 10, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        udpServer_t
+
+*/
+
+
+#include <WiFi.h>
+#include <errno.h>
+#include "udpServer.h"
+#include <dmesg.hpp>
+#include <ostream.hpp>
+
+
+// run time values of tuning parameters
+tunable_t udpReceiverStackSize ("UDP_RECEIVER_STACK_SIZE", UDP_RECEIVER_STACK_SIZE, 2 * 1024, 16 * 1024, "bytes");
+tunable_t udpReceiverTimeOut ("UDP_RECEIVER_TIME_OUT", UDP_RECEIVER_TIME_OUT, 10, 10000, "ms");
+
+
+udpServer_t::udpServer_t (int serverPort,
+                          bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress),
+                          bool runReceiverInItsOwnTask) : udpSocket_t (serverPort),
+                                                          __serverPort__ (serverPort),
+                                                          __firewallCallback__ (firewallCallback),
+                                                          __runReceiverInItsOwnTask__ (runReceiverInItsOwnTask) {
+    if (__socket__ == -1) {
+        __state__ = NOT_RUNNING;
+        return;
+    }
+
+    __datagrams__ = new (std::nothrow) datagram_t [UDP_SERVER_BATCH_SIZE];
+    if (!__datagrams__) {
+        cout << ( dmesgQueue << "[udpServer] " << "out of memory" );
+        close ();
+        __state__ = NOT_RUNNING;
+        return;
+    }
+
+    // the receiver starts in begin (), when the derived object is complete
+}
+
+udpServer_t::~udpServer_t () {
+    stop ();
+    close ();
+    if (__datagrams__)
+        delete [] __datagrams__;
+}
+
+bool udpServer_t::begin () {
+    if (__state__ != STARTING)
+        return __state__ == RUNNING;
+    __state__ = RUNNING;
+
+    // start receiver task if needed
+    if (__runReceiverInItsOwnTask__) {
+        #define tskNORMAL_PRIORITY (tskIDLE_PRIORITY + 1)
+        BaseType_t taskCreated = xTaskCreate ([] (void *thisInstance) {
+            udpServer_t *ths = (udpServer_t *) thisInstance;
+            cout << ( dmesgQueue << "[udpServer] " << "receiver on port " << ths->__serverPort__ << " started on core " << xPortGetCoreID () );
+
+            while (ths->__state__ == RUNNING) {
+                ths->receive (udpReceiverTimeOut);
+
+                static UBaseType_t lastHighWaterMark = udpReceiverStackSize;
+                UBaseType_t highWaterMark = uxTaskGetStackHighWaterMark (NULL);
+                if (lastHighWaterMark > highWaterMark) {
+                    cout << ( dmesgQueue << "[udpServer] " << "new receiver's stack high water mark: " << highWaterMark << " bytes not used" );
+                    lastHighWaterMark = highWaterMark;
+                }
+            }
+
+            cout << ( dmesgQueue << "[udpServer] " << "on port " << ths->__serverPort__ << " stopped" );
+            ths->__state__ = NOT_RUNNING;
+            vTaskDelete (NULL);
+        }, "udpReceiver", udpReceiverStackSize, this, tskNORMAL_PRIORITY, NULL);
+
+        if (pdPASS != taskCreated) {
+            cout << ( dmesgQueue << "[udpServer] " << "xTaskCreate error" );
+            close ();
+            __state__ = NOT_RUNNING;
+        }
+    }
+    return __state__ == RUNNING;
+}
+
+void udpServer_t::stop () {
+    // let the receiver task finish so that it doesn't call __processDatagram__ of the object being destroyed
+    if (__runReceiverInItsOwnTask__ && __state__ == RUNNING) {
+        __state__ = STOPPING;
+        while (__state__ != NOT_RUNNING)
+            delay (25);
+    }
+    __state__ = NOT_RUNNING;
+}
+
+int udpServer_t::receive (unsigned long timeoutMillis) {
+    if (__socket__ == -1 || !__datagrams__)
+        return -1;
+
+    if (!waitReadable (timeoutMillis))
+        return 0;
+
+    // read all pending datagrams (up to UDP_SERVER_BATCH_SIZE) at once
+    int count = 0;
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        while (count < UDP_SERVER_BATCH_SIZE) {
+            datagram_t& d = __datagrams__ [count];
+            d.len = __recvFrom__ (d.data, UDP_SERVER_BUFFER_SIZE, d.clientAddress, d.clientPort);
+            if (d.len < 0)
+                break;
+            count++;
+        }
+        int err = errno;
+    xSemaphoreGive (getLwIpMutex ());
+    if (count == 0 && err != EAGAIN) {
+        cout << ( dmesgQueue << "[udpServer] " << "recvfrom error: " << err << " " << strerror (err) );
+        return -1;
+    }
+
+    // process them
+    int processed = 0;
+    for (int i = 0; i < count; i++) {
+        datagram_t& d = __datagrams__ [i];
+        __receivedDatagrams__ ++;
+
+        if ((__firewall__ && !__firewall__->allows (d.clientAddress)) || (__firewallCallback__ && !__firewallCallback__ (d.clientAddress, ipAddress_t ()))) {
+            __rejectedDatagrams__ ++;
+            continue;
+        }
+
+        __processDatagram__ (d.data, d.len, d.clientAddress, d.clientPort);
+        processed++;
+    }
+    return processed;
+}
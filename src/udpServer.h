@@ -0,0 +1,126 @@
+/*
+
+    udpServer.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 10, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        udpServer_t
+
+    Inheritance diagram:
+
+      ┌─────────────┐
+      │ udpSocket_t ┼┐
+      └─────────────┘│     ┌──────────────┐
+                     └─────┼─ udpServer_t │
+                           └──────────────┘
+
+    udpServer_t is the base for datagram services (NTP, syslog, TFTP, discovery, ...) the way tcpServer_t is for TCP services.
+    Derived classes override __processDatagram__, call begin () at the end of their constructor and stop () at the beginning
+    of their destructor. The receiver task calls the virtual __processDatagram__, so it must not run while the derived part
+    of the object is not constructed yet or already destroyed.
+
+    receive () waits until the socket becomes readable, then takes LwIpMutex once and drains up to UDP_SERVER_BATCH_SIZE
+    pending datagrams into buffers that are allocated only once, when the server starts. The datagrams are passed to
+    __processDatagram__ after LwIpMutex is released. Datagrams from addresses that the firewall rejects are dropped before
+    processing.
+
+    Like tcpServer_t, udpServer_t can run receive () in its own task or leave the calling program to call it periodically.
+
+*/
+
+
+#pragma once
+#ifndef __UDP_SERVER__
+    #define __UDP_SERVER__
+
+
+    #include <WiFi.h>
+    #include "udpSocket.h"
+    #include "firewall.h"
+    #include "tunables.h"
+
+
+    // TUNING PARAMETERS
+
+    #ifndef UDP_SERVER_BATCH_SIZE
+        #define UDP_SERVER_BATCH_SIZE 4                 // max number of datagrams read at once
+    #endif
+    #ifndef UDP_SERVER_BUFFER_SIZE
+        #define UDP_SERVER_BUFFER_SIZE 576              // max datagram size (longer ones are truncated), 576 bytes is the minimal datagram size every host must accept
+    #endif
+    #ifndef UDP_RECEIVER_STACK_SIZE
+        #define UDP_RECEIVER_STACK_SIZE (3 * 1024)
+    #endif
+    #ifndef UDP_RECEIVER_TIME_OUT
+        #define UDP_RECEIVER_TIME_OUT 500               // 500 ms, the longest receiver task waits before checking if the server is stopping
+    #endif
+
+    // run time values of tuning parameters
+    extern tunable_t udpReceiverStackSize;
+    extern tunable_t udpReceiverTimeOut;
+
+
+    class udpServer_t : public udpSocket_t {
+
+        public:
+
+            udpServer_t (int serverPort,
+                         bool (*firewallCallback) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress) = NULL,  // serverAddress is unspecified for UDP
+                         bool runReceiverInItsOwnTask = true);
+
+            virtual ~udpServer_t ();
+
+            // starts receiving (in its own task if asked for), returns false if the server couldn't be started
+            bool begin ();
+
+            // stops receiving and waits until the receiver task ends, it is safe to call it more than once
+            void stop ();
+
+            // bool() operator to test if udpServer started successfully
+            inline operator bool () __attribute__((always_inline)) { return __state__ == RUNNING; }
+
+            // waits up to timeoutMillis for datagrams and processes them, returns the number of datagrams processed or -1 in case of error
+            int receive (unsigned long timeoutMillis = 0);
+
+            // compiled CIDR rules, checked before the firewall callback
+            inline void setFirewall (firewall_t *firewall) __attribute__((always_inline)) { __firewall__ = firewall; }
+
+            // statistics
+            inline unsigned long getReceivedDatagrams () __attribute__((always_inline)) { return __receivedDatagrams__; }
+            inline unsigned long getRejectedDatagrams () __attribute__((always_inline)) { return __rejectedDatagrams__; }
+
+        protected:
+
+            // override to handle datagrams, the data is only valid during the call
+            virtual void __processDatagram__ (const uint8_t *data, size_t len, const ipAddress_t& clientAddress, int clientPort) {}
+
+        private:
+
+            struct datagram_t {
+                ipAddress_t clientAddress;
+                int clientPort;
+                int len;
+                uint8_t data [UDP_SERVER_BUFFER_SIZE];
+            };
+            datagram_t *__datagrams__ = NULL; // UDP_SERVER_BATCH_SIZE preallocated buffers
+
+            int __serverPort__;
+
+            bool (*__firewallCallback__) (const ipAddress_t& clientAddress, const ipAddress_t& serverAddress);
+            firewall_t *__firewall__ = NULL;
+
+            unsigned long __receivedDatagrams__ = 0;
+            unsigned long __rejectedDatagrams__ = 0;
+
+            enum STATE_TYPE { STARTING = 0, NOT_RUNNING = 1, RUNNING = 2, STOPPING = 3 } __state__ = STARTING; // STARTING until begin () is called
+
+            bool __runReceiverInItsOwnTask__;
+    };
+
+#endif
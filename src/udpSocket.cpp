@@ -0,0 +1,138 @@
+/*
+
+    udpSocket.cpp
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 10, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        udpSocket_t
+
+*/
+
+
+#include <WiFi.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "udpSocket.h"
+#include <dmesg.hpp>
+#include <ostream.hpp>
+
+
+udpSocket_t::udpSocket_t (int localPort) {
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+
+        __socket__ = socket (AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+        if (__socket__ == -1) {
+            cout << ( dmesgQueue << "[udpSocket] " << "socket error: " << errno << " " << strerror (errno) );
+            xSemaphoreGive (getLwIpMutex ());
+            return;
+        }
+
+        // allow both IPv4 and IPv6 datagrams
+        int opt = 0;
+        if (setsockopt (__socket__, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof (opt)) == -1) {
+            cout << ( dmesgQueue << "[udpSocket] " << "setsockopt error: " << errno << " " << strerror (errno) );
+            goto error;
+        }
+
+        // make address reusable
+        opt = 1;
+        if (localPort && setsockopt (__socket__, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof (opt)) == -1) {
+            cout << ( dmesgQueue << "[udpSocket] " << "setsockopt error: " << errno << " " << strerror (errno) );
+            goto error;
+        }
+
+        {
+            struct sockaddr_in6 localAddress = {};
+            localAddress.sin6_family = AF_INET6;
+            localAddress.sin6_port = htons (localPort);
+            if (bind (__socket__, (struct sockaddr *) &localAddress, sizeof (localAddress)) == -1) {
+                cout << ( dmesgQueue << "[udpSocket] " << "bind error: " << errno << " " << strerror (errno) );
+                goto error;
+            }
+        }
+
+        // make socket non-blocking
+        if (fcntl (__socket__, F_SETFL, O_NONBLOCK) == -1) {
+            cout << ( dmesgQueue << "[udpSocket] " << "fcntl error: " << errno << " " << strerror (errno) );
+            goto error;
+        }
+
+    xSemaphoreGive (getLwIpMutex ());
+    return;
+
+error:
+        ::close (__socket__);
+        __socket__ = -1;
+    xSemaphoreGive (getLwIpMutex ());
+}
+
+udpSocket_t::~udpSocket_t () { close (); }
+
+int udpSocket_t::sendTo (const void *buf, size_t len, const ipAddress_t& address, int port) {
+    struct sockaddr_in6 to = {};
+    to.sin6_family = AF_INET6;
+    to.sin6_port = htons (port);
+    memcpy (&to.sin6_addr, address.bytes, 16); // IPv4 addresses are already in IPv4-mapped form
+
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        int sent = ::sendto (__socket__, (const char *) buf, len, 0, (struct sockaddr *) &to, sizeof (to));
+    xSemaphoreGive (getLwIpMutex ());
+    if (sent == -1)
+        cout << ( dmesgQueue << "[udpSocket] " << "sendto error: " << errno << " " << strerror (errno) );
+    return sent;
+}
+
+bool udpSocket_t::waitReadable (unsigned long timeoutMillis) {
+    if (__socket__ == -1)
+        return false;
+    fd_set readfds;
+    FD_ZERO (&readfds);
+    FD_SET (__socket__, &readfds);
+    struct timeval tv = { (time_t) (timeoutMillis / 1000), (suseconds_t) ((timeoutMillis % 1000) * 1000) };
+    return select (__socket__ + 1, &readfds, NULL, NULL, &tv) > 0; // without LwIpMutex, lwIP's select is thread-safe
+}
+
+int udpSocket_t::recvFrom (void *buf, size_t len, ipAddress_t& address, int& port, unsigned long timeoutMillis) {
+    unsigned long startMillis = millis ();
+    while (true) {
+        xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+            int received = __recvFrom__ (buf, len, address, port);
+        xSemaphoreGive (getLwIpMutex ());
+        if (received >= 0)
+            return received;
+        if (errno != EAGAIN) {
+            cout << ( dmesgQueue << "[udpSocket] " << "recvfrom error: " << errno << " " << strerror (errno) );
+            return -1;
+        }
+
+        unsigned long elapsed = millis () - startMillis;
+        if (elapsed >= timeoutMillis || !waitReadable (timeoutMillis - elapsed))
+            return UDP_TIME_OUT;
+    }
+}
+
+int udpSocket_t::__recvFrom__ (void *buf, size_t len, ipAddress_t& address, int& port) {
+    struct sockaddr_storage from = {};
+    socklen_t fromLen = sizeof (from);
+    int received = ::recvfrom (__socket__, (char *) buf, len, 0, (struct sockaddr *) &from, &fromLen);
+    if (received >= 0) {
+        address = ipAddress_t ((struct sockaddr *) &from);
+        port = ntohs (((struct sockaddr_in6 *) &from)->sin6_port); // sin_port and sin6_port are at the same place
+    }
+    return received;
+}
+
+void udpSocket_t::close () {
+    xSemaphoreTake (getLwIpMutex (), portMAX_DELAY);
+        if (__socket__ != -1) {
+            ::close (__socket__);
+            __socket__ = -1;
+        }
+    xSemaphoreGive (getLwIpMutex ());
+}
@@ -0,0 +1,76 @@
+/*
+
+    udpSocket.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 10, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        udpSocket_t
+
+    Inheritance diagram:
+
+      ┌─────────────┐
+      │ udpSocket_t ┼┐
+      └─────────────┘│     ┌──────────────┐
+                     └─────┼─ udpServer_t │
+                           └──────────────┘
+
+    udpSocket_t is a non-blocking dual-stack (IPv6 socket that also handles IPv4 in IPv4-mapped form) UDP socket. It is what
+    tcpConnection_t is for TCP: datagram clients (like ntpClient_t) use it directly, udpServer_t builds on it.
+
+    recvFrom waits for the socket to become readable with select, without holding LwIpMutex, so it neither polls nor blocks
+    the other network tasks while waiting.
+
+*/
+
+
+#pragma once
+#ifndef __UDP_SOCKET__
+    #define __UDP_SOCKET__
+
+
+    #include <WiFi.h>
+    #include <lwip/sockets.h>
+    #include <LwIpMutex.h>
+    #include "ipAddress.h"
+
+
+    class udpSocket_t {
+
+        public:
+
+            // binds the socket to localPort, 0 means any free port (suitable for clients)
+            udpSocket_t (int localPort = 0);
+            virtual ~udpSocket_t ();
+
+            // bool() operator to test if the socket is ready
+            inline operator bool () __attribute__((always_inline)) { return __socket__ != -1; }
+
+            inline int getSocket () __attribute__((always_inline)) { return __socket__; }
+
+            // returns the number of bytes sent or -1 in case of error
+            int sendTo (const void *buf, size_t len, const ipAddress_t& address, int port);
+
+            // waits up to timeoutMillis for a datagram, returns its length (0 for an empty datagram), -1 in case of error or UDP_TIME_OUT
+            static constexpr int UDP_TIME_OUT = -2;
+            int recvFrom (void *buf, size_t len, ipAddress_t& address, int& port, unsigned long timeoutMillis);
+
+            // waits up to timeoutMillis for the socket to become readable, returns true if it is
+            bool waitReadable (unsigned long timeoutMillis);
+
+            virtual void close ();
+
+        protected:
+
+            int __socket__ = -1;
+
+            // non-blocking recvfrom, the caller should already hold LwIpMutex, returns the length of datagram or -1 and sets errno (EAGAIN if there are no more datagrams)
+            int __recvFrom__ (void *buf, size_t len, ipAddress_t& address, int& port);
+    };
+
+#endif
@@ -0,0 +1,352 @@
+/*
+
+    zlibStream.h
+
+    This file is part of Multitasking HTTP, FTP, Telnet, NTP, SMTP servers and clients for ESP32 - Arduino library: https://github.com/BojanJurca/Multitasking-Http-Ftp-Telnet-Ntp-Smtp-Servers-and-clients-for-ESP32-Arduino-Library
+
+
+    April 26, 2026, Bojan Jurca
+
+
+    Classes implemented/used in this module:
+
+        deflate_t
+        inflate_t
+
+    Streaming zlib (RFC 1950/1951) compression and decompression with bounded memory, used by FTP MODE Z.
+
+    deflate_t is a small LZ77 compressor written for this library. Full deflate implementations (including miniz's tdefl
+    that is in ESP32 ROM) need a few hundred KB of RAM, deflate_t needs 4 * 2^windowBits bytes, 2^DEFLATE_HASH_BITS hash
+    heads and the output buffer. It looks for matches only within the last 2^windowBits bytes, follows at most
+    DEFLATE_MAX_CHAIN candidates and encodes everything in one block with fixed Huffman codes. This gives up some of the
+    ratio of a real deflate but text files like logs and CSVs still shrink several times, since most of what they gain
+    comes from repeated strings anyway.
+
+    inflate_t uses tinfl from ESP32 ROM. The decompressor can not choose the window of the sender, so it always needs the
+    full 32 KB dictionary.
+
+*/
+
+
+#pragma once
+#ifndef __ZLIB_STREAM__
+    #define __ZLIB_STREAM__
+
+
+    #include <WiFi.h>
+    #include <esp_heap_caps.h>
+    #include <rom/miniz.h>
+    #include <dmesg.hpp>
+    #include <ostream.hpp>
+
+
+    // TUNING PARAMETERS
+
+    #ifndef DEFLATE_HASH_BITS
+        #define DEFLATE_HASH_BITS 12                    // 2^12 hash chains, 8 KB
+    #endif
+    #ifndef DEFLATE_MAX_CHAIN
+        #define DEFLATE_MAX_CHAIN 8                     // how many earlier positions with the same hash are compared, more gives better ratio for more CPU
+    #endif
+
+
+    class deflate_t {
+
+        public:
+
+            // windowBits 9 ... 14, compress () accepts up to maxInput bytes at a time
+            deflate_t (int windowBits, size_t maxInput, bool psram = false) : __windowBits__ (windowBits < 9 ? 9 : windowBits > 14 ? 14 : windowBits) {
+                __windowSize__ = 1 << __windowBits__;
+                size_t bytes = 2 * __windowSize__                                   // window, the second half is filled while the first half is still matched against
+                             + __windowSize__ * sizeof (uint16_t)                   // chains
+                             + (1 << DEFLATE_HASH_BITS) * sizeof (uint16_t)         // heads of chains
+                             + maxInput + maxOutput (maxInput);                  // output, what is left over plus what one call can produce
+                if (psram)
+                    __memory__ = (uint8_t *) heap_caps_malloc (bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                if (!__memory__)
+                    __memory__ = (uint8_t *) heap_caps_malloc (bytes, MALLOC_CAP_8BIT);
+                if (!__memory__) {
+                    cout << ( dmesgQueue << "[deflate] " << "can't allocate " << (unsigned long) bytes << " bytes" );
+                    return;
+                }
+                __window__ = __memory__;
+                __prev__ = (uint16_t *) (__window__ + 2 * __windowSize__);
+                __head__ = __prev__ + __windowSize__;
+                __output__ = __out__ = (uint8_t *) (__head__ + (1 << DEFLATE_HASH_BITS));
+                memset (__head__, 0, (1 << DEFLATE_HASH_BITS) * sizeof (uint16_t));
+            }
+
+            ~deflate_t () { if (__memory__) heap_caps_free (__memory__); }
+
+            deflate_t (const deflate_t&) = delete;
+            deflate_t& operator = (const deflate_t&) = delete;
+
+            inline operator bool () __attribute__((always_inline)) { return __memory__ != NULL; }
+
+            // fixed Huffman codes never take more than 9 bits per byte, plus zlib header, block header, end of block and checksum
+            static inline size_t maxOutput (size_t inputLength) __attribute__((always_inline)) { return inputLength + inputLength / 8 + 16; }
+
+            // compresses up to maxInput bytes and appends them to output (), finish ends the stream, returns the number of bytes in output ()
+            size_t compress (const char *input, size_t inputLength, bool finish) {
+                if (!__started__) {
+                    // zlib header: deflate with 2^windowBits window, no dictionary, the check bits make CMF * 256 + FLG a multiple of 31
+                    uint8_t cmf = ((__windowBits__ - 8) << 4) | 8;
+                    *__out__++ = cmf;
+                    *__out__++ = 31 - (cmf * 256) % 31;
+                    __putBits__ (1, 1); // BFINAL, the whole stream is one block
+                    __putBits__ (1, 2); // BTYPE = fixed Huffman codes
+                    __started__ = true;
+                }
+
+                while (inputLength) {
+                    if (__position__ == 2 * __windowSize__)
+                        __slide__ ();
+                    size_t length = min (inputLength, 2 * __windowSize__ - __position__);
+                    memcpy (__window__ + __position__, input, length);
+                    __adler32__ ((const uint8_t *) input, length);
+                    __compress__ (__position__, __position__ + length);
+                    __position__ += length;
+                    input += length;
+                    inputLength -= length;
+                }
+
+                if (finish) {
+                    __putSymbol__ (256); // end of block
+                    if (__bitCount__)
+                        __putBits__ (0, 8 - __bitCount__);
+                    *__out__++ = __s2__ >> 8; *__out__++ = __s2__; *__out__++ = __s1__ >> 8; *__out__++ = __s1__;
+                }
+                return __out__ - __output__;
+            }
+
+            // compressed data, once there are maxInput bytes or more they must be taken away with outputSent () before compress () is called again
+            inline const uint8_t *output () __attribute__((always_inline)) { return __output__; }
+            inline void outputSent () __attribute__((always_inline)) { __out__ = __output__; }
+
+        private:
+
+            int __windowBits__;
+            size_t __windowSize__;
+
+            uint8_t *__memory__ = NULL;
+            uint8_t *__window__;
+            uint16_t *__prev__;     // earlier position with the same hash, for each position in the window
+            uint16_t *__head__;     // the latest position for each hash, positions are stored + 1 so that 0 means none
+            uint8_t *__output__;
+            uint8_t *__out__;
+
+            size_t __position__ = 0;
+            bool __started__ = false;
+            uint32_t __bitBuffer__ = 0;
+            int __bitCount__ = 0;
+            uint32_t __s1__ = 1;
+            uint32_t __s2__ = 0;
+
+            static inline uint32_t __hash__ (const uint8_t *p) __attribute__((always_inline)) { return (((uint32_t) p [0] << 16 | (uint32_t) p [1] << 8 | p [2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS); }
+
+            inline void __insert__ (size_t position) __attribute__((always_inline)) {
+                uint32_t h = __hash__ (__window__ + position);
+                __prev__ [position & (__windowSize__ - 1)] = __head__ [h];
+                __head__ [h] = position + 1;
+            }
+
+            // deflate doesn't need a flush between calls, matches just never reach past the end of what has been given so far
+            void __compress__ (size_t from, size_t to) {
+                static const uint16_t lengthBase [29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+                static const uint8_t lengthExtra [29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+                static const uint16_t distanceBase [30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+                static const uint8_t distanceExtra [30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+                size_t i = from;
+                while (i < to) {
+                    size_t bestLength = 0;
+                    size_t bestDistance = 0;
+                    if (to - i >= 3) {
+                        size_t maxLength = min ((size_t) 258, to - i);
+                        uint32_t candidate = __head__ [__hash__ (__window__ + i)];
+                        __insert__ (i);
+                        for (int chain = DEFLATE_MAX_CHAIN; candidate && chain; chain--) {
+                            size_t c = candidate - 1;
+                            if (c >= i || i - c > __windowSize__)
+                                break; // chains may point to positions that have been overwritten since
+                            if (__window__ [c + bestLength] == __window__ [i + bestLength]) {
+                                size_t length = 0;
+                                while (length < maxLength && __window__ [c + length] == __window__ [i + length])
+                                    length++;
+                                if (length > bestLength) {
+                                    bestLength = length;
+                                    bestDistance = i - c;
+                                    if (length == maxLength)
+                                        break;
+                                }
+                            }
+                            candidate = __prev__ [c & (__windowSize__ - 1)];
+                        }
+                    }
+
+                    if (bestLength >= 3) {
+                        int l = 28;
+                        while (lengthBase [l] > bestLength)
+                            l--;
+                        __putSymbol__ (257 + l);
+                        __putBits__ (bestLength - lengthBase [l], lengthExtra [l]);
+                        int d = 29;
+                        while (distanceBase [d] > bestDistance)
+                            d--;
+                        __putBits__ (__reverse__ (d, 5), 5);
+                        __putBits__ (bestDistance - distanceBase [d], distanceExtra [d]);
+                        // positions inside the match can be matched later as well
+                        for (size_t p = i + 1; p < i + bestLength && to - p >= 3; p++)
+                            __insert__ (p);
+                        i += bestLength;
+                    } else {
+                        __putSymbol__ (__window__ [i]);
+                        i++;
+                    }
+                }
+            }
+
+            // moves the second half of the window to the first half, positions that fall out of the window become 0
+            void __slide__ () {
+                memcpy (__window__, __window__ + __windowSize__, __windowSize__);
+                for (int h = 0; h < (1 << DEFLATE_HASH_BITS); h++)
+                    __head__ [h] = __head__ [h] > __windowSize__ ? __head__ [h] - __windowSize__ : 0;
+                for (size_t p = 0; p < __windowSize__; p++)
+                    __prev__ [p] = __prev__ [p] > __windowSize__ ? __prev__ [p] - __windowSize__ : 0;
+                __position__ -= __windowSize__;
+            }
+
+            // deflate writes Huffman codes starting with the most significant bit, everything else starting with the least significant one
+            static inline uint32_t __reverse__ (uint32_t code, int bits) __attribute__((always_inline)) {
+                uint32_t r = 0;
+                while (bits--) {
+                    r = (r << 1) | (code & 1);
+                    code >>= 1;
+                }
+                return r;
+            }
+
+            inline void __putBits__ (uint32_t value, int bits) __attribute__((always_inline)) {
+                __bitBuffer__ |= value << __bitCount__;
+                __bitCount__ += bits;
+                while (__bitCount__ >= 8) {
+                    *__out__++ = __bitBuffer__;
+                    __bitBuffer__ >>= 8;
+                    __bitCount__ -= 8;
+                }
+            }
+
+            // fixed literal/length Huffman code (RFC 1951 3.2.6)
+            inline void __putSymbol__ (int symbol) __attribute__((always_inline)) {
+                if (symbol < 144)       __putBits__ (__reverse__ (0x30 + symbol, 8), 8);
+                else if (symbol < 256)  __putBits__ (__reverse__ (0x190 + symbol - 144, 9), 9);
+                else if (symbol < 280)  __putBits__ (__reverse__ (symbol - 256, 7), 7);
+                else                    __putBits__ (__reverse__ (0xC0 + symbol - 280, 8), 8);
+            }
+
+            void __adler32__ (const uint8_t *data, size_t length) {
+                while (length) {
+                    size_t n = min (length, (size_t) 5552); // the largest n for which s2 can't overflow before the modulo
+                    length -= n;
+                    while (n--) {
+                        __s1__ += *data++;
+                        __s2__ += __s1__;
+                    }
+                    __s1__ %= 65521;
+                    __s2__ %= 65521;
+                }
+            }
+    };
+
+
+    class inflate_t {
+
+        public:
+
+            inflate_t (size_t inputBufferSize, bool psram = false) : __inputBufferSize__ (inputBufferSize) {
+                size_t bytes = TINFL_LZ_DICT_SIZE + sizeof (tinfl_decompressor) + inputBufferSize;
+                if (psram)
+                    __memory__ = (uint8_t *) heap_caps_malloc (bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                if (!__memory__)
+                    __memory__ = (uint8_t *) heap_caps_malloc (bytes, MALLOC_CAP_8BIT);
+                if (!__memory__) {
+                    cout << ( dmesgQueue << "[inflate] " << "can't allocate " << (unsigned long) bytes << " bytes" );
+                    return;
+                }
+                __dictionary__ = __memory__;
+                __decompressor__ = (tinfl_decompressor *) (__dictionary__ + TINFL_LZ_DICT_SIZE);
+                __input__ = (uint8_t *) (__decompressor__ + 1);
+                tinfl_init (__decompressor__);
+            }
+
+            ~inflate_t () { if (__memory__) heap_caps_free (__memory__); }
+
+            inflate_t (const inflate_t&) = delete;
+            inflate_t& operator = (const inflate_t&) = delete;
+
+            inline operator bool () __attribute__((always_inline)) { return __memory__ != NULL; }
+
+            // compressed data is received directly into the input buffer, call inputReceived with 0 when there is no more
+            inline char *inputBuffer () __attribute__((always_inline)) { return (char *) __input__; }
+            inline size_t inputBufferSize () __attribute__((always_inline)) { return __inputBufferSize__; }
+            inline void inputReceived (int length) __attribute__((always_inline)) { __inputPosition__ = 0; __inputAvailable__ = length; __inputEnded__ = length == 0; }
+
+            // the whole stream has been decompressed and its checksum is correct
+            inline bool finished () __attribute__((always_inline)) { return __status__ == TINFL_STATUS_DONE && !__outputAvailable__; }
+
+            // copies up to length decompressed bytes to buffer, returns 0 if it needs more input (or if finished) and -1 if the stream is corrupt or incomplete
+            int read (char *buffer, size_t length) {
+                while (true) {
+                    if (__outputAvailable__) {
+                        size_t n = min (length, __outputAvailable__);
+                        memcpy (buffer, __dictionary__ + __outputPosition__, n);
+                        __outputPosition__ += n;
+                        __outputAvailable__ -= n;
+                        return n;
+                    }
+                    if (__status__ == TINFL_STATUS_DONE)
+                        return 0;
+                    if (__status__ < 0)
+                        return -1;
+                    if (!__inputAvailable__ && __status__ != TINFL_STATUS_HAS_MORE_OUTPUT) {
+                        if (__inputEnded__) {
+                            __status__ = TINFL_STATUS_FAILED;
+                            return -1;
+                        }
+                        return 0;
+                    }
+
+                    // the dictionary is also the output buffer, tinfl writes up to its end and then wraps around
+                    size_t inBytes = __inputAvailable__;
+                    size_t outBytes = TINFL_LZ_DICT_SIZE - __dictionaryPosition__;
+                    __status__ = tinfl_decompress (__decompressor__, __input__ + __inputPosition__, &inBytes, __dictionary__, __dictionary__ + __dictionaryPosition__, &outBytes,
+                                                   TINFL_FLAG_PARSE_ZLIB_HEADER | (__inputEnded__ ? 0 : TINFL_FLAG_HAS_MORE_INPUT));
+                    __inputPosition__ += inBytes;
+                    __inputAvailable__ -= inBytes;
+                    __outputPosition__ = __dictionaryPosition__;
+                    __outputAvailable__ = outBytes;
+                    __dictionaryPosition__ = (__dictionaryPosition__ + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+                    if (__status__ < 0)
+                        __outputAvailable__ = 0;
+                }
+            }
+
+        private:
+
+            size_t __inputBufferSize__;
+
+            uint8_t *__memory__ = NULL;
+            uint8_t *__dictionary__;
+            tinfl_decompressor *__decompressor__;
+            uint8_t *__input__;
+
+            size_t __inputPosition__ = 0;
+            size_t __inputAvailable__ = 0;
+            bool __inputEnded__ = false;
+            size_t __dictionaryPosition__ = 0;
+            size_t __outputPosition__ = 0;
+            size_t __outputAvailable__ = 0;
+            tinfl_status __status__ = TINFL_STATUS_NEEDS_MORE_INPUT;
+    };
+
+#endif